@@ -7,6 +7,7 @@
 // include intern
 #include <config.h>
 #include <mqtt.h>
+#include <logger.h>
 
 // include extern
 #include <Arduino.h>
@@ -0,0 +1,23 @@
+#pragma once
+
+// ======================================================
+// includes
+// ======================================================
+#include <config.h>
+#include <Arduino.h>
+#include <km271.h>
+
+//*****************************************************************************
+// Defines
+//*****************************************************************************
+#define COMPACT_FLUSH_TIME      1000      // max age of a value change before it is sent
+#define COMPACT_FULL_TIME       300000    // interval for a frame with all values
+#define COMPACT_SCHEMA_VERSION  1         // version of the value id schema
+
+// ======================================================
+// Prototypes
+// ======================================================
+void setupCompact();
+void compactValueChanged(e_km271_valueId id, uint8_t raw, float value, void *ctx);
+void sendCompactSchema();
+void cyclicCompact();
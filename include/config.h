@@ -1,11 +1,46 @@
 #pragma once
 #include <Credentials.h>
 
-#define USE_OILMETER                // disable if you dont use the oilmeter
-// #define DEBUG_ON                 // enable debug messages
+// ======================================================
+// Deployment profile
+// select one profile - or none and adapt the single switches below
+// unused circuits, register groups and sinks are not compiled in
+// ======================================================
+// #define PROFILE_MINIMAL          // HC1, DHW, boiler status values via mqtt only
+// #define PROFILE_HC1              // like the default, but without HC2
+
+#if defined(PROFILE_MINIMAL)
+  // no HC2, no config values, no oilmeter, no http server, no additional sinks
+#elif defined(PROFILE_HC1)
+  #define USE_OILMETER
+  #define USE_CONFIG_VALUES
+  // #define USE_HTTPSERVER
+#else
+  #define USE_HC2                     // heating circuit 2 is available
+  // #define USE_HC3_HC4              // heating circuits 3 and 4 (module FM442)
+  #define USE_CONFIG_VALUES           // decode and publish config values
+  #define USE_OILMETER                // disable if you dont use the oilmeter
+  // #define USE_HTTPSERVER           // enable embedded http server (dashboard, /api, /metrics - no authentication!)
+  // #define USE_COMPACT_PAYLOAD      // enable compact MessagePack payload on <topic>/compact
+  // #define USE_INFLUXDB             // enable direct InfluxDB sink (line protocol)
+  // #define USE_LIVESTREAM           // enable live value stream for browsers (Server-Sent Events)
+  // #define USE_RAWBRIDGE            // enable raw KM271 byte stream via TCP (e.g. for service tools)
+  // #define USE_RAWBRIDGE_WRITE      // additionally accept write telegrams via TCP port 8272 (no authentication!)
+  // #define USE_MODBUS               // enable Modbus TCP server (port 502)
+  // #define USE_MULTICAST            // enable udp multicast of value changes (239.12.71.1:27271)
+  // #define USE_HISTORY              // enable value history on flash (LittleFS), export via http port 82
+  // #define USE_RULES                // enable on-device rules (JSON via mqtt <topic>/cmd/rules, stored on LittleFS)
+#endif
+
+#define LOG_MAX_LEVEL LOG_LVL_INFO  // highest compiled in log level: LOG_LVL_NONE / _ERROR / _WARN / _INFO / _DEBUG
 
 #define HOSTNAME "ESP_Buderus_KM271"
 #define MQTT_TOPIC "esp_heizung"
 
 #define WIFI_RECONNECT      5000    // Delay between wifi reconnection tries
 #define MQTT_RECONNECT      5000    // Delay between mqtt reconnection tries
+
+#define INFLUX_SERVER       "192.168.1.2"   // InfluxDB (or Telegraf) server
+#define INFLUX_PORT         8089            // udp listener (e.g. 8089) or http api (e.g. 8086)
+#define INFLUX_UDP                          // send batches via UDP, disable to use HTTP
+#define INFLUX_DB           "heating"       // database for HTTP write
@@ -0,0 +1,73 @@
+#pragma once
+
+// ======================================================
+// includes
+// ======================================================
+#include <config.h>
+#include <Arduino.h>
+#include <km271.h>
+#include <LittleFS.h>
+
+//*****************************************************************************
+// Defines
+//*****************************************************************************
+#define HISTORY_DIR         "/hist"   // directory of the day files on LittleFS
+#define HISTORY_DAYS        42        // day files older than this are deleted
+#define HISTORY_MIN_FREE    65536     // oldest day files are deleted if less space is free
+#define HISTORY_BUF_LEN     1024      // write buffer in RAM
+#define HISTORY_FLUSH_TIME  60000     // max age of the write buffer before it is written to flash
+#define HISTORY_FLUSH_FILL  512       // write buffer is written to flash once it holds this many bytes
+#define HISTORY_SEG_TIME    3600      // start a new segment (index entry + all values) every hour
+#define HISTORY_MAX_SEGS    4         // segments started in the write buffer
+#define HISTORY_READ_LEN    128       // read buffer for the export
+#define HISTORY_PORT        82        // port of the export server
+#define HISTORY_REQ_LEN     128       // max length of the request line
+#define HISTORY_OUT_LEN     512       // one http chunk of the export
+#define HISTORY_TIMEOUT     10000     // export client is closed without progress for this time [ms]
+
+//*****************************************************************************
+// Types
+//*****************************************************************************
+typedef struct {
+  uint32_t    time;                                     // start time of the segment
+  uint32_t    offset;                                   // offset in .dat (in the write buffer until flushed)
+  uint32_t    day;                                      // day file of the segment
+} s_histIndex;
+
+// buffered reader for one segment of a .dat file
+typedef struct {
+  File        *file;
+  uint8_t     buf[HISTORY_READ_LEN];
+  uint16_t    len;                                      // bytes in buf
+  uint16_t    pos;                                      // next byte in buf
+  uint32_t    remain;                                   // bytes of the segment not yet in buf
+} s_histReader;
+
+// position of an export, records are read one by one
+typedef struct {
+  uint32_t      from;                                   // first time to export
+  uint32_t      to;                                     // last time to export
+  uint32_t      day;                                    // actual day file
+  uint32_t      lastDay;                                // last day file to read
+  File          idx;                                    // index file of the actual day
+  File          dat;                                    // data file of the actual day
+  bool          open;                                   // files of the actual day are open
+  bool          inSeg;                                  // reading the records of a segment
+  bool          hasNext;                                // next is a valid index entry
+  s_histIndex   next;                                   // next index entry of the actual day
+  s_histReader  rd;                                     // reader of the actual segment
+  uint32_t      time;                                   // time of the last record
+  uint8_t       last[KM271_VAL_CNT];                    // last raw value per id in the actual segment
+} s_histIter;
+
+// ======================================================
+// Prototypes
+// ======================================================
+void setupHistory();
+void historyValueChanged(e_km271_valueId id, uint8_t raw, float value, void *ctx);
+void historyFlush();
+void histIterBegin(s_histIter *it, uint32_t from, uint32_t to);
+bool histIterNext(s_histIter *it, uint32_t *time, uint8_t *id, uint8_t *raw);
+void histIterEnd(s_histIter *it);
+void cyclicHistory();
+void sendHistoryInfo();
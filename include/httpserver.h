@@ -0,0 +1,19 @@
+#pragma once
+
+// ======================================================
+// includes
+// ======================================================
+#include <config.h>
+#include <Arduino.h>
+
+//*****************************************************************************
+// Defines
+//*****************************************************************************
+#define HTTP_PORT           80        // port of the embedded http server
+#define HTTP_CHUNK_LEN      256       // chunk size for streamed responses
+
+// ======================================================
+// Prototypes
+// ======================================================
+void setupHttpServer();
+void cyclicHttpServer();
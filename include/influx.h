@@ -0,0 +1,30 @@
+#pragma once
+
+// ======================================================
+// includes
+// ======================================================
+#include <config.h>
+#include <Arduino.h>
+#include <km271.h>
+
+//*****************************************************************************
+// Defines
+//*****************************************************************************
+#define INFLUX_BUF_LEN          1024      // preallocated buffer for one batch (2 are used)
+#define INFLUX_LINE_LEN         96        // max length of a single line
+#define INFLUX_FLUSH_TIME       10000     // max age of a batch before it is sent
+#define INFLUX_MEASUREMENT      "km271"   // measurement name
+#define INFLUX_HTTP_TIMEOUT     500       // HTTP connect and response timeout [ms]
+#define INFLUX_BACKOFF_MIN      10000     // no batch is sent this long after an error, doubled with every error
+#define INFLUX_BACKOFF_MAX      300000    // max time without sending after errors
+
+// ======================================================
+// Prototypes
+// ======================================================
+void setupInflux();
+void influxValueChanged(e_km271_valueId id, uint8_t raw, float value, void *ctx);
+void influxAddLine(const char *field, double value);
+void influxSwap();
+void influxFlush();
+void cyclicInflux();
+void sendInfluxInfo();
@@ -13,6 +13,8 @@
 #pragma once
 
 #include <Arduino.h>
+#include <config.h>
+#include <km271_proto.h>
 
 //*****************************************************************************
 // Defines
@@ -23,32 +25,12 @@
 #define KM271_EN_PARSELOG         0                                       // Enable/disable parsing logging (only blocks to be parsed are reported)
 #define KM271_EN_PARSE_RESULTLOG  1                                       // Enable/disable parsing result logging: Clear text logging.
 
-// Protocol elements. Do not change, otherwise KM271 communication will fail!
-#define KM271_BAUDRATE        2400                                        // The baudrate top be used for KM271 communication
-#define KM_STX                0x02                                        // Protocol control bytes
-#define KM_DLE                0x10
-#define KM_ETX                0x03
-#define KM_NAK                0x15
-
-#define KM_RX_BUF_LEN         20                                          // Max number of RX bytes 
 #define KM_TX_BUF_LEN         20                                          // Max number of TX bytes 
 
 // ********* Used UART-Pins to connect to KM271
 #define RXD2   4        // IO4               // ESP32 RX-pin for KM271 communication, align with hardware
 #define TXD2   2        // IO2               // ESP32 TX-pin for KM271 communication, align with hardware
 
-
-// The states to receive a single block of data.
-// First a block iof data is received byte by byte by using this state interpreter.
-// If a full block of data is received, a second level state interopreter is called to handle the blocks.
-typedef enum {
-  KM_RX_RESYNC,                                                           // Unknown state, re-sync by wait for STX
-  KM_RX_IDLE,                                                             // Idle state for RX interrupt routine
-  KM_RX_ON,                                                               // Block reception started
-  KM_RX_DLE,                                                              // DLE doubling
-  KM_RX_BCC,                                                              // Verify block
-} e_rxState;
-
 // The higher level states used in handleRxBlock();
 typedef enum {
   KM_TSK_START,                                                           // Switch to logging mode
@@ -56,12 +38,6 @@ typedef enum {
   KM_TSK_LOGGING,                                                         // Logging active
 } e_rxBlockState; 
 
-typedef struct {                                                          // Rx structure for one rx block
-  uint8_t                   len;                                          // Length of data in buffer
-  uint8_t                   buf[KM_RX_BUF_LEN];                           // Received bytes without "10 03 bcc"
-} KmRx_s;
-
-
 // This struicure contains all values read from the heating controller.
 // This structure is kept up-to-date automatically by the km27_prot.cpp.
 // Use km271GetStatus() to get the most recent copy of these values in a thread-safe manner.
@@ -108,24 +84,66 @@ typedef struct {
 } s_km271_status;
 
 
+
+// Protocol health counters
+typedef struct {
+  uint32_t                  rxBlocks;                                     // Valid data blocks received in log mode
+  uint32_t                  bccErrors;                                    // Blocks with wrong BCC (NAK sent)
+  uint32_t                  resyncs;                                      // Protocol errors that required a re-sync
+  uint32_t                  logModeStarts;                                // Log mode (re-)starts
+  uint32_t                  txTelegrams;                                  // Telegrams sent to the KM271
+  uint32_t                  txRetries;                                    // Telegrams sent again after a NAK
+  uint32_t                  txFailed;                                     // Telegrams dropped after KM271_TX_RETRIES NAKs
+} s_km271_protStats;
+
+// Callback for km271GetChangesSince()
+typedef void (*km271ChangeCallback)(e_km271_valueId id, uint8_t raw, uint32_t gen, void *ctx);
+
+// Observer callback for value changes of the register mirror
+typedef void (*km271ValueCallback)(e_km271_valueId id, uint8_t raw, float value, void *ctx);
+
+// Register groups of the controller, a group is identified by the register high byte.
+// A group is present if the controller sends log blocks of it (i.e. the module is installed).
+typedef enum {
+  KM271_GRP_HC1,                                                          // 0x80 : heating circuit 1
+  KM271_GRP_HC2,                                                          // 0x81 : heating circuit 2
+  KM271_GRP_HC3,                                                          // 0x82 : heating circuit 3 (module FM442)
+  KM271_GRP_HC4,                                                          // 0x83 : heating circuit 4 (module FM442)
+  KM271_GRP_DHW,                                                          // 0x84 : domestic hot water
+  KM271_GRP_BOILER,                                                       // 0x88 : boiler and burner
+  KM271_GRP_GENERAL,                                                      // 0x89 : outside temperature, versions, module
+  KM271_GRP_ALARM,                                                        // 0xaa : alarm status
+  KM271_GRP_CNT,
+} e_km271_group;
+
+#define KM271_TX_QUEUE_LEN    64                                          // write telegrams that can be queued for one batch (full restore: 51, checked in km271.cpp)
+#define KM271_TX_RETRIES      3                                           // a telegram refused with NAK is sent again this often
+#define KM271_PRG_CNT         2                                           // switching programs: HC1, HC2
+#define KM271_UNKNOWN_MAX     24                                          // registers in the statistics of not decoded registers
+#define KM271_UNSEEN_TIME     300000                                      // values not received this long after the start of log mode are reported as unseen [ms]
+
+#define KM271_MAX_OBSERVERS   48                                          // max number of value subscriptions (all modules)
+
 // Return values used by the KM271 protocol functions
 typedef enum {
   RET_OK = 0,
   RET_ERR,
 } e_ret;
 
-// send commands to KM271
-typedef enum {
-  KM271_SENDCMD_HK1_BA,         // HK1 Betriebsart
-  KM271_SENDCMD_HK1_AUSLEGUNG,  // HK1 Auslegung
-  KM271_SENDCMD_HK1_PROGRAMM,   // HK1 Programm
-  KM271_SENDCMD_WW_BA,          // Warmwasser Vetriebsart
-  KM271_SENDCMD_SOMMER_AB,      // Sommer ab
-  KM271_SENDCMD_FROST_AB,       // Frost ab
-  KM271_SENDCMD_AUSSENHALT,     // Aussehnhalt ab
-  KM271_SENDCMD_WW_SOLL,        // Warmwasser soll
-} e_km271_sendCmd;
 
+// Stages of a setvalue command, used for the command latency histogram
+typedef enum {
+  KM271_CMD_STAGE_RECEIVED,     // mqttCallback receipt
+  KM271_CMD_STAGE_QUEUED,       // queued in the send queue
+  KM271_CMD_STAGE_GRANTED,      // STX granted by the controller (DLE received)
+  KM271_CMD_STAGE_SENT,         // telegram sent
+  KM271_CMD_STAGE_ACKED,        // DLE acknowledged by the controller
+  KM271_CMD_STAGE_CONFIRMED,    // first log block confirming the new value
+  KM271_CMD_STAGE_CNT,
+} e_km271_cmdStage;
+
+#define KM271_LAT_BUCKETS     17                                          // histogram buckets: <1ms, <2ms, <4ms ... <32s, >=32s
+#define KM271_LAT_TIMEOUT     120000                                      // abandon latency measurement of a command after 2 minutes
 
 //*****************************************************************************
 // Function prototypes
@@ -135,10 +153,49 @@ void  km271GetStatus(s_km271_status *pDestStatus);                // Retrieves t
 void sendTxBlock(uint8_t *data, int len);
 void handleRxBlock(uint8_t *data, int len, uint8_t bcc);
 void parseInfo(uint8_t *data, int len);
-float decode05cTemp(uint8_t data);
-float decodeNegTemp(uint8_t data);
+void km271PublishBlock(uint16_t kmregister, uint8_t *data, s_km271_status &tmpState);
 void cyclicKM271();
 void sendKM271Info();
 void km271sendCmd(e_km271_sendCmd sendCmd, uint8_t cmdPara);
+bool km271GetCmdValue(e_km271_sendCmd sendCmd, int *pValue);
 bool km271GetLogMode();
-void km271SetDateTime();
\ No newline at end of file
+void km271GetProtStats(s_km271_protStats *pStats);
+void km271SetDateTime();
+void km271CmdMarkReceived(bool active);
+void cmdLatQueued(const uint8_t *telegram);
+void cmdLatMark(e_km271_cmdStage stage);
+void sendKM271Latency();
+uint16_t km271WriteBaseRegister(uint8_t type);
+int   km271FindValue(uint16_t reg);
+void  km271UpdateValue(e_km271_valueId id, uint8_t raw);
+bool  km271GetValue(e_km271_valueId id, uint8_t *pRaw);
+float km271DecodeValue(e_km271_valueId id, uint8_t raw);
+const s_km271_valueDef *km271GetValueDef(e_km271_valueId id);
+const char *km271ValueTypeName(e_km271_valueType type);
+uint32_t km271GetEpoch();
+uint32_t km271GetChangesSince(uint32_t epoch, uint32_t since, km271ChangeCallback callback, void *ctx);
+void sendKM271Changes(uint32_t epoch, uint32_t since);
+bool km271Subscribe(e_km271_valueId id, km271ValueCallback callback, void *ctx);
+int  km271SubscribeRange(uint16_t firstReg, uint16_t lastReg, km271ValueCallback callback, void *ctx);
+bool km271SubscribeAll(km271ValueCallback callback, void *ctx);
+bool km271QueueTelegram(const uint8_t *telegram);
+uint8_t km271TxQueueFree();
+bool km271WriteAllowed(const uint8_t *telegram);
+void km271TxQueuePop(uint8_t *telegram);
+int  km271ConfigIndex(uint16_t reg);
+uint16_t km271ConfigRegister(int idx);
+void km271StoreConfigBlock(uint16_t reg, const uint8_t *data);
+uint8_t *km271ProgramBlock(uint8_t prg, uint8_t block);
+int  km271MissingConfigBlocks(char *list, size_t len);
+void sendKM271ConfigBackup();
+bool km271RestoreConfig(const char *json);
+void km271ParseProgramBlock(uint8_t prg, uint8_t block, uint8_t *data);
+void km271RepublishConfig();
+void sendKM271ProgramDay(uint8_t prg, uint8_t day);
+bool km271SetProgramDay(uint8_t prg, const char *dayName, const char *points);
+void km271UnknownAdd(uint16_t reg, const uint8_t *data, int len);
+void sendKM271Unknown();
+void km271SetTrace(const char *param);
+void km271TraceSend(uint16_t reg, const uint8_t *data, int len);
+uint16_t km271GetGroups();
+void sendKM271Modules();
\ No newline at end of file
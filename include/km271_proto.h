@@ -0,0 +1,205 @@
+//*****************************************************************************
+// 
+// Title      : KM271 protocol decoding without Arduino dependencies
+// Remark     : 3964R receive state machine, register table, value decoding and
+//              write telegrams of the setvalue commands.
+//              Used by the firmware (km271.cpp) and by the host tools in tools/.
+//              On the host the feature switches of config.h (USE_HC2, ...)
+//              are given on the compiler command line.
+//
+//*****************************************************************************
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#ifdef ARDUINO
+  #include <config.h>
+#endif
+
+//*****************************************************************************
+// Defines
+//*****************************************************************************
+
+// Protocol elements. Do not change, otherwise KM271 communication will fail!
+#define KM271_BAUDRATE        2400                                        // The baudrate top be used for KM271 communication
+#define KM_STX                0x02                                        // Protocol control bytes
+#define KM_DLE                0x10
+#define KM_ETX                0x03
+#define KM_NAK                0x15
+
+#define KM_RX_BUF_LEN         20                                          // Max number of RX bytes 
+
+// The states to receive a single block of data.
+// First a block iof data is received byte by byte by using this state interpreter.
+// If a full block of data is received, a second level state interopreter is called to handle the blocks.
+typedef enum {
+  KM_RX_RESYNC,                                                           // Unknown state, re-sync by wait for STX
+  KM_RX_IDLE,                                                             // Idle state for RX interrupt routine
+  KM_RX_ON,                                                               // Block reception started
+  KM_RX_DLE,                                                              // DLE doubling
+  KM_RX_BCC,                                                              // Verify block
+} e_rxState;
+
+typedef struct {                                                          // Rx structure for one rx block
+  uint8_t                   len;                                          // Length of data in buffer
+  uint8_t                   buf[KM_RX_BUF_LEN];                           // Received bytes without "10 03 bcc"
+} KmRx_s;
+
+// Receive state of one 3964R byte stream
+typedef struct {
+  e_rxState                 state;                                        // Status in Rx reception
+  uint8_t                   bcc;                                          // BCC value for Rx Block
+  KmRx_s                    block;                                        // Rx block storage
+} s_km271_rx;
+
+// Result of km271RxByte()
+typedef enum {
+  KM271_RX_NONE,                                                          // nothing to do
+  KM271_RX_CTRL,                                                          // single control byte (STX, DLE, NAK) in block.buf[0]
+  KM271_RX_BLOCK,                                                         // valid data block in block
+  KM271_RX_BCC_ERR,                                                       // block with wrong BCC, has to be NAKed
+  KM271_RX_RESYNC,                                                        // protocol error, waiting for STX
+} e_km271_rxResult;
+
+// Value types of the status registers in the register mirror
+typedef enum {
+  KM271_VT_NUMBER,                                                        // Number / Minutes / Percent
+  KM271_VT_BITFIELD,                                                      // Bitfield
+  KM271_VT_TEMP,                                                          // Temperature (1C resolution)
+  KM271_VT_TEMP05,                                                        // Temperature (0.5C resolution)
+  KM271_VT_TEMPNEG,                                                       // Temperature (1C resolution, possibly negative)
+} e_km271_valueType;
+
+// Ids of the status values in the register mirror.
+// The order has to match the value table kmValueDefs[] in km271_proto.cpp (sorted by register).
+typedef enum {
+  KM271_VAL_HC1_OPERATING_STATES_1,                                       // 0x8000
+  KM271_VAL_HC1_OPERATING_STATES_2,                                       // 0x8001
+  KM271_VAL_HC1_FLOW_SETPOINT,                                            // 0x8002
+  KM271_VAL_HC1_FLOW_TEMPERATURE,                                         // 0x8003
+  KM271_VAL_HC1_ROOM_SETPOINT,                                            // 0x8004
+  KM271_VAL_HC1_ROOM_TEMPERATURE,                                         // 0x8005
+  KM271_VAL_HC1_ON_TIME_OPTIMIZATION,                                     // 0x8006
+  KM271_VAL_HC1_OFF_TIME_OPTIMIZATION,                                    // 0x8007
+  KM271_VAL_HC1_PUMP,                                                     // 0x8008
+  KM271_VAL_HC1_MIXER,                                                    // 0x8009
+  KM271_VAL_HC1_HEAT_CURVE_PLUS10,                                        // 0x800c
+  KM271_VAL_HC1_HEAT_CURVE_0,                                             // 0x800d
+  KM271_VAL_HC1_HEAT_CURVE_MINUS10,                                       // 0x800e
+#ifdef USE_HC2
+  KM271_VAL_HC2_OPERATING_STATES_1,                                       // 0x8112
+  KM271_VAL_HC2_OPERATING_STATES_2,                                       // 0x8113
+  KM271_VAL_HC2_FLOW_SETPOINT,                                            // 0x8114
+  KM271_VAL_HC2_FLOW_TEMPERATURE,                                         // 0x8115
+  KM271_VAL_HC2_ROOM_SETPOINT,                                            // 0x8116
+  KM271_VAL_HC2_ROOM_TEMPERATURE,                                         // 0x8117
+  KM271_VAL_HC2_ON_TIME_OPTIMIZATION,                                     // 0x8118
+  KM271_VAL_HC2_OFF_TIME_OPTIMIZATION,                                    // 0x8119
+  KM271_VAL_HC2_PUMP,                                                     // 0x811a
+  KM271_VAL_HC2_MIXER,                                                    // 0x811b
+  KM271_VAL_HC2_HEAT_CURVE_PLUS10,                                        // 0x811e
+  KM271_VAL_HC2_HEAT_CURVE_0,                                             // 0x811f
+  KM271_VAL_HC2_HEAT_CURVE_MINUS10,                                       // 0x8120
+#endif
+#ifdef USE_HC3_HC4
+  KM271_VAL_HC3_OPERATING_STATES_1,                                       // 0x8224
+  KM271_VAL_HC3_OPERATING_STATES_2,                                       // 0x8225
+  KM271_VAL_HC3_FLOW_SETPOINT,                                            // 0x8226
+  KM271_VAL_HC3_FLOW_TEMPERATURE,                                         // 0x8227
+  KM271_VAL_HC3_ROOM_SETPOINT,                                            // 0x8228
+  KM271_VAL_HC3_ROOM_TEMPERATURE,                                         // 0x8229
+  KM271_VAL_HC3_ON_TIME_OPTIMIZATION,                                     // 0x822a
+  KM271_VAL_HC3_OFF_TIME_OPTIMIZATION,                                    // 0x822b
+  KM271_VAL_HC3_PUMP,                                                     // 0x822c
+  KM271_VAL_HC3_MIXER,                                                    // 0x822d
+  KM271_VAL_HC3_HEAT_CURVE_PLUS10,                                        // 0x8230
+  KM271_VAL_HC3_HEAT_CURVE_0,                                             // 0x8231
+  KM271_VAL_HC3_HEAT_CURVE_MINUS10,                                       // 0x8232
+  KM271_VAL_HC4_OPERATING_STATES_1,                                       // 0x8336
+  KM271_VAL_HC4_OPERATING_STATES_2,                                       // 0x8337
+  KM271_VAL_HC4_FLOW_SETPOINT,                                            // 0x8338
+  KM271_VAL_HC4_FLOW_TEMPERATURE,                                         // 0x8339
+  KM271_VAL_HC4_ROOM_SETPOINT,                                            // 0x833a
+  KM271_VAL_HC4_ROOM_TEMPERATURE,                                         // 0x833b
+  KM271_VAL_HC4_ON_TIME_OPTIMIZATION,                                     // 0x833c
+  KM271_VAL_HC4_OFF_TIME_OPTIMIZATION,                                    // 0x833d
+  KM271_VAL_HC4_PUMP,                                                     // 0x833e
+  KM271_VAL_HC4_MIXER,                                                    // 0x833f
+  KM271_VAL_HC4_HEAT_CURVE_PLUS10,                                        // 0x8342
+  KM271_VAL_HC4_HEAT_CURVE_0,                                             // 0x8343
+  KM271_VAL_HC4_HEAT_CURVE_MINUS10,                                       // 0x8344
+#endif
+  KM271_VAL_DHW_OPERATING_STATES_1,                                       // 0x8424
+  KM271_VAL_DHW_OPERATING_STATES_2,                                       // 0x8425
+  KM271_VAL_DHW_SETPOINT,                                                 // 0x8426
+  KM271_VAL_DHW_TEMPERATURE,                                              // 0x8427
+  KM271_VAL_DHW_OPTIMIZATION_TIME,                                        // 0x8428
+  KM271_VAL_DHW_PUMP_STATES,                                              // 0x8429
+  KM271_VAL_BOILER_SETPOINT,                                              // 0x882a
+  KM271_VAL_BOILER_TEMPERATURE,                                           // 0x882b
+  KM271_VAL_BURNER_SWITCH_ON_TEMPERATURE,                                 // 0x882c
+  KM271_VAL_BURNER_SWITCH_OFF_TEMPERATURE,                                // 0x882d
+  KM271_VAL_BOILER_INTEGRAL_1,                                            // 0x882e
+  KM271_VAL_BOILER_INTEGRAL_2,                                            // 0x882f
+  KM271_VAL_BOILER_ERROR_STATES,                                          // 0x8830
+  KM271_VAL_BOILER_OPERATING_STATES,                                      // 0x8831
+  KM271_VAL_BURNER_CONTROL,                                               // 0x8832
+  KM271_VAL_EXHAUST_GAS_TEMPERATURE,                                      // 0x8833
+  KM271_VAL_BURNER_LIFETIME_MINUTES65536,                                 // 0x8836
+  KM271_VAL_BURNER_LIFETIME_MINUTES256,                                   // 0x8837
+  KM271_VAL_BURNER_LIFETIME_MINUTES,                                      // 0x8838
+  KM271_VAL_OUTSIDE_TEMPERATURE,                                          // 0x893c
+  KM271_VAL_OUTSIDE_TEMPERATURE_DAMPED,                                   // 0x893d
+  KM271_VAL_VERSION_VK,                                                   // 0x893e
+  KM271_VAL_VERSION_NK,                                                   // 0x893f
+  KM271_VAL_MODULE_ID,                                                    // 0x8940
+  KM271_VAL_ERR_ALARM_STATUS,                                             // 0xaa42
+  KM271_VAL_CNT,
+} e_km271_valueId;
+
+// Definition of one value in the register mirror
+typedef struct {
+  uint16_t                  reg;                                          // KM271 register address
+  e_km271_valueType         type;                                         // How to decode the raw byte
+  const char               *name;                                         // Name, equal to the mqtt status topic where possible
+} s_km271_valueDef;
+
+// send commands to KM271
+typedef enum {
+  KM271_SENDCMD_HK1_BA,         // HK1 Betriebsart
+  KM271_SENDCMD_HK1_AUSLEGUNG,  // HK1 Auslegung
+  KM271_SENDCMD_HK1_PROGRAMM,   // HK1 Programm
+  KM271_SENDCMD_WW_BA,          // Warmwasser Vetriebsart
+  KM271_SENDCMD_SOMMER_AB,      // Sommer ab
+  KM271_SENDCMD_FROST_AB,       // Frost ab
+  KM271_SENDCMD_AUSSENHALT,     // Aussehnhalt ab
+  KM271_SENDCMD_WW_SOLL,        // Warmwasser soll
+  KM271_SENDCMD_CNT,
+} e_km271_sendCmd;
+
+// Setvalue commands: one data byte of a write telegram
+typedef struct {
+  uint8_t                   type;                                         // write telegram type
+  uint8_t                   offset;                                       // write telegram offset
+  uint8_t                   pos;                                          // position of the value in the telegram (2..7)
+  int8_t                    min;                                          // valid range, min < 0: signed byte
+  uint8_t                   max;
+  const char               *name;                                         // name of the mqtt setvalue topic and the rules
+} s_km271_cmdDef;
+
+//*****************************************************************************
+// Variables
+//*****************************************************************************
+extern const s_km271_valueDef kmValueDefs[KM271_VAL_CNT];                 // register table, sorted by register
+extern const s_km271_cmdDef kmCmdDefs[KM271_SENDCMD_CNT];                 // setvalue commands
+
+//*****************************************************************************
+// Function prototypes
+//*****************************************************************************
+e_km271_rxResult km271RxByte(s_km271_rx *rx, uint8_t rxByte);
+int   km271FindValueDef(uint16_t reg);
+int   km271FindCmdDef(const char *name);
+float km271DecodeRaw(e_km271_valueType type, uint8_t raw);
+bool  km271CmdTelegram(e_km271_sendCmd sendCmd, int value, uint8_t *telegram);
+float decode05cTemp(uint8_t data);
+float decodeNegTemp(uint8_t data);
@@ -0,0 +1,24 @@
+#pragma once
+
+// ======================================================
+// includes
+// ======================================================
+#include <config.h>
+#include <Arduino.h>
+#include <km271.h>
+
+//*****************************************************************************
+// Defines
+//*****************************************************************************
+#define LIVE_PORT           81        // port of the Server-Sent Events live stream
+#define LIVE_MAX_CLIENTS    4         // max number of connected browsers
+#define LIVE_OUT_LEN        160       // output buffer per client (one event)
+#define LIVE_EVENTS_CYCLE   4         // max events per client and cyclic call
+#define LIVE_KEEPALIVE      15000     // keepalive interval if nothing has changed
+
+// ======================================================
+// Prototypes
+// ======================================================
+void setupLiveStream();
+void liveStreamValueChanged(e_km271_valueId id, uint8_t raw, float value, void *ctx);
+void cyclicLiveStream();
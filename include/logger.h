@@ -0,0 +1,77 @@
+#pragma once
+
+// ======================================================
+// includes
+// ======================================================
+#include <config.h>
+#include <Arduino.h>
+
+//*****************************************************************************
+// Defines
+//*****************************************************************************
+#define LOG_LVL_NONE        0         // logging off
+#define LOG_LVL_ERROR       1
+#define LOG_LVL_WARN        2
+#define LOG_LVL_INFO        3
+#define LOG_LVL_DEBUG       4
+
+#ifndef LOG_MAX_LEVEL
+  #define LOG_MAX_LEVEL     LOG_LVL_INFO  // higher levels are not compiled in
+#endif
+
+#define LOG_RING_LEN        32        // number of records in the ring, has to be a power of 2
+#define LOG_STR_LEN         40        // max length of a copied string argument
+#define LOG_LINE_LEN        128       // max length of a formatted line
+#define LOG_MQTT_LEVEL      LOG_LVL_WARN  // records up to this level are also published via mqtt
+#define LOG_PORT            23        // port of the tcp log client (e.g. nc <ip> 23)
+#define LOG_TASK_PRIO       1         // priority of the drain task (loop task = 1)
+#define LOG_TASK_STACK      3072      // stack size of the drain task
+
+// ======================================================
+// Macros
+// ======================================================
+// fmt has to be a string constant, it is formatted later by the drain task.
+// Arguments are stored as uint32_t (integers only). The _S variants copy one
+// string as first argument of fmt, e.g. LOG_I_S("topic: %s", topic)
+#if LOG_MAX_LEVEL >= LOG_LVL_ERROR
+  #define LOG_E(fmt, ...)         do { if (logLevel >= LOG_LVL_ERROR) logWrite(LOG_LVL_ERROR, NULL, fmt, ##__VA_ARGS__); } while (0)
+  #define LOG_E_S(fmt, str, ...)  do { if (logLevel >= LOG_LVL_ERROR) logWrite(LOG_LVL_ERROR, str, fmt, ##__VA_ARGS__); } while (0)
+#else
+  #define LOG_E(fmt, ...)         do {} while (0)
+  #define LOG_E_S(fmt, str, ...)  do {} while (0)
+#endif
+#if LOG_MAX_LEVEL >= LOG_LVL_WARN
+  #define LOG_W(fmt, ...)         do { if (logLevel >= LOG_LVL_WARN) logWrite(LOG_LVL_WARN, NULL, fmt, ##__VA_ARGS__); } while (0)
+  #define LOG_W_S(fmt, str, ...)  do { if (logLevel >= LOG_LVL_WARN) logWrite(LOG_LVL_WARN, str, fmt, ##__VA_ARGS__); } while (0)
+#else
+  #define LOG_W(fmt, ...)         do {} while (0)
+  #define LOG_W_S(fmt, str, ...)  do {} while (0)
+#endif
+#if LOG_MAX_LEVEL >= LOG_LVL_INFO
+  #define LOG_I(fmt, ...)         do { if (logLevel >= LOG_LVL_INFO) logWrite(LOG_LVL_INFO, NULL, fmt, ##__VA_ARGS__); } while (0)
+  #define LOG_I_S(fmt, str, ...)  do { if (logLevel >= LOG_LVL_INFO) logWrite(LOG_LVL_INFO, str, fmt, ##__VA_ARGS__); } while (0)
+#else
+  #define LOG_I(fmt, ...)         do {} while (0)
+  #define LOG_I_S(fmt, str, ...)  do {} while (0)
+#endif
+#if LOG_MAX_LEVEL >= LOG_LVL_DEBUG
+  #define LOG_D(fmt, ...)         do { if (logLevel >= LOG_LVL_DEBUG) logWrite(LOG_LVL_DEBUG, NULL, fmt, ##__VA_ARGS__); } while (0)
+  #define LOG_D_S(fmt, str, ...)  do { if (logLevel >= LOG_LVL_DEBUG) logWrite(LOG_LVL_DEBUG, str, fmt, ##__VA_ARGS__); } while (0)
+#else
+  #define LOG_D(fmt, ...)         do {} while (0)
+  #define LOG_D_S(fmt, str, ...)  do {} while (0)
+#endif
+
+// ======================================================
+// Variables
+// ======================================================
+extern uint8_t logLevel;                                  // actual runtime level
+
+// ======================================================
+// Prototypes
+// ======================================================
+void setupLogger();
+void logWrite(uint8_t level, const char *str, const char *fmt, uint32_t a0 = 0, uint32_t a1 = 0, uint32_t a2 = 0);
+void logSetLevel(uint8_t level);
+void logFlush();
+void cyclicLogger();
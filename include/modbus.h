@@ -0,0 +1,23 @@
+#pragma once
+
+// ======================================================
+// includes
+// ======================================================
+#include <config.h>
+#include <Arduino.h>
+#include <km271.h>
+
+//*****************************************************************************
+// Defines
+//*****************************************************************************
+#define MB_PORT             502       // Modbus TCP port
+#define MB_MAX_CLIENTS      4         // max number of connected pollers
+#define MB_ADU_LEN          260       // max Modbus TCP frame (MBAP header + PDU)
+#define MB_MAX_READ         125       // max registers per read request
+#define MB_INVALID          0x8000    // register value of a value that was not received yet
+
+// ======================================================
+// Prototypes
+// ======================================================
+void setupModbus();
+void cyclicModbus();
@@ -8,8 +8,45 @@
 
 // MQTT
 #include <PubSubClient.h>
+#include <ArduinoJson.h>
 
 
+// ======================================================
+// types
+// ======================================================
+
+// topic classes used for publish statistics and load shedding
+typedef enum {
+  MQTT_CLASS_STATUS,          // status values (high priority)
+  MQTT_CLASS_MESSAGE,         // command feedback messages
+  MQTT_CLASS_CONFIG,          // config values (low priority, shed first)
+  MQTT_CLASS_OTHER,           // info, debug and everything else (low priority)
+  MQTT_CLASS_CNT,
+} e_mqttTopicClass;
+
+// backpressure state of the outgoing queue
+typedef enum {
+  MQTT_BP_NONE,               // messages are sent as fast as they arrive
+  MQTT_BP_HIGH,               // queue above high-water mark, low priority messages are shed
+  MQTT_BP_FULL,               // queue full, all new messages are dropped
+} e_mqttBackpressure;
+
+// publish statistics per topic class
+typedef struct {
+  uint32_t  sent;             // messages accepted by the socket
+  uint32_t  failed;           // publish attempts refused by the socket
+  uint32_t  dropped;          // messages discarded because of backpressure
+  uint32_t  bytes;            // payload bytes sent
+} s_mqttStats;
+
+// broker round-trip time statistics (self-ping)
+typedef struct {
+  uint16_t  samples;          // number of valid samples
+  uint32_t  min;              // minimum round-trip time in ms
+  uint32_t  avg;              // average round-trip time in ms
+  uint32_t  p99;              // 99th percentile round-trip time in ms
+} s_mqttRtt;
+
 // ======================================================
 // Prototypes
 // ======================================================
@@ -18,4 +55,15 @@ void mqtt_callback(char* topic, byte* payload, unsigned int length);
 void mqttCyclic();
 void mqttSetup();
 void mqtt_reconnect();
-void mqttPublish(const char* sendtopic, const char* payload, boolean retained);
+bool mqttPublish(const char* sendtopic, const char* payload, boolean retained);
+void mqttSendQueue();
+uint8_t mqttQueueFree();
+e_mqttBackpressure mqttGetBackpressure();
+void mqttStatShed(e_mqttTopicClass topicClass);
+void sendMqttInfo();
+const char *mqttGetStats(e_mqttTopicClass topicClass, s_mqttStats *pStats);
+void mqttPing();
+void mqttPingReceived(const char* payload);
+void mqttGetRtt(s_mqttRtt *pRtt);
+bool mqttPublishJson(const char* sendtopic, const JsonDocument& doc, boolean retained);
+bool mqttPublishBinary(const char* sendtopic, const uint8_t* payload, size_t len, boolean retained);
@@ -0,0 +1,27 @@
+#pragma once
+
+// ======================================================
+// includes
+// ======================================================
+#include <config.h>
+#include <Arduino.h>
+#include <km271.h>
+
+//*****************************************************************************
+// Defines
+//*****************************************************************************
+#define MCAST_GROUP         IPAddress(239, 12, 71, 1)   // multicast group
+#define MCAST_PORT          27271     // udp port
+#define MCAST_VERSION       1         // datagram format version
+#define MCAST_DELTA_TIME    20        // collect changes for max. 20ms before sending
+#define MCAST_FULL_TIME     5000      // interval of the full state datagram
+#define MCAST_HEADER_LEN    17        // magic, version, type, sequence, decode time, count
+#define MCAST_TYPE_DELTA    0         // datagram with changed values
+#define MCAST_TYPE_FULL     1         // datagram with all values
+
+// ======================================================
+// Prototypes
+// ======================================================
+void setupMulticast();
+void multicastValueChanged(e_km271_valueId id, uint8_t raw, float value, void *ctx);
+void cyclicMulticast();
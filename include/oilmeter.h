@@ -19,6 +19,7 @@
 // Prototypes
 // ======================================================
 void sendOilmeter();
+long getOilmeter();
 void cmdSetOilmeter(long setvalue);
 void setupOilmeter();
 void cyclicOilmeter();
@@ -0,0 +1,26 @@
+#pragma once
+
+// ======================================================
+// includes
+// ======================================================
+#include <config.h>
+#include <Arduino.h>
+#include <km271.h>
+#include <km271_proto.h>
+
+//*****************************************************************************
+// Defines
+//*****************************************************************************
+#define RAW_PORT            8271      // port of the raw KM271 byte stream
+#define RAW_MAX_CLIENTS     4         // max number of connected clients
+#define RAW_RING_LEN        2048      // shared receive ring, has to be a power of 2
+#define RAW_WRITE_PORT      8272      // port for write telegrams (3964R framed), only with USE_RAWBRIDGE_WRITE
+#define RAW_BYTE_TIMEOUT    500       // max. time between two bytes of a write telegram [ms]
+
+// ======================================================
+// Prototypes
+// ======================================================
+void setupRawBridge();
+void rawBridgeAdd(uint8_t rxByte);
+void cyclicRawBridge();
+void sendRawBridgeInfo();
@@ -0,0 +1,28 @@
+#pragma once
+
+// ======================================================
+// includes
+// ======================================================
+#include <config.h>
+#include <Arduino.h>
+#include <km271.h>
+
+//*****************************************************************************
+// Defines
+//*****************************************************************************
+#define RULES_FILE          "/rules.json" // rules stored on LittleFS
+#define RULES_MAX           16        // max number of rules
+#define RULES_MAX_CONDS     48        // max number of conditions of all rules
+#define RULES_RULE_CONDS    8         // max number of conditions of one rule
+#define RULES_NAME_LEN      24        // max length of a rule name
+#define RULES_JSON_LEN      4096      // memory to parse the rules
+#define RULES_INTERVAL      60        // default min. time between two commands of a rule [s]
+
+// ======================================================
+// Prototypes
+// ======================================================
+void setupRules();
+bool rulesLoad(const char *json, bool store);
+void rulesValueChanged(e_km271_valueId id, uint8_t raw, float value, void *ctx);
+void cyclicRules();
+void sendRulesInfo();
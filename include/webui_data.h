@@ -0,0 +1,66 @@
+#pragma once
+
+// generated by tools/webui_gen.py from web/dashboard.html - do not edit
+
+#include <Arduino.h>
+
+#define DASHBOARD_ETAG "\"0f14d28db90d2183\""
+
+const uint8_t dashboard_html_gz[] PROGMEM = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x8d, 0x55, 0x4b, 0x8f, 0xdb, 0x36,
+  0x10, 0xbe, 0xeb, 0x57, 0x70, 0xb9, 0x17, 0x09, 0x6b, 0x4b, 0x96, 0xf3, 0x68, 0x22, 0x59, 0x2e,
+  0x90, 0xed, 0x1e, 0xd2, 0xb4, 0x9b, 0xa0, 0x9b, 0x4b, 0x50, 0xf4, 0x40, 0x8b, 0x23, 0x8b, 0x2d,
+  0x45, 0x0a, 0x24, 0x65, 0xaf, 0xab, 0xfa, 0xbf, 0x77, 0xa8, 0x47, 0xd7, 0x9b, 0x22, 0x40, 0x60,
+  0x18, 0x24, 0xe7, 0xf9, 0xcd, 0x37, 0x43, 0x6a, 0x73, 0xf5, 0xd3, 0xc7, 0xdb, 0xcf, 0x5f, 0x3e,
+  0xdd, 0x91, 0xda, 0x35, 0x72, 0x1b, 0x6c, 0xfc, 0x42, 0x24, 0x53, 0xfb, 0x82, 0x82, 0xa2, 0x5e,
+  0x00, 0x8c, 0xe3, 0xd2, 0x80, 0x63, 0xa4, 0xac, 0x99, 0xb1, 0xe0, 0x0a, 0xda, 0xb9, 0x6a, 0xf9,
+  0x86, 0xce, 0x62, 0xc5, 0x1a, 0x28, 0xe8, 0x41, 0xc0, 0xb1, 0xd5, 0xc6, 0x51, 0x52, 0x6a, 0xe5,
+  0x40, 0xa1, 0xd9, 0x51, 0x70, 0x57, 0x17, 0x1c, 0x0e, 0xa2, 0x84, 0xe5, 0x70, 0x58, 0x10, 0xa1,
+  0x84, 0x13, 0x4c, 0x2e, 0x6d, 0xc9, 0x24, 0x14, 0xa9, 0x0f, 0xe2, 0x84, 0x93, 0xb0, 0xbd, 0x7b,
+  0xf8, 0x44, 0xde, 0x75, 0x1c, 0x4c, 0x67, 0xc9, 0x87, 0x5f, 0xd7, 0x3f, 0xa4, 0x9b, 0x64, 0x54,
+  0x04, 0x1b, 0xeb, 0x4e, 0x7e, 0xdd, 0x69, 0x7e, 0xea, 0x2b, 0x0c, 0xbe, 0xac, 0x58, 0x23, 0xe4,
+  0x29, 0xb3, 0x4c, 0xd9, 0xa5, 0x05, 0x23, 0xaa, 0xbc, 0x61, 0x66, 0x2f, 0x54, 0xb6, 0xca, 0x77,
+  0xac, 0xfc, 0x6b, 0x6f, 0x74, 0xa7, 0x78, 0x76, 0x5d, 0xad, 0xfd, 0x2f, 0x2f, 0xb5, 0xd4, 0x26,
+  0xbb, 0x5e, 0xaf, 0xd7, 0xe7, 0xc0, 0x97, 0x03, 0xa6, 0xbf, 0xb4, 0x4a, 0xe1, 0x15, 0x7b, 0xfb,
+  0x7a, 0xb6, 0xaa, 0xaa, 0x2a, 0x6f, 0x19, 0xe7, 0x42, 0xed, 0xb3, 0x74, 0xd5, 0x3e, 0x92, 0xf4,
+  0x75, 0xfb, 0x38, 0xfb, 0x11, 0xdb, 0x32, 0xd5, 0x57, 0x52, 0x33, 0x97, 0x19, 0xb1, 0xaf, 0x5d,
+  0x3e, 0xc0, 0xb1, 0xe2, 0x6f, 0xc8, 0xe2, 0xb7, 0xd0, 0x9c, 0x03, 0xc7, 0x76, 0x12, 0xfa, 0x9d,
+  0x36, 0x68, 0xbd, 0xc4, 0x90, 0x92, 0xb5, 0x16, 0xb2, 0x79, 0x33, 0xc3, 0xf4, 0x31, 0x9f, 0x23,
+  0xc5, 0xac, 0x8d, 0x50, 0x23, 0x49, 0xd9, 0x8b, 0xf5, 0xca, 0xe7, 0x74, 0xbc, 0x9f, 0x91, 0xbc,
+  0xf4, 0x40, 0xd6, 0xde, 0x69, 0x8c, 0xbc, 0xd3, 0xce, 0xe9, 0x26, 0x4b, 0x51, 0x6c, 0xb5, 0x14,
+  0x9c, 0x5c, 0x73, 0xce, 0xbd, 0x47, 0x7c, 0xe8, 0x1d, 0x3c, 0xba, 0x25, 0x93, 0x62, 0xaf, 0x2e,
+  0x31, 0x1e, 0xc1, 0xef, 0xb3, 0x9d, 0x96, 0x68, 0x17, 0x97, 0xf5, 0xbe, 0xff, 0x2a, 0xff, 0x8b,
+  0xdd, 0xea, 0x1c, 0x6c, 0x92, 0x89, 0xeb, 0x4d, 0x32, 0x35, 0xde, 0x93, 0x3e, 0x8d, 0x01, 0x98,
+  0xff, 0x37, 0x89, 0x6c, 0x3c, 0x25, 0x44, 0xf0, 0x82, 0x5a, 0x47, 0xb7, 0x4b, 0x0c, 0x80, 0xe7,
+  0xed, 0xe8, 0x8e, 0x0e, 0xd8, 0x5d, 0xcf, 0xc8, 0x60, 0x80, 0x3b, 0x8a, 0x9a, 0x41, 0xe0, 0xbb,
+  0x5a, 0x1a, 0xd1, 0xba, 0x6d, 0x70, 0x60, 0x86, 0x18, 0x7d, 0xb4, 0x45, 0x7f, 0xce, 0x83, 0xaa,
+  0x53, 0xa5, 0x13, 0x5a, 0x79, 0x49, 0xa8, 0xa2, 0x3e, 0x20, 0x44, 0x54, 0xe1, 0x95, 0xd7, 0xff,
+  0xae, 0xfe, 0x18, 0xce, 0x84, 0x78, 0x0f, 0x67, 0x0a, 0xae, 0xcb, 0xae, 0xc1, 0x41, 0x8b, 0xf7,
+  0xe0, 0xee, 0x24, 0xf8, 0xed, 0xbb, 0xd3, 0x7b, 0x1e, 0x0e, 0x89, 0xa2, 0x58, 0x28, 0x1c, 0x0d,
+  0xf7, 0x1b, 0xc6, 0x59, 0xa6, 0x51, 0x3e, 0x38, 0x3a, 0x33, 0x49, 0x6f, 0x41, 0xca, 0x70, 0x15,
+  0xc5, 0x9e, 0xab, 0xdb, 0x69, 0x5c, 0xd5, 0x68, 0x33, 0xa5, 0x2a, 0x9e, 0xdb, 0xce, 0x11, 0x26,
+  0x6d, 0x5c, 0x4a, 0x66, 0xed, 0xfd, 0x38, 0xf8, 0xd4, 0xab, 0xce, 0xf8, 0x37, 0xe0, 0x3a, 0xa3,
+  0x66, 0x9b, 0x3c, 0x38, 0x3f, 0x95, 0x83, 0xd7, 0x26, 0x54, 0x8b, 0xc3, 0x50, 0x80, 0x87, 0x5f,
+  0x16, 0x63, 0x81, 0xf9, 0x58, 0x60, 0x79, 0x89, 0xe4, 0xaa, 0x78, 0x70, 0x06, 0xbb, 0x1e, 0x1e,
+  0xa2, 0xa9, 0xe0, 0x67, 0xea, 0xe2, 0x90, 0x4f, 0xc2, 0x96, 0x19, 0x3c, 0xdf, 0x6b, 0x0e, 0x97,
+  0x78, 0xb0, 0xb7, 0x74, 0xb4, 0xc0, 0xa4, 0x9f, 0x45, 0x03, 0xba, 0x73, 0xe1, 0x0c, 0x24, 0x8c,
+  0xfa, 0x6f, 0xf9, 0xd1, 0xfc, 0xbc, 0x48, 0x5f, 0xad, 0x56, 0xd1, 0x58, 0xce, 0x05, 0x78, 0x9c,
+  0x77, 0x1e, 0x0e, 0x50, 0x2a, 0x70, 0x65, 0x1d, 0xd2, 0x84, 0xb5, 0x22, 0xb1, 0x0a, 0x47, 0xba,
+  0xd6, 0x0e, 0xa9, 0x76, 0x35, 0xa8, 0xa7, 0x14, 0x26, 0xea, 0x67, 0x26, 0xe2, 0x3f, 0xad, 0xcf,
+  0x99, 0x9f, 0xbf, 0xb6, 0xb1, 0x53, 0x65, 0xdf, 0xec, 0xa1, 0x1d, 0xe2, 0x5e, 0x54, 0x1d, 0xda,
+  0x58, 0xea, 0x7d, 0x83, 0xa0, 0x7f, 0xa4, 0xd3, 0x86, 0x66, 0x54, 0x69, 0x32, 0x1f, 0xa2, 0x1b,
+  0x4a, 0xfe, 0x21, 0xf4, 0xc6, 0xc6, 0x0e, 0x8b, 0x1e, 0x19, 0xa8, 0xb4, 0x09, 0x3d, 0xdd, 0x38,
+  0xa1, 0xd8, 0x83, 0xf8, 0xc0, 0x64, 0x07, 0x36, 0x9a, 0xba, 0x31, 0x9f, 0xfd, 0x60, 0x8d, 0xe6,
+  0xd8, 0x09, 0x1b, 0x6b, 0x21, 0x4b, 0xbc, 0x15, 0x0e, 0xcc, 0x55, 0x51, 0xe0, 0xed, 0x80, 0x4a,
+  0x28, 0xe0, 0xa3, 0x13, 0x7d, 0x52, 0xd2, 0xc5, 0xa5, 0xe9, 0x48, 0x5a, 0x14, 0x97, 0xcc, 0x13,
+  0x74, 0xc1, 0xf6, 0xf7, 0x17, 0x48, 0x75, 0x55, 0x49, 0x4c, 0x85, 0x7d, 0x88, 0xfc, 0xec, 0x8c,
+  0xac, 0xe7, 0x01, 0xe6, 0x7d, 0xef, 0x53, 0x20, 0xd8, 0xd0, 0xcb, 0x16, 0xe9, 0x6a, 0x35, 0x74,
+  0xc9, 0x99, 0xd3, 0x3c, 0x4e, 0x60, 0x0b, 0x05, 0x47, 0x72, 0x77, 0xc0, 0x40, 0x0f, 0xba, 0x33,
+  0x25, 0x84, 0xb4, 0x76, 0xae, 0xcd, 0x92, 0x84, 0xde, 0x48, 0x8d, 0xa8, 0x10, 0x4d, 0x5c, 0x6b,
+  0xeb, 0xfc, 0x63, 0x7d, 0x43, 0xb3, 0x37, 0x69, 0x42, 0x07, 0xcc, 0x60, 0x63, 0x7c, 0x63, 0x06,
+  0xc7, 0x5f, 0x84, 0x45, 0x20, 0x60, 0x42, 0x3a, 0xf0, 0x42, 0x17, 0xff, 0x95, 0x01, 0x51, 0xef,
+  0xb3, 0xf0, 0xe2, 0xe7, 0x87, 0x8f, 0xf7, 0x7e, 0x7c, 0x2c, 0x84, 0x10, 0x73, 0xe6, 0x58, 0x94,
+  0x7b, 0x5a, 0x78, 0xec, 0xc3, 0x2e, 0xf8, 0x48, 0x68, 0x34, 0x16, 0x30, 0x52, 0x81, 0xae, 0xc3,
+  0xb3, 0x32, 0x5d, 0xf6, 0x4d, 0x32, 0x3d, 0x28, 0xc9, 0xf8, 0xc1, 0xf9, 0x17, 0x96, 0xf9, 0xad,
+  0x56, 0x81, 0x06, 0x00, 0x00,
+};
@@ -87,7 +87,7 @@ void check_wifi(){
    int wifi_retry = 0;
    while(WiFi.status() != WL_CONNECTED && wifi_retry < 5 ) {
      wifi_retry++;
-     Serial.println("WiFi not connected. Trying to connect...");
+     LOG_W("WiFi not connected. Trying to connect...");
      WiFi.disconnect();
      WiFi.mode(WIFI_OFF);
      delay(10);
@@ -96,14 +96,13 @@ void check_wifi(){
      delay(WIFI_RECONNECT);
    }
    if(wifi_retry >= 5) {
-     Serial.println("\nWifi connection not possible, rebooting...");
+     LOG_E("Wifi connection not possible, rebooting...");
+     logFlush();
      storeData(); // store Data before reboot
      delay(500);
      ESP.restart();
    } else if (wifi_retry > 0){
-     Serial.println("WiFi reconnected");
-     Serial.println("IP address: ");
-     Serial.println(WiFi.localIP());
+     LOG_I("WiFi reconnected, IP address: %u.%u.%u.%u", WiFi.localIP()[0], WiFi.localIP()[1], WiFi.localIP()[2], WiFi.localIP()[3]);
    }
 }
 
@@ -150,7 +149,7 @@ void sendWiFiInfo() {
     char bufIP[20];
     sprintf(bufIP, "%d.%d.%d.%d", localIP[0], localIP[1], localIP[2], localIP[3]);
 
-    DynamicJsonDocument wifiJSON(1024);
+    StaticJsonDocument<256> wifiJSON;
 
     wifiJSON["status"] = "online";
     wifiJSON["rssi"] = wifiRssi;
@@ -158,9 +157,13 @@ void sendWiFiInfo() {
     wifiJSON["ip"] = bufIP;
     wifiJSON["date-time"] = getDateTimeString();
 
-    String sendWififJSON;
-    serializeJson(wifiJSON, sendWififJSON);
-    mqttPublish(addTopic("/wifi"),String(sendWififJSON).c_str(), false); 
+    s_mqttRtt rtt;
+    mqttGetRtt(&rtt);
+    wifiJSON["rtt_min"] = rtt.min;
+    wifiJSON["rtt_avg"] = rtt.avg;
+    wifiJSON["rtt_p99"] = rtt.p99;
+
+    mqttPublishJson(addTopic("/wifi"), wifiJSON, false);
 
     // wifi status
     mqttPublish(addTopic("/status"), "online", false);
@@ -0,0 +1,138 @@
+//*****************************************************************************
+// 
+// Title      : optional compact binary payload for high-rate consumers
+// Remark     : values of the register mirror are published as MessagePack
+//              map {value id: value} on <topic>/compact, the ids are
+//              described once by the retained JSON message <topic>/compact/schema
+//              if you dont want to use this, you can disable this in config.h
+//*****************************************************************************
+#include <compact.h>
+#include <mqtt.h>
+#include <basics.h>
+
+/* V A R I A B L E S ********************************************************/
+bool     compactDirty[KM271_VAL_CNT];         // value has changed since the last frame
+uint8_t  compactDirtyCnt = 0;                 // number of changed values
+uint32_t compactFirstChange = 0;              // timestamp of the oldest unsent change
+muTimer  compactFullTimer = muTimer();        // timer for cyclic frame with all values
+
+// worst case frame: map16 header + per value (id + float32)
+uint8_t  compactBuf[3 + KM271_VAL_CNT * 6];
+
+/**
+ * *******************************************************************
+ * @brief   Basic Setup for the compact payload
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void setupCompact() {
+  km271SubscribeAll(compactValueChanged, NULL);
+}
+
+/**
+ * *******************************************************************
+ * @brief   mark a value of the register mirror as changed
+ * @details observer of all values of the register mirror
+ * @param   id: value id
+ * @return  none
+ * *******************************************************************/
+void compactValueChanged(e_km271_valueId id, uint8_t raw, float value, void *ctx) {
+  if (compactDirty[id]) return;
+  if (!compactDirtyCnt) compactFirstChange = millis();
+  compactDirty[id] = true;
+  compactDirtyCnt++;
+}
+
+/**
+ * *******************************************************************
+ * @brief   append a decoded value in MessagePack format
+ * @details integral values are encoded as integer (1-2 bytes),
+ *          all others as float32 (5 bytes)
+ * @param   p: write position
+ * @param   value: decoded value
+ * @return  new write position
+ * *******************************************************************/
+uint8_t *compactPackValue(uint8_t *p, float value) {
+  int ival = (int)value;
+  if ((float)ival == value && ival >= -32 && ival <= 127) {
+    *p++ = (uint8_t)(int8_t)ival;                     // positive / negative fixint
+  } else if ((float)ival == value && ival >= 0 && ival <= 255) {
+    *p++ = 0xcc;                                      // uint8
+    *p++ = (uint8_t)ival;
+  } else {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    *p++ = 0xca;                                      // float32, big endian
+    *p++ = bits >> 24;
+    *p++ = bits >> 16;
+    *p++ = bits >> 8;
+    *p++ = bits;
+  }
+  return p;
+}
+
+/**
+ * *******************************************************************
+ * @brief   build and send a compact frame
+ * @param   all: true = all valid values, false = changed values only
+ * @return  none
+ * *******************************************************************/
+void sendCompactFrame(bool all) {
+  uint8_t *p = compactBuf + 3;                        // space for map16 header
+  uint16_t cnt = 0;
+  uint8_t raw;
+
+  for (int i = 0; i < KM271_VAL_CNT; i++) {
+    if ((all || compactDirty[i]) && km271GetValue((e_km271_valueId)i, &raw)) {
+      *p++ = (uint8_t)i;                              // value id as positive fixint (< 128)
+      p = compactPackValue(p, km271DecodeValue((e_km271_valueId)i, raw));
+      cnt++;
+    }
+    compactDirty[i] = false;
+  }
+  compactDirtyCnt = 0;
+  if (!cnt) return;
+
+  compactBuf[0] = 0xde;                               // map16 with cnt entries
+  compactBuf[1] = cnt >> 8;
+  compactBuf[2] = cnt;
+  mqttPublishBinary(addTopic("/compact"), compactBuf, p - compactBuf, false);
+}
+
+/**
+ * *******************************************************************
+ * @brief   send the schema of the value ids as retained JSON message
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void sendCompactSchema() {
+  // names are not copied (const char*), so only the objects are counted
+  DynamicJsonDocument schemaJSON(JSON_OBJECT_SIZE(2) + JSON_ARRAY_SIZE(KM271_VAL_CNT) + KM271_VAL_CNT * JSON_OBJECT_SIZE(4));
+  schemaJSON["version"] = COMPACT_SCHEMA_VERSION;
+  JsonArray values = schemaJSON.createNestedArray("values");
+  for (int i = 0; i < KM271_VAL_CNT; i++) {
+    const s_km271_valueDef *def = km271GetValueDef((e_km271_valueId)i);
+    JsonObject value = values.createNestedObject();
+    value["id"] = i;
+    value["name"] = def->name;
+    value["reg"] = def->reg;
+    value["type"] = km271ValueTypeName(def->type);
+  }
+  mqttPublishJson(addTopic("/compact/schema"), schemaJSON, true);
+}
+
+/**
+ * *******************************************************************
+ * @brief   Cyclic function for the compact payload
+ * @details changes are collected and sent at the latest
+ *          COMPACT_FLUSH_TIME after the first change
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void cyclicCompact() {
+  if (compactFullTimer.cycleTrigger(COMPACT_FULL_TIME)) {
+    sendCompactFrame(true);
+  } else if (compactDirtyCnt && (millis() - compactFirstChange) >= COMPACT_FLUSH_TIME) {
+    sendCompactFrame(false);
+  }
+}
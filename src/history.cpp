@@ -0,0 +1,693 @@
+//*****************************************************************************
+// 
+// Title      : optional value history on flash (LittleFS)
+// Remark     : every value change is appended to a file per day (UTC).
+//              <day>.dat  records: varint time delta [s], value id,
+//                         zigzag varint delta of the raw value
+//              <day>.idx  index: 4 byte start time, 4 byte offset in .dat
+//              (<day> = days since 1970-01-01). The deltas restart at every
+//              segment: on every new file, every hour and after a reboot. A
+//              segment starts with all known values, so it can be decoded
+//              without the data before. An export only opens the files of
+//              the requested days and skips to the first needed segment.
+//              The value observer only appends to a buffer in RAM, it runs
+//              in the KM271 receive path. Writing to flash, deleting old
+//              files and the export are done by cyclicHistory(): the buffer
+//              is written once a minute (or when it is half full) to save
+//              the flash, the export server on port 82 sends one http chunk
+//              per call, so a long export never blocks the main loop.
+//              if you dont want to use this, you can disable this in config.h
+//*****************************************************************************
+#include <history.h>
+#include <mqtt.h>
+#include <basics.h>
+#include <WiFi.h>
+#include <lwip/sockets.h>
+
+static_assert(KM271_VAL_CNT < 256, "value id is stored as one byte");
+
+#define HIST_REC_MAX        8                           // max. length of a record: 5 + 1 + 2 bytes
+
+/* V A R I A B L E S ********************************************************/
+typedef struct {
+  WiFiClient  client;
+  bool        active;                                   // export running
+  bool        sending;                                  // request line received, response is sent
+  bool        done;                                     // last chunk is in the output buffer
+  char        req[HISTORY_REQ_LEN];                     // request line
+  uint8_t     reqLen;
+  char        out[HISTORY_OUT_LEN];                     // pending output
+  uint16_t    outLen;                                   // length of pending output
+  uint16_t    outPos;                                   // already sent part of pending output
+  uint32_t    lastProgress;                             // millis() of the last sent data
+  s_histIter  it;                                       // position in the history
+} s_histExport;
+
+uint8_t       histBuf[HISTORY_BUF_LEN];                 // records not yet written
+uint16_t      histLen = 0;                              // used length of the write buffer
+uint32_t      histBufTime = 0;                          // millis() of the oldest record in the buffer
+s_histIndex   histSegs[HISTORY_MAX_SEGS];               // segments started in the write buffer
+uint8_t       histSegCnt = 0;
+uint32_t      histBufDay = 0;                           // day file of the records before the first segment in the buffer
+uint32_t      histSegDay = 0;                           // day file of the actual segment
+uint32_t      histDay = 0;                              // actual day
+uint32_t      histCleanupDay = 0;                       // day change, old files have to be checked (0 = no)
+uint32_t      histSegStart = 0;                         // start time of the actual segment (0 = start a new one)
+uint32_t      histLastTime = 0;                         // time of the last record
+uint8_t       histLast[KM271_VAL_CNT];                  // last raw value per id in the actual segment
+bool          histReady = false;                        // file system mounted
+uint32_t      histRecords = 0;                          // records written since boot
+uint32_t      histFlushes = 0;                          // write buffer flushes since boot
+uint32_t      histErrors = 0;                           // failed flushes
+uint32_t      histDropped = 0;                          // records dropped because the write buffer was full
+uint32_t      histExports = 0;                          // finished exports
+WiFiServer    histServer(HISTORY_PORT);
+s_histExport  histExp;                                  // only one export at a time
+
+/**
+ * *******************************************************************
+ * @brief   build the file name of a day
+ * @param   buf: destination, at least 24 bytes
+ * @param   day: days since 1970-01-01
+ * @param   ext: "dat" or "idx"
+ * @return  buf
+ * *******************************************************************/
+static char *histFileName(char *buf, uint32_t day, const char *ext) {
+  sprintf(buf, HISTORY_DIR "/%lu.%s", (unsigned long)day, ext);
+  return buf;
+}
+
+/**
+ * *******************************************************************
+ * @brief   hash of the value table
+ * @details the files store value ids. If the table changes (other
+ *          feature switches in config.h), the old files are not readable.
+ * @param   none
+ * @return  FNV-1a hash of all value names
+ * *******************************************************************/
+static uint32_t histSchemaHash() {
+  uint32_t hash = 2166136261u;
+  for (int i = 0; i < KM271_VAL_CNT; i++) {
+    for (const char *p = km271GetValueDef((e_km271_valueId)i)->name; *p; p++) {
+      hash = (hash ^ (uint8_t)*p) * 16777619u;
+    }
+    hash = (hash ^ 0xff) * 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * *******************************************************************
+ * @brief   find the oldest day file
+ * @param   none
+ * @return  day of the oldest file, UINT32_MAX if there is none
+ * *******************************************************************/
+static uint32_t histOldestDay() {
+  uint32_t oldest = UINT32_MAX;
+  File dir = LittleFS.open(HISTORY_DIR);
+  if (!dir) {
+    return oldest;
+  }
+  for (File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+    const char *name = strrchr(f.name(), '/');                      // name() is the full path on older cores
+    name = name ? name + 1 : f.name();
+    if (strstr(name, ".dat")) {
+      uint32_t day = strtoul(name, NULL, 10);
+      if (day < oldest) oldest = day;
+    }
+  }
+  return oldest;
+}
+
+/**
+ * *******************************************************************
+ * @brief   delete day files beyond the retention time or if the flash
+ *          is nearly full
+ * @param   today: actual day
+ * @return  none
+ * *******************************************************************/
+static void histCleanup(uint32_t today) {
+  char name[24];
+  for (;;) {
+    uint32_t oldest = histOldestDay();
+    if (oldest == UINT32_MAX || oldest >= today) {
+      return;                                                       // never delete the actual day
+    }
+    if (oldest + HISTORY_DAYS > today && LittleFS.totalBytes() - LittleFS.usedBytes() >= HISTORY_MIN_FREE) {
+      return;
+    }
+    LittleFS.remove(histFileName(name, oldest, "dat"));
+    LittleFS.remove(histFileName(name, oldest, "idx"));
+    LOG_I("history: day %lu deleted", (unsigned long)oldest);
+  }
+}
+
+/**
+ * *******************************************************************
+ * @brief   append a varint to the write buffer
+ * @param   v: value
+ * @return  none
+ * *******************************************************************/
+static void histPutVarint(uint32_t v) {
+  while (v >= 0x80) {
+    histBuf[histLen++] = (uint8_t)v | 0x80;
+    v >>= 7;
+  }
+  histBuf[histLen++] = (uint8_t)v;
+}
+
+/**
+ * *******************************************************************
+ * @brief   append one record to the write buffer
+ * @param   id: value id
+ * @param   raw: raw value
+ * @param   now: time of the change
+ * @return  false if the buffer is full
+ * *******************************************************************/
+static bool histPutRecord(uint8_t id, uint8_t raw, uint32_t now) {
+  int delta = (int)raw - (int)histLast[id];
+  if (histLen + HIST_REC_MAX > HISTORY_BUF_LEN) {
+    return false;
+  }
+  if (!histLen) {
+    histBufTime = millis();
+  }
+  histPutVarint(now - histLastTime);
+  histBuf[histLen++] = id;
+  histPutVarint(((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));  // zigzag
+  histLast[id] = raw;
+  histLastTime = now;
+  histRecords++;
+  return true;
+}
+
+/**
+ * *******************************************************************
+ * @brief   start a new segment with all known values
+ * @param   now: start time of the segment
+ * @return  false if no more segment can be started in the buffer
+ * *******************************************************************/
+static bool histStartSegment(uint32_t now) {
+  uint8_t raw;
+  if (histSegCnt == HISTORY_MAX_SEGS) {
+    return false;
+  }
+  if (!histLen) {
+    histBufTime = millis();
+  }
+  histSegs[histSegCnt].time = now;
+  histSegs[histSegCnt].offset = histLen;
+  histSegs[histSegCnt].day = histDay;
+  histSegCnt++;
+  histSegDay = histDay;
+  histSegStart = histLastTime = now;
+  memset(histLast, 0, sizeof(histLast));
+  for (int i = 0; i < KM271_VAL_CNT; i++) {
+    if (km271GetValue((e_km271_valueId)i, &raw) && !histPutRecord(i, raw, now)) {
+      histDropped++;
+    }
+  }
+  return true;
+}
+
+/**
+ * *******************************************************************
+ * @brief   store a changed value
+ * @details observer of all values of the register mirror, runs in the
+ *          KM271 receive path: only the RAM buffer is used here
+ * @param   id: value id
+ * @param   raw: raw value
+ * @param   value: decoded value (not used)
+ * @return  none
+ * *******************************************************************/
+void historyValueChanged(e_km271_valueId id, uint8_t raw, float value, void *ctx) {
+  time_t now;
+  time(&now);
+  if (!histReady || now < 1600000000) {
+    return;                                                         // no valid time yet
+  }
+  uint32_t day = now / 86400;
+  if (day != histDay) {
+    histDay = day;
+    histSegStart = 0;                                               // new file starts with a new segment
+    histCleanupDay = day;
+  }
+  if (!histSegStart || (uint32_t)now < histLastTime || (uint32_t)now - histSegStart >= HISTORY_SEG_TIME) {
+    if (!histStartSegment(now)) {                                   // contains the changed value already
+      histDropped++;
+    }
+  } else if (!histPutRecord(id, raw, now)) {
+    histDropped++;
+  }
+}
+
+/**
+ * *******************************************************************
+ * @brief   append a part of the write buffer to a day file
+ * @param   day: day file
+ * @param   data: records
+ * @param   len: length of the records
+ * @param   seg: segment that starts with these records, NULL = continue the last one
+ * @return  false on write error
+ * *******************************************************************/
+static bool histAppend(uint32_t day, const uint8_t *data, uint16_t len, const s_histIndex *seg) {
+  char name[24];
+  File dat = LittleFS.open(histFileName(name, day, "dat"), FILE_APPEND);
+  if (!dat) {
+    return false;
+  }
+  uint32_t base = dat.size();
+  bool ok = !len || dat.write(data, len) == len;
+  dat.close();
+  if (ok && seg) {
+    uint32_t entry[2] = {seg->time, base};
+    File idx = LittleFS.open(histFileName(name, day, "idx"), FILE_APPEND);
+    ok = idx && idx.write((const uint8_t *)entry, sizeof(entry)) == sizeof(entry);
+    if (idx) {
+      idx.close();
+    }
+  }
+  return ok;
+}
+
+/**
+ * *******************************************************************
+ * @brief   write the buffered records and index entries to flash
+ * @details the buffer can contain records of two days, it is split at
+ *          the segments (every day file starts with a new segment)
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void historyFlush() {
+  bool ok = true;
+  if (!histLen && !histSegCnt) {
+    return;
+  }
+  uint16_t start = 0;
+  for (int i = 0; i <= histSegCnt; i++) {
+    uint16_t end = (i < histSegCnt) ? histSegs[i].offset : histLen;
+    if (i == 0) {
+      if (end > start) {
+        ok = histAppend(histBufDay, histBuf, end, NULL) && ok;     // continuation of the last segment
+      }
+    } else {
+      ok = histAppend(histSegs[i-1].day, histBuf + start, end - start, &histSegs[i-1]) && ok;
+    }
+    start = end;
+  }
+  if (ok) {
+    histFlushes++;
+  } else {
+    histErrors++;
+    histSegStart = 0;                                               // next record starts a new, indexed segment
+    LOG_W("history: write to flash failed");
+  }
+  histLen = 0;
+  histSegCnt = 0;
+  histBufDay = histSegDay;
+}
+
+/**
+ * *******************************************************************
+ * @brief   read one varint of a segment
+ * @param   rd: reader
+ * @param   v: read value
+ * @return  false at the end of the segment or on a damaged record
+ * *******************************************************************/
+static bool histGetVarint(s_histReader *rd, uint32_t *v) {
+  *v = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    if (rd->pos == rd->len) {
+      if (!rd->remain) {
+        return false;
+      }
+      rd->len = rd->file->read(rd->buf, min((uint32_t)sizeof(rd->buf), rd->remain));
+      if (!rd->len) {
+        return false;
+      }
+      rd->remain -= rd->len;
+      rd->pos = 0;
+    }
+    uint8_t b = rd->buf[rd->pos++];
+    *v |= (uint32_t)(b & 0x7f) << shift;
+    if (!(b & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * *******************************************************************
+ * @brief   start an export of the records in [from, to]
+ * @param   it: export position
+ * @param   from: first time (unix time)
+ * @param   to: last time (unix time)
+ * @return  none
+ * *******************************************************************/
+void histIterBegin(s_histIter *it, uint32_t from, uint32_t to) {
+  it->from = from;
+  it->to = to;
+  it->lastDay = to / 86400;
+  it->day = max(from / 86400, (it->lastDay > HISTORY_DAYS) ? it->lastDay - HISTORY_DAYS : (uint32_t)0);
+  it->open = false;
+  it->inSeg = false;
+  if (from > to) {
+    it->day = it->lastDay + 1;                                      // nothing to export
+  }
+}
+
+/**
+ * *******************************************************************
+ * @brief   close the files of the actual day and continue with the next
+ * @param   it: export position
+ * @return  none
+ * *******************************************************************/
+static void histIterNextDay(s_histIter *it) {
+  if (it->idx) it->idx.close();
+  if (it->dat) it->dat.close();
+  it->open = false;
+  it->inSeg = false;
+  it->day++;
+}
+
+/**
+ * *******************************************************************
+ * @brief   stop an export and close its files
+ * @param   it: export position
+ * @return  none
+ * *******************************************************************/
+void histIterEnd(s_histIter *it) {
+  histIterNextDay(it);
+  it->day = it->lastDay + 1;
+}
+
+/**
+ * *******************************************************************
+ * @brief   get the next record of an export
+ * @details only the files of the requested days are opened, segments
+ *          that end before from are skipped with the index, the files
+ *          are read in small blocks
+ * @param   it: export position
+ * @param   time: time of the record
+ * @param   id: value id
+ * @param   raw: raw value
+ * @return  false if there are no more records
+ * *******************************************************************/
+bool histIterNext(s_histIter *it, uint32_t *time, uint8_t *id, uint8_t *raw) {
+  char name[24];
+  uint32_t dt, vid, zz;
+  for (;;) {
+    if (it->inSeg) {
+      if (histGetVarint(&it->rd, &dt) && histGetVarint(&it->rd, &vid) && vid < KM271_VAL_CNT && histGetVarint(&it->rd, &zz)) {
+        it->time += dt;
+        it->last[vid] += (uint8_t)((zz >> 1) ^ -(int32_t)(zz & 1));
+        if (it->time > it->to) {
+          histIterEnd(it);
+          return false;
+        }
+        if (it->time >= it->from) {
+          *time = it->time;
+          *id = vid;
+          *raw = it->last[vid];
+          return true;
+        }
+        continue;
+      }
+      it->inSeg = false;                                            // end of the segment
+    }
+    if (!it->open) {
+      if (it->day > it->lastDay) {
+        return false;
+      }
+      it->idx = LittleFS.open(histFileName(name, it->day, "idx"));
+      it->dat = LittleFS.open(histFileName(name, it->day, "dat"));
+      it->open = true;
+      it->hasNext = it->idx && it->dat && it->idx.read((uint8_t *)&it->next, 8) == 8;
+    }
+    if (!it->hasNext) {
+      histIterNextDay(it);
+      continue;
+    }
+    s_histIndex seg = it->next;
+    it->hasNext = it->idx.read((uint8_t *)&it->next, 8) == 8;
+    uint32_t end = it->hasNext ? it->next.offset : it->dat.size();
+    if (seg.time > it->to) {
+      histIterEnd(it);
+      return false;
+    }
+    if ((it->hasNext && it->next.time < it->from) || end <= seg.offset || !it->dat.seek(seg.offset)) {
+      continue;                                                     // segment ends before from
+    }
+    it->rd.file = &it->dat;
+    it->rd.len = it->rd.pos = 0;
+    it->rd.remain = end - seg.offset;
+    it->time = seg.time;
+    memset(it->last, 0, sizeof(it->last));
+    it->inSeg = true;
+  }
+}
+
+/**
+ * *******************************************************************
+ * @brief   get a numeric argument of the request line
+ * @param   req: request line, e.g. "GET /history?from=1&to=2 HTTP/1.1"
+ * @param   name: argument name
+ * @param   def: default value if the argument is missing or empty
+ * @return  value
+ * *******************************************************************/
+static uint32_t histArg(const char *req, const char *name, uint32_t def) {
+  size_t len = strlen(name);
+  for (const char *p = strchr(req, '?'); p; p = strchr(p + 1, '&')) {
+    if (strncmp(p + 1, name, len) == 0 && p[len + 1] == '=' && isdigit((uint8_t)p[len + 2])) {
+      return strtoul(p + len + 2, NULL, 10);
+    }
+  }
+  return def;
+}
+
+/**
+ * *******************************************************************
+ * @brief   fill the output buffer with the next http chunk of the export
+ * @param   ex: export
+ * @return  none
+ * *******************************************************************/
+static void histExportChunk(s_histExport *ex) {
+  uint32_t time;
+  uint8_t id, raw;
+  uint16_t len = 6;                                                 // room for the chunk header "xxxx\r\n"
+  while (len + 64 + 7 <= HISTORY_OUT_LEN) {                         // one line + "\r\n" + last chunk
+    if (!histIterNext(&ex->it, &time, &id, &raw)) {
+      ex->done = true;
+      break;
+    }
+    int n = snprintf(ex->out + len, 64, "%lu,%s,%g\n", (unsigned long)time, km271GetValueDef((e_km271_valueId)id)->name,
+                     km271DecodeValue((e_km271_valueId)id, raw));
+    len += min(n, 63);
+  }
+  ex->outPos = 0;
+  if (len > 6) {
+    char head[7];
+    snprintf(head, sizeof(head), "%04x\r\n", len - 6);
+    memcpy(ex->out, head, 6);
+    memcpy(ex->out + len, "\r\n", 2);
+    len += 2;
+  } else {
+    len = 0;
+  }
+  if (ex->done) {
+    memcpy(ex->out + len, "0\r\n\r\n", 5);                          // last chunk
+    len += 5;
+  }
+  ex->outLen = len;
+}
+
+/**
+ * *******************************************************************
+ * @brief   close the export client
+ * @param   ex: export
+ * @return  none
+ * *******************************************************************/
+static void histExportClose(s_histExport *ex) {
+  histIterEnd(&ex->it);
+  ex->client.stop();
+  ex->active = false;
+}
+
+/**
+ * *******************************************************************
+ * @brief   serve the export client without blocking
+ * @details request: GET /history?from=T&to=T (unix times, default: the
+ *          last 24 hours), answer: chunked CSV "time,name,value". At most
+ *          one chunk is prepared per call.
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+static void histServeExport() {
+  s_histExport *ex = &histExp;
+  if (histServer.hasClient()) {
+    WiFiClient client = histServer.available();
+    if (ex->active || !histReady) {
+      client.print("HTTP/1.1 503 Service Unavailable\r\nConnection: close\r\nContent-Length: 0\r\n\r\n");
+      client.stop();                                                // only one export at a time
+    } else {
+      ex->client = client;
+      ex->active = true;
+      ex->sending = false;
+      ex->done = false;
+      ex->reqLen = 0;
+      ex->outLen = ex->outPos = 0;
+      ex->lastProgress = millis();
+    }
+  }
+  if (!ex->active) {
+    return;
+  }
+  if (!ex->client.connected() || millis() - ex->lastProgress > HISTORY_TIMEOUT) {
+    histExportClose(ex);
+    return;
+  }
+
+  // wait for the request line
+  if (!ex->sending) {
+    while (ex->client.available()) {
+      char c = ex->client.read();
+      if (c == '\n') {
+        ex->req[ex->reqLen] = 0;
+        ex->sending = true;
+        break;
+      }
+      if (ex->reqLen < HISTORY_REQ_LEN - 1) {
+        ex->req[ex->reqLen++] = c;
+      }
+    }
+    if (!ex->sending) {
+      return;
+    }
+    time_t now;
+    time(&now);
+    if (strncmp(ex->req, "GET /history", 12) != 0) {
+      ex->outLen = snprintf(ex->out, HISTORY_OUT_LEN, "HTTP/1.1 404 Not Found\r\nConnection: close\r\nContent-Length: 0\r\n\r\n");
+      ex->done = true;
+    } else {
+      uint32_t to = histArg(ex->req, "to", now);
+      uint32_t from = histArg(ex->req, "from", to - 86400);
+      historyFlush();                                               // include the records of the last minute
+      histIterBegin(&ex->it, from, to);
+      ex->outLen = snprintf(ex->out, HISTORY_OUT_LEN, "HTTP/1.1 200 OK\r\nContent-Type: text/csv\r\nCache-Control: no-store\r\n"
+        "Transfer-Encoding: chunked\r\nConnection: close\r\n\r\n0010\r\ntime,name,value\n\r\n");
+    }
+    ex->outPos = 0;
+  }
+
+  // send pending output, the next chunk only if the socket has taken all
+  while (ex->client.available()) {
+    ex->client.read();                                              // ignore the request headers
+  }
+  if (ex->outPos == ex->outLen) {
+    if (ex->done) {
+      histExportClose(ex);
+      histExports++;
+      return;
+    }
+    histExportChunk(ex);
+  }
+  int res = send(ex->client.fd(), ex->out + ex->outPos, ex->outLen - ex->outPos, MSG_DONTWAIT);
+  if (res < 0) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      histExportClose(ex);                                          // connection lost
+    }
+    return;                                                         // socket full, try again later
+  }
+  if (res > 0) {
+    ex->outPos += res;
+    ex->lastProgress = millis();
+  }
+}
+
+/**
+ * *******************************************************************
+ * @brief   Basic Setup for the history
+ * @details mounts LittleFS (formats it, if it is not yet formatted) and
+ *          deletes the history if it was written with another value table
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void setupHistory() {
+  if (!LittleFS.begin(true)) {
+    LOG_E("history: LittleFS mount failed");
+    return;
+  }
+  LittleFS.mkdir(HISTORY_DIR);
+  uint32_t hash = histSchemaHash(), stored = 0;
+  File f = LittleFS.open(HISTORY_DIR "/schema");
+  if (f) {
+    f.read((uint8_t *)&stored, sizeof(stored));
+    f.close();
+  }
+  if (stored != hash) {
+    char name[24];
+    for (uint32_t day = histOldestDay(); day != UINT32_MAX; day = histOldestDay()) {
+      LittleFS.remove(histFileName(name, day, "dat"));
+      LittleFS.remove(histFileName(name, day, "idx"));
+    }
+    f = LittleFS.open(HISTORY_DIR "/schema", FILE_WRITE);
+    if (f) {
+      f.write((const uint8_t *)&hash, sizeof(hash));
+      f.close();
+    }
+    LOG_I("history: new value table, history cleared");
+  }
+  histReady = true;
+  histServer.begin();
+  histServer.setNoDelay(true);
+  km271SubscribeAll(historyValueChanged, NULL);
+}
+
+/**
+ * *******************************************************************
+ * @brief   Cyclic function for the history
+ * @details writes the buffer to flash once it is HISTORY_FLUSH_TIME old
+ *          or half full, deletes old files after a day change and serves
+ *          the export client
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void cyclicHistory() {
+  if (!histReady) {
+    return;
+  }
+  if ((histLen || histSegCnt) && (millis() - histBufTime >= HISTORY_FLUSH_TIME || histLen >= HISTORY_FLUSH_FILL
+                                  || histSegCnt >= HISTORY_MAX_SEGS - 1)) {
+    historyFlush();
+  }
+  if (histCleanupDay) {
+    histCleanup(histCleanupDay);
+    histCleanupDay = 0;
+  }
+  histServeExport();
+}
+
+/**
+ * *******************************************************************
+ * @brief   send information about the history via mqtt
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void sendHistoryInfo() {
+  StaticJsonDocument<256> histJSON;
+  if (!histReady) {
+    return;
+  }
+  uint32_t oldest = histOldestDay();
+  histJSON["used_bytes"] = LittleFS.usedBytes();
+  histJSON["total_bytes"] = LittleFS.totalBytes();
+  histJSON["oldest"] = (oldest == UINT32_MAX) ? 0 : oldest * 86400;
+  histJSON["records"] = histRecords;
+  histJSON["dropped"] = histDropped;
+  histJSON["flushes"] = histFlushes;
+  histJSON["errors"] = histErrors;
+  histJSON["buffered"] = histLen;
+  histJSON["exports"] = histExports;
+  mqttPublishJson(addTopic("/info/history"), histJSON, false);
+}
@@ -0,0 +1,272 @@
+//*****************************************************************************
+// 
+// Title      : optional embedded http server
+// Remark     : /              : dashboard (pre-gzipped from flash)
+//              /api/snapshot  : all values as JSON
+//              /api/changes   : values changed since generation ?epoch=E&since=N
+//              /metrics       : all values, oilcounter and protocol health counters
+//                               in Prometheus text format
+//              /api/history   : redirect to the history export on port 82 (if USE_HISTORY)
+//              if you dont want to use this, you can disable this in config.h
+//*****************************************************************************
+#include <httpserver.h>
+#include <km271.h>
+#include <mqtt.h>
+#include <basics.h>
+#include <webui_data.h>
+#include <WebServer.h>
+#include <WiFi.h>
+
+#ifdef USE_OILMETER
+  #include <oilmeter.h>
+#endif
+
+#ifdef USE_HISTORY
+  #include <history.h>
+#endif
+
+/* V A R I A B L E S ********************************************************/
+WebServer httpServer(HTTP_PORT);
+
+/**
+ * *******************************************************************
+ * @brief   small Print adapter for chunked http responses
+ * @details the response is collected in a fixed buffer and sent as
+ *          http chunk whenever it is full, so the memory needed does
+ *          not depend on the size of the response
+ * *******************************************************************/
+class HttpChunkPrint : public Print {
+  public:
+    size_t write(uint8_t c) override {
+      buf[len++] = c;
+      if (len == sizeof(buf)) flush();
+      return 1;
+    }
+    void flush() override {
+      if (len) httpServer.sendContent(buf, len);
+      len = 0;
+    }
+  private:
+    char    buf[HTTP_CHUNK_LEN];
+    size_t  len = 0;
+};
+
+/**
+ * *******************************************************************
+ * @brief   start a chunked http response
+ * @param   contentType: content type of the response
+ * @return  none
+ * *******************************************************************/
+void httpBeginChunked(const char *contentType) {
+  httpServer.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  httpServer.send(200, contentType, "");
+}
+
+/**
+ * *******************************************************************
+ * @brief   finish a chunked http response
+ * @param   out: chunk writer of the response
+ * @return  none
+ * *******************************************************************/
+void httpEndChunked(HttpChunkPrint &out) {
+  out.flush();
+  httpServer.sendContent("");                                         // last chunk
+}
+
+/**
+ * *******************************************************************
+ * @brief   handler for /metrics in Prometheus text format
+ * @details streams directly from the register mirror
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void handleMetrics() {
+  HttpChunkPrint out;
+  s_km271_protStats protStats;
+  s_mqttStats mqttStats;
+  uint8_t raw;
+
+  httpBeginChunked("text/plain; version=0.0.4");
+
+  // values of the register mirror
+  out.print("# HELP km271_value Decoded value of the KM271 register mirror\n# TYPE km271_value gauge\n");
+  for (int i = 0; i < KM271_VAL_CNT; i++) {
+    if (km271GetValue((e_km271_valueId)i, &raw)) {
+      const s_km271_valueDef *def = km271GetValueDef((e_km271_valueId)i);
+      out.printf("km271_value{name=\"%s\",reg=\"0x%04x\"} %g\n", def->name, def->reg, km271DecodeValue((e_km271_valueId)i, raw));
+    }
+  }
+
+  // oilmeter
+  #ifdef USE_OILMETER
+    out.print("# HELP km271_oilcounter Oil meter counter (1 = 0.01 litre)\n# TYPE km271_oilcounter counter\n");
+    out.printf("km271_oilcounter %ld\n", getOilmeter());
+  #endif
+
+  // protocol health
+  km271GetProtStats(&protStats);
+  out.printf("# TYPE km271_logmode gauge\nkm271_logmode %d\n", km271GetLogMode());
+  out.printf("# TYPE km271_rx_blocks_total counter\nkm271_rx_blocks_total %lu\n", (unsigned long)protStats.rxBlocks);
+  out.printf("# TYPE km271_bcc_errors_total counter\nkm271_bcc_errors_total %lu\n", (unsigned long)protStats.bccErrors);
+  out.printf("# TYPE km271_resyncs_total counter\nkm271_resyncs_total %lu\n", (unsigned long)protStats.resyncs);
+  out.printf("# TYPE km271_logmode_starts_total counter\nkm271_logmode_starts_total %lu\n", (unsigned long)protStats.logModeStarts);
+  out.printf("# TYPE km271_tx_telegrams_total counter\nkm271_tx_telegrams_total %lu\n", (unsigned long)protStats.txTelegrams);
+  out.printf("# TYPE km271_tx_retries_total counter\nkm271_tx_retries_total %lu\n", (unsigned long)protStats.txRetries);
+  out.printf("# TYPE km271_tx_failed_total counter\nkm271_tx_failed_total %lu\n", (unsigned long)protStats.txFailed);
+
+  // mqtt
+  out.print("# TYPE mqtt_publish_total counter\n");
+  for (int i = 0; i < MQTT_CLASS_CNT; i++) {
+    const char *name = mqttGetStats((e_mqttTopicClass)i, &mqttStats);
+    out.printf("mqtt_publish_total{class=\"%s\",result=\"sent\"} %lu\n", name, (unsigned long)mqttStats.sent);
+    out.printf("mqtt_publish_total{class=\"%s\",result=\"failed\"} %lu\n", name, (unsigned long)mqttStats.failed);
+    out.printf("mqtt_publish_total{class=\"%s\",result=\"dropped\"} %lu\n", name, (unsigned long)mqttStats.dropped);
+  }
+  out.print("# TYPE mqtt_publish_bytes_total counter\n");
+  for (int i = 0; i < MQTT_CLASS_CNT; i++) {
+    const char *name = mqttGetStats((e_mqttTopicClass)i, &mqttStats);
+    out.printf("mqtt_publish_bytes_total{class=\"%s\"} %lu\n", name, (unsigned long)mqttStats.bytes);
+  }
+  out.printf("# TYPE mqtt_queue_free gauge\nmqtt_queue_free %u\n", mqttQueueFree());
+
+  httpEndChunked(out);
+}
+
+/**
+ * *******************************************************************
+ * @brief   handler for the dashboard
+ * @details the dashboard is stored pre-gzipped in flash. Browsers have
+ *          to revalidate it with the ETag and get a 304 if unchanged.
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void handleDashboard() {
+  httpServer.sendHeader("ETag", DASHBOARD_ETAG);
+  httpServer.sendHeader("Cache-Control", "no-cache");
+  if (httpServer.header("If-None-Match") == DASHBOARD_ETAG) {
+    httpServer.send(304);
+    return;
+  }
+  httpServer.sendHeader("Content-Encoding", "gzip");
+  httpServer.send_P(200, "text/html", (const char *)dashboard_html_gz, sizeof(dashboard_html_gz));
+}
+
+/**
+ * *******************************************************************
+ * @brief   handler for /api/snapshot
+ * @details all values of the register mirror as JSON, streamed directly
+ *          from the mirror - independent of the mqtt connection
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void handleSnapshot() {
+  HttpChunkPrint out;
+  uint8_t raw;
+  bool first = true;
+
+  httpServer.sendHeader("Cache-Control", "no-store");
+  httpBeginChunked("application/json");
+  out.printf("{\"logmode\":%s,\"time\":\"%s\",\"values\":{", km271GetLogMode() ? "true" : "false", getDateTimeString());
+  for (int i = 0; i < KM271_VAL_CNT; i++) {
+    if (km271GetValue((e_km271_valueId)i, &raw)) {
+      out.printf("%s\"%s\":%g", first ? "" : ",", km271GetValueDef((e_km271_valueId)i)->name, km271DecodeValue((e_km271_valueId)i, raw));
+      first = false;
+    }
+  }
+  out.print("}");
+  #ifdef USE_OILMETER
+    out.printf(",\"oilcounter\":%ld", getOilmeter());
+  #endif
+  out.print("}");
+  httpEndChunked(out);
+}
+
+// context for printChange()
+typedef struct {
+  HttpChunkPrint  *out;
+  bool            first;
+} s_changeCtx;
+
+/**
+ * *******************************************************************
+ * @brief   callback for handleChanges()
+ * *******************************************************************/
+void printChange(e_km271_valueId id, uint8_t raw, uint32_t gen, void *ctx) {
+  s_changeCtx *cc = (s_changeCtx *)ctx;
+  cc->out->printf("%s{\"id\":%d,\"name\":\"%s\",\"gen\":%lu,\"value\":%g}", cc->first ? "" : ",",
+    id, km271GetValueDef(id)->name, (unsigned long)gen, km271DecodeValue(id, raw));
+  cc->first = false;
+}
+
+/**
+ * *******************************************************************
+ * @brief   handler for /api/changes?epoch=E&since=N
+ * @details only the values changed since generation N are sent, the
+ *          actual "epoch" and generation "gen" have to be used as E and N
+ *          for the next request. If the epoch has changed (reboot), all
+ *          values are sent.
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void handleChanges() {
+  HttpChunkPrint out;
+  s_changeCtx cc = {&out, true};
+  uint32_t epoch = strtoul(httpServer.arg("epoch").c_str(), NULL, 10);
+  uint32_t since = strtoul(httpServer.arg("since").c_str(), NULL, 10);
+
+  httpServer.sendHeader("Cache-Control", "no-store");
+  httpBeginChunked("application/json");
+  out.print("{\"values\":[");
+  uint32_t gen = km271GetChangesSince(epoch, since, printChange, &cc);
+  out.printf("],\"epoch\":%lu,\"gen\":%lu}", (unsigned long)km271GetEpoch(), (unsigned long)gen);
+  httpEndChunked(out);
+}
+
+#ifdef USE_HISTORY
+/**
+ * *******************************************************************
+ * @brief   handler for /api/history?from=T&to=T
+ * @details the export is served by the history module on its own port,
+ *          one chunk per loop pass - this handler only redirects there
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void handleHistory() {
+  String url = "http://" + WiFi.localIP().toString() + ":" + String(HISTORY_PORT) + "/history";
+  if (httpServer.hasArg("from") || httpServer.hasArg("to")) {
+    url += "?from=" + httpServer.arg("from") + "&to=" + httpServer.arg("to");
+  }
+  httpServer.sendHeader("Location", url);
+  httpServer.sendHeader("Cache-Control", "no-store");
+  httpServer.send(302, "text/plain", "");
+}
+#endif
+
+/**
+ * *******************************************************************
+ * @brief   Basic Setup for the http server
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void setupHttpServer() {
+  const char *headers[] = {"If-None-Match"};
+  httpServer.collectHeaders(headers, 1);
+  httpServer.on("/", HTTP_GET, handleDashboard);
+  httpServer.on("/api/snapshot", HTTP_GET, handleSnapshot);
+  httpServer.on("/api/changes", HTTP_GET, handleChanges);
+  httpServer.on("/metrics", HTTP_GET, handleMetrics);
+  #ifdef USE_HISTORY
+    httpServer.on("/api/history", HTTP_GET, handleHistory);
+  #endif
+  httpServer.begin();
+}
+
+/**
+ * *******************************************************************
+ * @brief   Cyclic function for the http server
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void cyclicHttpServer() {
+  httpServer.handleClient();
+}
@@ -0,0 +1,182 @@
+//*****************************************************************************
+// 
+// Title      : optional InfluxDB sink (line protocol)
+// Remark     : value changes of the register mirror are collected in a
+//              preallocated buffer and written in batches directly to
+//              InfluxDB via UDP or HTTP, without the detour over mqtt.
+//              if you dont want to use this, you can disable this in config.h
+//*****************************************************************************
+#include <influx.h>
+#include <mqtt.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <HTTPClient.h>
+
+/* V A R I A B L E S ********************************************************/
+char      influxBuf[2][INFLUX_BUF_LEN];         // actual batch and full batch waiting to be sent
+uint8_t   influxActive = 0;                     // index of the actual batch
+uint16_t  influxLen = 0;                        // used length of the actual batch
+uint16_t  influxFullLen = 0;                    // length of the full batch (0 = none)
+uint32_t  influxDropped = 0;                    // lines dropped because both buffers were full
+uint32_t  influxFirstLine = 0;                  // timestamp of the oldest line in the batch
+uint32_t  influxBatches = 0;                    // number of sent batches
+uint32_t  influxErrors = 0;                     // number of batches that could not be sent
+uint32_t  influxSkipped = 0;                    // batches discarded without sending after errors
+uint32_t  influxBackoff = 0;                    // actual time without sending after errors, 0 = none
+uint32_t  influxLastError = 0;                  // millis() of the last error
+
+#ifdef INFLUX_UDP
+  WiFiUDP influxUdp;
+#endif
+
+/**
+ * *******************************************************************
+ * @brief   Basic Setup for the InfluxDB sink
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void setupInflux() {
+  influxLen = 0;
+  km271SubscribeAll(influxValueChanged, NULL);
+}
+
+/**
+ * *******************************************************************
+ * @brief   add a line for a changed value of the register mirror
+ * @details observer of all values of the register mirror
+ * @param   id: value id
+ * @param   value: decoded value
+ * @return  none
+ * *******************************************************************/
+void influxValueChanged(e_km271_valueId id, uint8_t raw, float value, void *ctx) {
+  influxAddLine(km271GetValueDef(id)->name, value);
+}
+
+/**
+ * *******************************************************************
+ * @brief   add a line to the actual batch
+ * @details if the new line does not fit anymore, the batch is handed
+ *          over to cyclicInflux() and a new one is started.
+ *          If the time is already synchronized by NTP, the line gets a
+ *          timestamp - otherwise InfluxDB uses the time of reception.
+ * @param   field: field name
+ * @param   value: field value
+ * @return  none
+ * *******************************************************************/
+void influxAddLine(const char *field, double value) {
+  char line[INFLUX_LINE_LEN];
+  time_t now;
+  int len;
+
+  time(&now);
+  if (now > 1600000000) {                                           // time is valid
+    len = snprintf(line, sizeof(line), INFLUX_MEASUREMENT ",host=" HOSTNAME " %s=%.2f %lu000000000\n", field, value, (unsigned long)now);
+  } else {
+    len = snprintf(line, sizeof(line), INFLUX_MEASUREMENT ",host=" HOSTNAME " %s=%.2f\n", field, value);
+  }
+  if (len <= 0 || len >= (int)sizeof(line)) {
+    return;                                                         // line too long
+  }
+  if (influxLen + len > INFLUX_BUF_LEN) {
+    if (influxFullLen) {
+      influxDropped++;                                              // previous batch not yet sent
+      return;
+    }
+    influxSwap();                                                   // sent by cyclicInflux()
+  }
+  if (!influxLen) {
+    influxFirstLine = millis();
+  }
+  memcpy(influxBuf[influxActive] + influxLen, line, len);
+  influxLen += len;
+}
+
+/**
+ * *******************************************************************
+ * @brief   hand the actual batch over to be sent and start a new one
+ * @details called in the KM271 receive path, so only buffers are
+ *          switched here - the network is used by cyclicInflux() only
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void influxSwap() {
+  influxFullLen = influxLen;
+  influxActive ^= 1;
+  influxLen = 0;
+}
+
+/**
+ * *******************************************************************
+ * @brief   send the full batch to InfluxDB
+ * @details blocking (HTTP up to 2 * INFLUX_HTTP_TIMEOUT), only called from
+ *          cyclicInflux(). After an error the batches are discarded without
+ *          sending for INFLUX_BACKOFF_MIN, doubled with every further error,
+ *          so an unreachable server does not stall the main loop every time.
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void influxFlush() {
+  const char *buf = influxBuf[influxActive ^ 1];
+  bool res = false;
+
+  if (!influxFullLen) return;
+  if (influxBackoff && (millis() - influxLastError) < influxBackoff) {
+    influxSkipped++;
+    influxFullLen = 0;
+    return;
+  }
+  if (WiFi.status() == WL_CONNECTED) {
+  #ifdef INFLUX_UDP
+    res = influxUdp.beginPacket(INFLUX_SERVER, INFLUX_PORT) &&
+          influxUdp.write((const uint8_t *)buf, influxFullLen) == influxFullLen &&
+          influxUdp.endPacket();
+  #else
+    HTTPClient http;
+    http.setConnectTimeout(INFLUX_HTTP_TIMEOUT);
+    http.setTimeout(INFLUX_HTTP_TIMEOUT);
+    http.begin(INFLUX_SERVER, INFLUX_PORT, "/write?db=" INFLUX_DB);
+    res = http.POST((uint8_t *)buf, influxFullLen) == 204;
+    http.end();
+  #endif
+  }
+  if (res) {
+    influxBatches++;
+    influxBackoff = 0;
+  } else {
+    influxErrors++;
+    influxLastError = millis();
+    influxBackoff = influxBackoff ? min(influxBackoff * 2, (uint32_t)INFLUX_BACKOFF_MAX) : INFLUX_BACKOFF_MIN;
+  }
+  influxFullLen = 0;                                                // a failed batch is discarded
+}
+
+/**
+ * *******************************************************************
+ * @brief   Cyclic function for the InfluxDB sink
+ * @details a full batch is sent at once, the actual batch at the latest
+ *          INFLUX_FLUSH_TIME after the first line was added
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void cyclicInflux() {
+  if (!influxFullLen && influxLen && (millis() - influxFirstLine) >= INFLUX_FLUSH_TIME) {
+    influxSwap();
+  }
+  influxFlush();
+}
+
+/**
+ * *******************************************************************
+ * @brief   send the statistics of the InfluxDB sink via mqtt
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void sendInfluxInfo() {
+  StaticJsonDocument<192> influxJSON;
+  influxJSON["batches"] = influxBatches;
+  influxJSON["errors"] = influxErrors;
+  influxJSON["skipped"] = influxSkipped;
+  influxJSON["dropped"] = influxDropped;
+  influxJSON["backoff"] = influxBackoff / 1000;
+  mqttPublishJson(addTopic("/info/influx"), influxJSON, false);
+}
@@ -10,6 +10,10 @@
 #include <km271.h>
 #include <basics.h>
 
+#ifdef USE_RAWBRIDGE
+  #include <rawbridge.h>
+#endif
+
 /* V A R I A B L E S ********************************************************/
 SemaphoreHandle_t    accessMutex;                                  // To protect access to kmState structure
 
@@ -30,17 +34,35 @@ uint8_t KmCLogMode[] = {0xEE, 0x00, 0x00};                         // Switch to
 
 // ************************ km271 handling variables ****************************
 uint8_t     rxByte;                                // The received character. We are reading byte by byte only.
-e_rxState   kmRxStatus = KM_RX_RESYNC;             // Status in Rx reception
-uint8_t     kmRxBcc  = 0;                          // BCC value for Rx Block
-KmRx_s      kmRxBuf;                               // Rx block storag
+s_km271_rx  kmRx = {KM_RX_RESYNC, 0, {0}};         // Rx reception state and block storage
 bool        send_request;
 uint8_t     send_cmd;
 uint8_t     send_buf[8] = {};
 bool        km271LogModeActive = false;
+s_km271_protStats kmProtStats;                     // protocol health counters
+
+// ************************ telegram queue ****************************
+uint8_t     txQueue[KM271_TX_QUEUE_LEN][8];                        // write telegrams waiting to be sent
+uint8_t     txQueueRd = 0;                                         // next telegram to send
+uint8_t     txQueueCnt = 0;                                        // number of queued telegrams
+bool        txAwaitAck = false;                                    // telegram sent, next DLE is the acknowledge
+bool        txResend = false;                                      // telegram in send_buf was refused, send it again after the next DLE
+uint8_t     txRetries = 0;                                         // NAKs of the telegram in send_buf
+
+// ************************ command latency measurement ****************************
+uint32_t    cmdStageTime[KM271_CMD_STAGE_CNT];                     // timestamps of the current command
+uint32_t    cmdRxTime = 0;                                         // receipt time of the actual mqtt callback
+bool        cmdRxActive = false;                                   // mqtt callback is running
+int8_t      cmdStage = -1;                                         // last reached stage of the current command, -1 = none
+uint16_t    cmdConfirmReg = 0xFFFF;                                // register that confirms the current command
+uint32_t    cmdLatHist[KM271_CMD_STAGE_CNT][KM271_LAT_BUCKETS];    // histogram per stage, [0] = total receipt->confirm
+uint32_t    cmdLatAbandoned = 0;                                   // commands without confirmation
+const char *cmdStageNames[KM271_CMD_STAGE_CNT] = {"total", "queued", "granted", "sent", "acked", "confirmed"};
 
 // ==================================================================================================
 // Message arrays for config messages
 // ==================================================================================================
+#ifdef USE_CONFIG_VALUES
 String cfgOperatingMode[]={"night", "day", "auto"};
 String cfgDisplay[]={"auto", "boiler", "DHW", "outdoor"};
 String cfgLanguage[]={"DE", "FR", "IT", "NL", "EN", "PL"};
@@ -54,6 +76,137 @@ String cfgCirculationInterval[]={"off","1","2","3","4","5","6","on"};
 String cfgBurnerType[]={"1-stage","2-stage","modulated"};
 String cfgExhaustGasThreshold[]={"off","50","55","60","65","70","75","80","85","90","95","100","105","110","115","120","125","130","135","140","145","150","155","160","165","170","175","180","185","190","195","200","205","210","215","220","225","230","235","240","245","250"};
 String cfgHk1Program[]={"custom","family","early","late","AM","PM","noon","single","senior"};
+#endif
+//********************************************************************************************
+
+// Register groups - order has to match e_km271_group
+typedef struct {
+  uint8_t     hiByte;                                              // register high byte of the group
+  const char *name;                                                // group name
+  bool        generic;                                             // values are published from the value table (no own parser)
+} s_km271_groupDef;
+
+const s_km271_groupDef kmGroupDefs[KM271_GRP_CNT] = {
+  {0x80, "HC1",     false},
+  {0x81, "HC2",     false},
+  {0x82, "HC3",     true},
+  {0x83, "HC4",     true},
+  {0x84, "DHW",     false},
+  {0x88, "boiler",  false},
+  {0x89, "general", false},
+  {0xaa, "alarm",   false},
+};
+
+uint8_t       kmGroupOfHi[256];                                    // group index + 1 per register high byte, 0 = unknown
+uint8_t       kmGroupFirst[KM271_GRP_CNT];                         // first value id of the group
+uint8_t       kmGroupCnt[KM271_GRP_CNT];                           // number of values of the group
+uint16_t      kmGroupsPresent = 0;                                 // bitmask of groups the controller has sent
+uint32_t      kmUnknownHi[8];                                      // bitmap of received register high bytes without group
+bool          kmModulesChanged = false;                            // module info has to be published
+
+// ==================================================================================================
+// Statistics of received registers that are not decoded and sampled trace of one register
+// ==================================================================================================
+typedef struct {
+  uint16_t  reg;                                                   // register address
+  uint8_t   len;                                                   // length of the last payload
+  uint8_t   last[6];                                               // last payload
+  uint32_t  firstSeen;                                             // millis() of the first block
+  uint32_t  count;                                                 // received blocks
+  uint32_t  changes;                                               // blocks with changed payload
+} s_km271_unknown;
+
+s_km271_unknown kmUnknown[KM271_UNKNOWN_MAX];
+uint8_t       kmUnknownCnt = 0;                                    // used table entries
+uint32_t      kmUnknownOverflow = 0;                               // blocks of registers that did not fit into the table
+uint32_t      kmLogModeSince = 0;                                  // millis() of the first log mode start, 0 = not yet in log mode
+uint16_t      kmTraceReg = 0xFFFF;                                 // traced register, 0xFFFF = off
+uint32_t      kmTraceInterval = 0;                                 // min. time between two trace messages
+uint32_t      kmTraceLast = 0;                                     // millis() of the last trace message
+
+// Config blocks that can be written (7 byte register steps), registers as reported in log mode
+typedef struct {
+  uint8_t     type;                                                // write telegram type
+  uint16_t    first;                                               // first register of the range
+  uint16_t    last;                                                // last register of the range
+} s_km271_writeRange;
+
+constexpr s_km271_writeRange kmWriteRanges[] = {
+  {0x07, 0x0000, 0x0031},                                          // HC1 config
+  {0x08, 0x0038, 0x0069},                                          // HC2 config
+  {0x0C, 0x0077, 0x0085},                                          // DHW config
+  {0x11, 0x0100, 0x0162},                                          // HC1 program and switch points
+  {0x12, 0x0169, 0x01d9},                                          // HC2 program and switch points
+};
+#define KM271_WRITE_RANGES  (sizeof(kmWriteRanges) / sizeof(kmWriteRanges[0]))
+
+// number of writable config blocks, starting at range r
+constexpr size_t km271WriteBlocks(size_t r = 0) {
+  return (r < KM271_WRITE_RANGES) ? (kmWriteRanges[r].last - kmWriteRanges[r].first) / 7 + 1 + km271WriteBlocks(r + 1) : 0;
+}
+static_assert(km271WriteBlocks() <= KM271_TX_QUEUE_LEN, "a full config restore has to fit into the send queue");
+
+#ifdef USE_CONFIG_VALUES
+// ==================================================================================================
+// Raw cache of the config blocks (7 byte register steps), used for switching programs and backup / restore.
+// Blocks 0x0000-0x00fc and 0x0100-0x01d9 (the program blocks start at 0x0100).
+// ==================================================================================================
+#define KM271_CFG_BLOCKS    69                                     // 37 blocks below 0x0100, 32 blocks from 0x0100
+#define KM271_CFG_VERSION   1                                      // version of the backup format
+
+uint8_t       kmCfgRaw[KM271_CFG_BLOCKS][6];                       // data bytes of the config blocks
+uint8_t       kmCfgValid[(KM271_CFG_BLOCKS + 7) / 8];              // bitmap of received blocks
+uint8_t       kmCfgUnpublished[(KM271_CFG_BLOCKS + 7) / 8];        // bitmap of blocks shed under mqtt backpressure
+
+// ==================================================================================================
+// Switching programs (contour registers) of the heating circuits, stored in the config cache.
+// Each block holds 3 switch points of 2 bytes: day (high nibble, 7 = unused) + on/off (bit 0), time in 10 min steps
+// ==================================================================================================
+#define KM271_PRG_BLOCKS    14                                     // config blocks per program
+#define KM271_PRG_POINTS    (KM271_PRG_BLOCKS * 3)                 // switch points per program
+#define KM271_PRG_UNUSED    7                                      // day of an unused switch point
+#define KM271_PRG_FULL      ((1 << KM271_PRG_BLOCKS) - 1)          // all blocks received
+
+typedef struct {
+  uint16_t  valid;                                                 // bitmask of received blocks
+  uint8_t   dirtyDays;                                             // bitmask of days to publish
+} s_km271_program;
+
+s_km271_program kmPrograms[KM271_PRG_CNT];
+const uint16_t  kmPrgBaseReg[KM271_PRG_CNT] = {0x0107, 0x0170};   // first contour register of HC1 / HC2
+const uint8_t   kmPrgWriteType[KM271_PRG_CNT] = {0x11, 0x12};      // write telegram type of HC1 / HC2 program
+const char     *kmPrgDays[7] = {"mo", "tu", "we", "th", "fr", "sa", "su"};
+#endif
+
+// Current raw values of the register mirror
+typedef struct {
+  uint8_t   raw;                                                   // last received raw byte
+  bool      valid;                                                 // value was received at least once
+  uint32_t  gen;                                                   // generation of the last change
+  uint8_t   prev;                                                  // change list: value changed before this one
+  uint8_t   next;                                                  // change list: value changed after this one
+} s_km271_value;
+
+#define KM271_GEN_NONE  0xFF                                       // end of change list
+
+s_km271_value kmValues[KM271_VAL_CNT];
+uint32_t      kmGeneration = 0;                                    // generation of the last change in the mirror
+uint32_t      kmEpoch = 0;                                         // random per boot, generations of other boots are not comparable
+uint8_t       kmGenOldest = KM271_GEN_NONE;                        // change list ordered by generation: oldest value
+uint8_t       kmGenNewest = KM271_GEN_NONE;                        // change list ordered by generation: newest value
+
+// Observers of value changes. The lists are built at subscription time,
+// so a change only calls the observers of exactly this value.
+typedef struct {
+  km271ValueCallback  callback;
+  void               *ctx;
+  uint8_t             next;                                        // next observer in list (index + 1, 0 = end)
+} s_km271_observer;
+
+s_km271_observer kmObservers[KM271_MAX_OBSERVERS];
+uint8_t       kmObsCnt = 0;                                        // used observer entries
+uint8_t       kmObsHead[KM271_VAL_CNT];                            // first observer per value (index + 1, 0 = none)
+uint8_t       kmObsAll = 0;                                        // first observer of all values (index + 1, 0 = none)
 //********************************************************************************************
 
 
@@ -107,36 +260,13 @@ void sendTxBlock(uint8_t *data, int len) {
 
 /**
  * *******************************************************************
- * @brief   Interpretation of an received information block
- * @details Checks and handles the information data received.
- *          Handles update of the global s_km271_status and provides event notifications
- *          to other tasks (if requested).
- *          Status data is handles under task lock to ensure consistency of status structure.
+ * @brief   publish the values of a received information block
+ * @param   kmregister: register of the block
  * @param   data: Pointer to the block of data received.
- * @param   len:  Blocksize in number of bytes, without protocol data 
+ * @param   tmpState: status structure, updated with the status values
  * @return  none
  * *******************************************************************/
-void parseInfo(uint8_t *data, int len) {
-  s_km271_status        tmpState;
-  
-  // Get current state
-  xSemaphoreTake(accessMutex, portMAX_DELAY);                             // Prevent task switch to ensure the whole structure remains constistent
-  memcpy(&tmpState, &kmState, sizeof(s_km271_status));
-  xSemaphoreGive(accessMutex);
-  uint16_t kmregister = (data[0] * 256) + data[1];
-  #ifdef DEBUG_ON
-  {
-    char topic[17];
-    snprintf(topic, sizeof(topic), "/unparsed/0x%04X", kmregister);
-    char message[64];
-    char *cp = &message[0], *end = &message[sizeof(message)];
-    for (int i=2; i<len && cp < end; i++) {
-      cp += snprintf(cp, end - cp, "%02X ", (unsigned)data[i]);
-    }
-    *(end-1)=0; // force terminator at the end
-    mqttPublish(addTopic(topic), message, false); 
-  }
-  #endif
+void km271PublishBlock(uint16_t kmregister, uint8_t *data, s_km271_status &tmpState) {
   switch(kmregister) {                                     // Check if we can find known stati
     
     /*
@@ -156,6 +286,7 @@ void parseInfo(uint8_t *data, int len) {
       mqttPublish(addTopic("/status/HC1_BW1_manual"), String(bitRead(tmpState.HeatingCircuitOperatingStates_1, 7)).c_str(), false);   
       break;
 
+    #ifdef USE_HC2
     case 0x8112:
       tmpState.HeatingCircuitOperatingStates_1 = data[2];                 // 0x8000 : Bitfield 
       mqttPublish(addTopic("/status/HC2_BW1_off_time_optimization"), String(bitRead(tmpState.HeatingCircuitOperatingStates_1, 0)).c_str(), false);
@@ -167,6 +298,7 @@ void parseInfo(uint8_t *data, int len) {
       mqttPublish(addTopic("/status/HC2_BW1_frost_protection"), String(bitRead(tmpState.HeatingCircuitOperatingStates_1, 6)).c_str(), false);
       mqttPublish(addTopic("/status/HC2_BW1_manual"), String(bitRead(tmpState.HeatingCircuitOperatingStates_1, 7)).c_str(), false);   
       break;
+    #endif
       
     case 0x8001:
       tmpState.HeatingCircuitOperatingStates_2 = data[2];                 // 0x8001 : Bitfield
@@ -179,6 +311,7 @@ void parseInfo(uint8_t *data, int len) {
       mqttPublish(addTopic("/status/HC1_BW2_external_signal_input"), String(bitRead(tmpState.HeatingCircuitOperatingStates_2, 6)).c_str(), false);        
       break;
 
+    #ifdef USE_HC2
      case 0x8113:
       tmpState.HeatingCircuitOperatingStates_2 = data[2];                 // 0x8001 : Bitfield
       mqttPublish(addTopic("/status/HC2_BW2_summer"), String(bitRead(tmpState.HeatingCircuitOperatingStates_2, 0)).c_str(), false);
@@ -189,116 +322,139 @@ void parseInfo(uint8_t *data, int len) {
       mqttPublish(addTopic("/status/HC2_BW2_flow_at_maximum"), String(bitRead(tmpState.HeatingCircuitOperatingStates_2, 5)).c_str(), false);
       mqttPublish(addTopic("/status/HC2_BW2_external_signal_input"), String(bitRead(tmpState.HeatingCircuitOperatingStates_2, 6)).c_str(), false);        
       break;
+    #endif
      
     case 0x8002:
       tmpState.HeatingForwardTargetTemp = (float)data[2];                 // 0x8002 : Temperature (1C resolution)
       mqttPublish(addTopic("/status/HC1_flow_setpoint"), String(tmpState.HeatingForwardTargetTemp).c_str(), false);  
       break;
 
+    #ifdef USE_HC2
     case 0x8114:
       tmpState.HeatingForwardTargetTemp = (float)data[2];                 // 0x8002 : Temperature (1C resolution)
       mqttPublish(addTopic("/status/HC2_flow_setpoint"), String(tmpState.HeatingForwardTargetTemp).c_str(), false);  
       break;
+    #endif
       
     case 0x8003:
       tmpState.HeatingForwardActualTemp = (float)data[2];                 // 0x8003 : Temperature (1C resolution)
       mqttPublish(addTopic("/status/HC1_flow_temperature"), String(tmpState.HeatingForwardActualTemp).c_str(), false);
       break;
       
+    #ifdef USE_HC2
     case 0x8115:
       tmpState.HeatingForwardActualTemp = (float)data[2];                 // 0x8003 : Temperature (1C resolution)
       mqttPublish(addTopic("/status/HC2_flow_temperature"), String(tmpState.HeatingForwardActualTemp).c_str(), false);
       break;
+    #endif
       
     case 0x8004:
       tmpState.RoomTargetTemp = decode05cTemp(data[2]);                   // 0x8004 : Temperature (0.5C resolution)
       mqttPublish(addTopic("/status/HC1_room_setpoint"), String(tmpState.RoomTargetTemp).c_str(), false);
       break;
       
+    #ifdef USE_HC2
     case 0x8116:
       tmpState.RoomTargetTemp = decode05cTemp(data[2]);                   // 0x8004 : Temperature (0.5C resolution)
       mqttPublish(addTopic("/status/HC2_room_setpoint"), String(tmpState.RoomTargetTemp).c_str(), false);
       break;
+    #endif
       
     case 0x8005:
       tmpState.RoomActualTemp = decode05cTemp(data[2]);                   // 0x8005 : Temperature (0.5C resolution)
       mqttPublish(addTopic("/status/HC1_room_temperature"), String(tmpState.RoomActualTemp).c_str(), false);
       break;
       
+    #ifdef USE_HC2
     case 0x8117:
       tmpState.RoomActualTemp = decode05cTemp(data[2]);                   // 0x8005 : Temperature (0.5C resolution)
       mqttPublish(addTopic("/status/HC2_room_temperature"), String(tmpState.RoomActualTemp).c_str(), false);
       break;
+    #endif
       
     case 0x8006:
       tmpState.SwitchOnOptimizationTime = data[2];                        // 0x8006 : Minutes
       mqttPublish(addTopic("/status/HC1_on_time_optimization_duration"), String(tmpState.SwitchOnOptimizationTime).c_str(), false);
       break;
       
+    #ifdef USE_HC2
     case 0x8118:
       tmpState.SwitchOnOptimizationTime = data[2];                        // 0x8006 : Minutes
       mqttPublish(addTopic("/status/HC2_on_time_optimization_duration"), String(tmpState.SwitchOnOptimizationTime).c_str(), false);
       break;
+    #endif
       
     case 0x8007:  
       tmpState.SwitchOffOptimizationTime = data[2];                       // 0x8007 : Minutes
       mqttPublish(addTopic("/status/HC1_off_time_optimization_duration"), String(tmpState.SwitchOffOptimizationTime).c_str(), false);
       break;
       
+    #ifdef USE_HC2
     case 0x8119:
       tmpState.SwitchOffOptimizationTime = data[2];                       // 0x8007 : Minutes
       mqttPublish(addTopic("/status/HC2_off_time_optimization_duration"), String(tmpState.SwitchOffOptimizationTime).c_str(), false);
       break;
+    #endif
       
     case 0x8008:  
       tmpState.PumpPower = data[2];                                       // 0x8008 : Percent
       mqttPublish(addTopic("/status/HC1_pump"), String(tmpState.PumpPower).c_str(), false);
       break;
       
+    #ifdef USE_HC2
     case 0x811a:  
       tmpState.PumpPower = data[2];                                       // 0x8008 : Percent
       mqttPublish(addTopic("/status/HC2_pump"), String(tmpState.PumpPower).c_str(), false);
       break;
+    #endif
       
     case 0x8009:
       tmpState.MixingValue = data[2];                                     // 0x8009 : Percent
       mqttPublish(addTopic("/status/HC1_mixer"), String(tmpState.MixingValue).c_str(), false);
       break;
       
+    #ifdef USE_HC2
     case 0x811b:
       tmpState.MixingValue = data[2];                                     // 0x8009 : Percent
       mqttPublish(addTopic("/status/HC2_mixer"), String(tmpState.MixingValue).c_str(), false);
       break;
+    #endif
       
     case 0x800c:
       tmpState.HeatingCurvePlus10 = (float)data[2];                       // 0x800c : Temperature (1C resolution)
       mqttPublish(addTopic("/status/HC1_heat_curve_10C"), String(tmpState.HeatingCurvePlus10).c_str(), false);
       break;
       
+    #ifdef USE_HC2
     case 0x811e:
       tmpState.HeatingCurvePlus10 = (float)data[2];                       // 0x800c : Temperature (1C resolution)
       mqttPublish(addTopic("/status/HC2_heat_curve_10C"), String(tmpState.HeatingCurvePlus10).c_str(), false);
       break;
+    #endif
       
     case 0x800d:
       tmpState.HeatingCurve0 = (float)data[2];                            // 0x800d : Temperature (1C resolution)
       mqttPublish(addTopic("/status/HC1_heat_curve_0C"), String(tmpState.HeatingCurve0).c_str(), false);
       break;
       
+    #ifdef USE_HC2
     case 0x811f:
       tmpState.HeatingCurve0 = (float)data[2];                            // 0x800d : Temperature (1C resolution)
       mqttPublish(addTopic("/status/HC2_heat_curve_0C"), String(tmpState.HeatingCurve0).c_str(), false);
       break;
+    #endif
       
     case 0x800e:
       tmpState.HeatingCurveMinus10 = (float)data[2];                      // 0x800e : Temperature (1C resolution)
       mqttPublish(addTopic("/status/HC1_heat_curve_-10C"), String(tmpState.HeatingCurveMinus10).c_str(), false);
       break;
       
+    #ifdef USE_HC2
     case 0x8120:
       tmpState.HeatingCurveMinus10 = (float)data[2];                      // 0x800e : Temperature (1C resolution)
       mqttPublish(addTopic("/status/HC2_heat_curve_-10C"), String(tmpState.HeatingCurveMinus10).c_str(), false);
       break;
+    #endif
       
     case 0x8424:
       tmpState.HotWaterOperatingStates_1 = data[2];                       // 0x8424 : Bitfield
@@ -463,6 +619,7 @@ void parseInfo(uint8_t *data, int len) {
       break;   
 
     
+    #ifdef USE_CONFIG_VALUES
     /*
     **********************************************************************************
     * config values beginnig with 0x00 
@@ -481,6 +638,7 @@ void parseInfo(uint8_t *data, int len) {
       mqttPublish(addTopic("/config/HC1_holiday_temperature"), String(decode05cTemp(data[2+5]) + String(" °C")).c_str(), false);      //CFG_HC1_Urlaubtemperatur"   => "0000:5,d:2"
       break;
 
+    #ifdef USE_HC2
     case 0x0038:
       mqttPublish(addTopic("/config/HC2_summer_mode_threshold"), (cfgSummerModeThreshold[data[2+1]-9]).c_str(), false);                       // "CFG_Sommer_ab"            => "0000:1,p:-9,a"
       mqttPublish(addTopic("/config/HC2_night_temperature"), String(decode05cTemp(data[2+2]) + String(" °C")).c_str(), false);       // "CFG_HC1_Nachttemperatur"  => "0000:2,d:2"
@@ -488,16 +646,19 @@ void parseInfo(uint8_t *data, int len) {
       mqttPublish(addTopic("/config/HC2_operating_mode"), cfgOperatingMode[data[2+4]].c_str(), false);                                  // CFG_HC1_Betriebsart"       => "0000:4,a:4"
       mqttPublish(addTopic("/config/HC2_holiday_temperature"), String(decode05cTemp(data[2+5]) + String(" °C")).c_str(), false);      //CFG_HC1_Urlaubtemperatur"   => "0000:5,d:2"
       break;
+    #endif
 
     case 0x000e: 
       mqttPublish(addTopic("/config/HC1_max_temperature"), String(data[2+2] + String(" °C")).c_str(), false);        // "CFG_HC1_Max_Temperatur"    => "000e:2"
       mqttPublish(addTopic("/config/HC1_interpretation"), String(data[2+4]).c_str(), false);                             // CFG_HC1_Auslegung"          => "000e:4"
       break;
     
+    #ifdef USE_HC2
     case 0x0046:
       mqttPublish(addTopic("/config/HC2_max_temperature"), String(data[2+2] + String(" °C")).c_str(), false);        // "CFG_HC1_Max_Temperatur"    => "000e:2"
       mqttPublish(addTopic("/config/HC2_interpretation"), String(data[2+4]).c_str(), false);                             // CFG_HC1_Auslegung"          => "000e:4"
       break;
+    #endif
     
     case 0x0015:
       mqttPublish(addTopic("/config/HC1_switch_on_temperature"), (cfgSwitchOnTemperature[data[2]] + String(" °C")).c_str(), false);  // "CFG_HC1_Aufschalttemperatur"  => "0015:0,a"
@@ -505,9 +666,13 @@ void parseInfo(uint8_t *data, int len) {
       break;
     
     case 0x004d:
+      #ifdef USE_HC2
       mqttPublish(addTopic("/config/HC2_switch_on_temperature"), (cfgSwitchOnTemperature[data[2]] + String(" °C")).c_str(), false);  // "CFG_HC1_Aufschalttemperatur"  => "0015:0,a"
+      #endif
       mqttPublish(addTopic("/config/DHW_priority"), cfgOnOff[data[2+1]].c_str(), false);     // "CFG_WW_Vorrang"   => "004d:1,a"
+      #ifdef USE_HC2
       mqttPublish(addTopic("/config/HC2_switch_off_threshold"), String(decodeNegTemp(data[2+2]) + String(" °C")).c_str(), false);        // CFG_HC1_Aussenhalt_ab"         => "0015:2,s"
+      #endif
       break;
     
     case 0x001c: 
@@ -515,10 +680,12 @@ void parseInfo(uint8_t *data, int len) {
       mqttPublish(addTopic("/config/HC1_heating_system"), cfgHeatingSystem[data[2+2]].c_str(), false);           // "CFG_HC1_Heizsystem"       => "001c:2,a"
       break;
 
+    #ifdef USE_HC2
     case 0x0054: 
       mqttPublish(addTopic("/config/HC2_reduction_mode"), cfgReductionMode[data[2+1]].c_str(), false);     // "CFG_HC1_Absenkungsart"    => "001c:1,a"
       mqttPublish(addTopic("/config/HC2_heating_system"), cfgHeatingSystem[data[2+2]].c_str(), false);           // "CFG_HC1_Heizsystem"       => "001c:2,a"
       break;
+    #endif
 
     case 0x0031: 
       mqttPublish(addTopic("/config/HC1_temperature_offset"), String(decode05cTemp(decodeNegTemp(data[2+3])) + String(" °C")).c_str(), false);   // "CFG_HC1_Temperatur_Offset"    => "0031:3,s,d:2"
@@ -526,11 +693,13 @@ void parseInfo(uint8_t *data, int len) {
       mqttPublish(addTopic("/config/frost_protection_cutoff"), String(decodeNegTemp(data[2+5]) + String(" °C")).c_str(), false);                               // "CFG_Frost_ab"                 => "0031:5,s"
       break;
 
+    #ifdef USE_HC2
     case 0x0069:
       mqttPublish(addTopic("/config/HC2_temperature_offset"), String(decode05cTemp(decodeNegTemp(data[2+3])) + String(" °C")).c_str(), false);   // "CFG_HC1_Temperatur_Offset"    => "0031:3,s,d:2"
       mqttPublish(addTopic("/config/HC2_remote_control"), cfgOnOff[data[2+4]].c_str(), false);                                                   // "CFG_HC1_Fernbedienung"        => "0031:4,a"  
       mqttPublish(addTopic("/config/HC2_frost_protection_cutoff"), String(decodeNegTemp(data[2+5]) + String(" °C")).c_str(), false);                               // "CFG_Frost_ab"                 => "0031:5,s"
       break;
+    #endif
 
     case 0x0070: 
       mqttPublish(addTopic("/config/building_type"), cfgBuildingType[data[2+2]].c_str(), false);     // "CFG_Gebaeudeart"   => "0070:2,a" 
@@ -571,9 +740,12 @@ void parseInfo(uint8_t *data, int len) {
       mqttPublish(addTopic("/config/HC1_program"), cfgHk1Program[data[2]].c_str(), false);     // "CFG_HC1_Programm"  => "0100:0"
       break;
 
+    #ifdef USE_HC2
     case 0x0169:
       mqttPublish(addTopic("/config/HC2_program"), cfgHk1Program[data[2]].c_str(), false);     // "CFG_HC1_Programm"  => "0100:0"
       break;
+    #endif
+    #endif // USE_CONFIG_VALUES
 
     case 0x0400:
         // 04_00_07_01_81_8e_00_c1_ff_00_00_00
@@ -582,17 +754,121 @@ void parseInfo(uint8_t *data, int len) {
 
     // undefined
     default:
-      if (kmregister >= 0x0107 && kmregister <= 0x0168) {
-        uint16_t n = kmregister - 0x0107;
-        // contour 1
-      }
-      if (kmregister >= 0x0170 && kmregister <= 0x01df) {
-        uint16_t n = kmregister - 0x0170;
-        // contour 2
-      }
       break;
   }
+}
+
+/**
+ * *******************************************************************
+ * @brief   Interpretation of an received information block
+ * @details Checks and handles the information data received.
+ *          Handles update of the global s_km271_status and provides event notifications
+ *          to other tasks (if requested).
+ *          Status data is handles under task lock to ensure consistency of status structure.
+ * @param   data: Pointer to the block of data received.
+ * @param   len:  Blocksize in number of bytes, without protocol data 
+ * @return  none
+ * *******************************************************************/
+void parseInfo(uint8_t *data, int len) {
+  s_km271_status        tmpState;
+  
+  // first log block of the register written by the last command confirms the new value
+  if (cmdStage == KM271_CMD_STAGE_ACKED && ((data[0] * 256) + data[1]) == cmdConfirmReg) {
+    cmdLatMark(KM271_CMD_STAGE_CONFIRMED);
+  }
+
+  // config blocks are the low priority part of the log-mode burst - if mqtt can not keep up,
+  // only their publishes are skipped: cache and programs are updated, the block is published later
+  bool publish = true;
+  #ifdef USE_CONFIG_VALUES
+  if (data[0] < 0x80 && mqttGetBackpressure() != MQTT_BP_NONE) {
+    mqttStatShed(MQTT_CLASS_CONFIG);
+    publish = false;
+  }
+  #else
+  if (data[0] < 0x80) {
+    return;                                                               // config values are not used in this profile
+  }
+  #endif
+
+  // Get current state
+  xSemaphoreTake(accessMutex, portMAX_DELAY);                             // Prevent task switch to ensure the whole structure remains constistent
+  memcpy(&tmpState, &kmState, sizeof(s_km271_status));
+  xSemaphoreGive(accessMutex);
+  uint16_t kmregister = (data[0] * 256) + data[1];
+
+  // detect installed modules by the register groups the controller sends
+  uint8_t grp = kmGroupOfHi[data[0]];
+  if (grp) {
+    if (!(kmGroupsPresent & (1 << (grp-1)))) {
+      kmGroupsPresent |= (1 << (grp-1));
+      kmModulesChanged = true;
+    }
+  } else if (data[0] >= 0x80 && !(kmUnknownHi[data[0] >> 5] & (1UL << (data[0] & 0x1f)))) {
+    kmUnknownHi[data[0] >> 5] |= (1UL << (data[0] & 0x1f));
+    kmModulesChanged = true;
+  }
+
+  // update register mirror
+  int valueId = km271FindValue(kmregister);
+  if (valueId >= 0) {
+    if (valueId == KM271_VAL_MODULE_ID && !(kmValues[valueId].valid && kmValues[valueId].raw == data[2])) {
+      kmModulesChanged = true;
+    }
+    km271UpdateValue((e_km271_valueId)valueId, data[2]);
+    // groups without own parser are published directly from the value table
+    if (grp && kmGroupDefs[grp-1].generic) {
+      char topic[64];
+      snprintf(topic, sizeof(topic), "/status/%s", kmValueDefs[valueId].name);
+      float value = km271DecodeValue((e_km271_valueId)valueId, data[2]);
+      // same format as the HC1/HC2 parsers: temperatures as float ("21.00"), numbers and bitfields as integer
+      e_km271_valueType type = kmValueDefs[valueId].type;
+      if (type == KM271_VT_NUMBER || type == KM271_VT_BITFIELD) {
+        mqttPublish(addTopic(topic), String((int)value).c_str(), false);
+      } else {
+        mqttPublish(addTopic(topic), String(value).c_str(), false);
+      }
+    }
+  }
+
+  // statistics of registers that are not decoded, sampled trace of one register
+  #ifdef USE_CONFIG_VALUES
+  if (valueId < 0 && km271ConfigIndex(kmregister) < 0 && kmregister != 0x0400) {
+  #else
+  if (valueId < 0 && kmregister != 0x0400) {
+  #endif
+    km271UnknownAdd(kmregister, &data[2], len - 2);
+  }
+  if (kmregister == kmTraceReg && (millis() - kmTraceLast) >= kmTraceInterval) {
+    km271TraceSend(kmregister, &data[2], len - 2);
+  }
+  if (publish) {
+    km271PublishBlock(kmregister, data, tmpState);
+  }
+
+  #ifdef USE_CONFIG_VALUES
+  // switching programs are parsed always, the days are published when mqtt can keep up
+  if (kmregister >= 0x0107 && kmregister <= 0x0168 && (kmregister - 0x0107) % 7 == 0) {
+    km271ParseProgramBlock(0, (kmregister - 0x0107) / 7, &data[2]);         // contour 1
+  }
+  #ifdef USE_HC2
+  if (kmregister >= 0x0170 && kmregister <= 0x01df && (kmregister - 0x0170) % 7 == 0) {
+    km271ParseProgramBlock(1, (kmregister - 0x0170) / 7, &data[2]);         // contour 2
+  }
+  #endif
+  #endif
  
+  #ifdef USE_CONFIG_VALUES
+  // raw config cache for backup / restore, shed blocks are published later
+  if (data[0] < 0x80 && len >= 8) {
+    km271StoreConfigBlock(kmregister, &data[2]);
+    int idx = km271ConfigIndex(kmregister);
+    if (!publish && idx >= 0) {
+      kmCfgUnpublished[idx / 8] |= (1 << (idx % 8));
+    }
+  }
+  #endif
+
   // write new values back if something has changed                           
   if(memcmp(&tmpState, &kmState, sizeof(s_km271_status))) {
     memcpy(&kmState, &tmpState, sizeof(s_km271_status)); 
@@ -603,31 +879,251 @@ void parseInfo(uint8_t *data, int len) {
 
 /**
  * *******************************************************************
- * @brief   Decodes KM271 temperatures with 0.5 C resolution
- * @details The value is provided in 0.5 steps
- * @param   data: the receive dat byte
- * @return  the decoded value as float
+ * @brief   Find the register mirror value of a KM271 register
+ * @details binary search inside the register group in the value table,
+ *          which is sorted by register
+ * @param   reg: KM271 register address
+ * @return  value id or -1 if the register is not part of the mirror
  * *******************************************************************/
-float decode05cTemp(uint8_t data) {
-  return ((float)data) / 2.0f;
+int km271FindValue(uint16_t reg) {
+  uint8_t grp = kmGroupOfHi[reg >> 8];
+  if (grp == 0) {
+    return -1;                                                            // register of an unknown group
+  }
+  int lo = kmGroupFirst[grp-1], hi = kmGroupFirst[grp-1] + kmGroupCnt[grp-1] - 1;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if (kmValueDefs[mid].reg == reg) {
+      return mid;
+    } else if (kmValueDefs[mid].reg < reg) {
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return -1;
 }
 
+/**
+ * *******************************************************************
+ * @brief   Store a received raw value in the register mirror
+ * @details observers are notified only if the value has changed
+ *          or was received for the first time
+ * @param   id: value id
+ * @param   raw: received raw byte
+ * @return  none
+ * *******************************************************************/
+void km271UpdateValue(e_km271_valueId id, uint8_t raw) {
+  if (kmValues[id].valid && kmValues[id].raw == raw) {
+    return;                                                               // nothing has changed
+  }
+  // move value to the end of the change list with a new generation
+  if (kmValues[id].valid) {
+    if (kmValues[id].prev != KM271_GEN_NONE) kmValues[kmValues[id].prev].next = kmValues[id].next; else kmGenOldest = kmValues[id].next;
+    if (kmValues[id].next != KM271_GEN_NONE) kmValues[kmValues[id].next].prev = kmValues[id].prev; else kmGenNewest = kmValues[id].prev;
+  }
+  kmValues[id].prev = kmGenNewest;
+  kmValues[id].next = KM271_GEN_NONE;
+  if (kmGenNewest != KM271_GEN_NONE) kmValues[kmGenNewest].next = id; else kmGenOldest = id;
+  kmGenNewest = id;
+
+  kmValues[id].raw = raw;
+  kmValues[id].valid = true;
+  kmValues[id].gen = ++kmGeneration;
+
+  // notify observers
+  float value = km271DecodeValue(id, raw);
+  for (uint8_t n = kmObsAll; n; n = kmObservers[n-1].next) {
+    kmObservers[n-1].callback(id, raw, value, kmObservers[n-1].ctx);
+  }
+  for (uint8_t n = kmObsHead[id]; n; n = kmObservers[n-1].next) {
+    kmObservers[n-1].callback(id, raw, value, kmObservers[n-1].ctx);
+  }
+}
 
 /**
  * *******************************************************************
- * @brief   Decodes KM271 temperatures with negative temperature range
- * @details Values >128 are negative
- * @param   data: the receive dat byte
- * @return  the decoded value as float
-  * ********************************************************************/
-float decodeNegTemp(uint8_t data) {
-  if(data > 128) {
-        return (((float)(256-data)) * -1.0f);
-  } else {
-        return (float)data;
+ * @brief   add an observer to a list
+ * @param   head: list head
+ * @param   callback: function to call on value change
+ * @param   ctx: context for the callback
+ * @return  false if there is no free observer entry
+ * *******************************************************************/
+bool km271AddObserver(uint8_t *head, km271ValueCallback callback, void *ctx) {
+  if (kmObsCnt >= KM271_MAX_OBSERVERS) {
+    return false;
+  }
+  kmObservers[kmObsCnt].callback = callback;
+  kmObservers[kmObsCnt].ctx = ctx;
+  kmObservers[kmObsCnt].next = *head;
+  kmObsCnt++;
+  *head = kmObsCnt;
+  return true;
+}
+
+/**
+ * *******************************************************************
+ * @brief   Subscribe to the changes of one value
+ * @details to be called during setup, subscriptions can not be removed
+ * @param   id: value id
+ * @param   callback: function to call on value change
+ * @param   ctx: context for the callback
+ * @return  false if there is no free observer entry
+ * *******************************************************************/
+bool km271Subscribe(e_km271_valueId id, km271ValueCallback callback, void *ctx) {
+  return km271AddObserver(&kmObsHead[id], callback, ctx);
+}
+
+/**
+ * *******************************************************************
+ * @brief   Subscribe to the changes of all values in a register range
+ * @details the range is resolved to single value subscriptions here,
+ *          so there is no range check on value changes
+ * @param   firstReg: first KM271 register
+ * @param   lastReg: last KM271 register
+ * @param   callback: function to call on value change
+ * @param   ctx: context for the callback
+ * @return  number of subscribed values or -1 if there is no free observer entry
+ * *******************************************************************/
+int km271SubscribeRange(uint16_t firstReg, uint16_t lastReg, km271ValueCallback callback, void *ctx) {
+  int cnt = 0;
+  for (int i = 0; i < KM271_VAL_CNT; i++) {
+    if (kmValueDefs[i].reg >= firstReg && kmValueDefs[i].reg <= lastReg) {
+      if (!km271Subscribe((e_km271_valueId)i, callback, ctx)) {
+        return -1;
+      }
+      cnt++;
+    }
   }
+  return cnt;
+}
+
+/**
+ * *******************************************************************
+ * @brief   Subscribe to the changes of all values
+ * @param   callback: function to call on value change
+ * @param   ctx: context for the callback
+ * @return  false if there is no free observer entry
+ * *******************************************************************/
+bool km271SubscribeAll(km271ValueCallback callback, void *ctx) {
+  return km271AddObserver(&kmObsAll, callback, ctx);
 }
 
+/**
+ * *******************************************************************
+ * @brief   Get the raw value of the register mirror
+ * @param   id: value id
+ * @param   pRaw: destination for the raw byte
+ * @return  false if the value was not received yet
+ * *******************************************************************/
+bool km271GetValue(e_km271_valueId id, uint8_t *pRaw) {
+  *pRaw = kmValues[id].raw;
+  return kmValues[id].valid;
+}
+
+/**
+ * *******************************************************************
+ * @brief   Get the epoch of the generations
+ * @param   none
+ * @return  random number, changes with every boot
+ * *******************************************************************/
+uint32_t km271GetEpoch() {
+  return kmEpoch;
+}
+
+/**
+ * *******************************************************************
+ * @brief   Get all values changed since a given generation
+ * @details the values are kept in a list ordered by generation, so only
+ *          the changed values are visited (oldest change first).
+ *          Generations restart after a reboot: if the epoch of the client
+ *          is not the actual one, all values are reported.
+ * @param   epoch: epoch of the generation known by the client (0 = unknown)
+ * @param   since: generation known by the client (0 = all values)
+ * @param   callback: called for every changed value
+ * @param   ctx: context for the callback
+ * @return  actual generation, to be used with km271GetEpoch() for the next call
+ * *******************************************************************/
+uint32_t km271GetChangesSince(uint32_t epoch, uint32_t since, km271ChangeCallback callback, void *ctx) {
+  uint8_t id = kmGenNewest;
+  uint8_t first = KM271_GEN_NONE;
+
+  if (epoch != kmEpoch || since > kmGeneration) {
+    since = 0;                                                            // client knows a generation from before a reboot
+  }
+  while (id != KM271_GEN_NONE && kmValues[id].gen > since) {             // search backwards for the first change
+    first = id;
+    id = kmValues[id].prev;
+  }
+  for (id = first; id != KM271_GEN_NONE; id = kmValues[id].next) {
+    callback((e_km271_valueId)id, kmValues[id].raw, kmValues[id].gen, ctx);
+  }
+  return kmGeneration;
+}
+
+/**
+ * *******************************************************************
+ * @brief   callback for sendKM271Changes()
+ * *******************************************************************/
+void addChangeJSON(e_km271_valueId id, uint8_t raw, uint32_t gen, void *ctx) {
+  JsonObject *values = (JsonObject *)ctx;
+  (*values)[kmValueDefs[id].name] = km271DecodeValue(id, raw);
+}
+
+/**
+ * *******************************************************************
+ * @brief   send all values changed since a given generation via mqtt
+ * @details answer of the request <topic>/cmd/sync (payload: epoch:generation)
+ *          on <topic>/sync as {"epoch":E,"gen":actual generation,"values":{...}}
+ *          - if E is not the epoch of the request, values contains all values
+ * @param   epoch: epoch known by the client (0 = unknown)
+ * @param   since: generation known by the client (0 = all values)
+ * @return  none
+ * *******************************************************************/
+void sendKM271Changes(uint32_t epoch, uint32_t since){
+  DynamicJsonDocument syncJSON(4096);
+  JsonObject values = syncJSON.createNestedObject("values");
+  syncJSON["epoch"] = km271GetEpoch();
+  syncJSON["gen"] = km271GetChangesSince(epoch, since, addChangeJSON, &values);
+  mqttPublishJson(addTopic("/sync"), syncJSON, false);
+}
+
+/**
+ * *******************************************************************
+ * @brief   Decode a raw value of the register mirror
+ * @param   id: value id
+ * @param   raw: raw byte
+ * @return  the decoded value as float
+ * *******************************************************************/
+float km271DecodeValue(e_km271_valueId id, uint8_t raw) {
+  return km271DecodeRaw(kmValueDefs[id].type, raw);
+}
+
+/**
+ * *******************************************************************
+ * @brief   Get the definition of a register mirror value
+ * @param   id: value id
+ * @return  pointer to the value definition
+ * *******************************************************************/
+const s_km271_valueDef *km271GetValueDef(e_km271_valueId id) {
+  return &kmValueDefs[id];
+}
+
+/**
+ * *******************************************************************
+ * @brief   Get the name of a value type
+ * @param   type: value type
+ * @return  name of the value type
+ * *******************************************************************/
+const char *km271ValueTypeName(e_km271_valueType type) {
+  switch (type) {
+    case KM271_VT_BITFIELD: return "bitfield";
+    case KM271_VT_TEMP:     return "temp";
+    case KM271_VT_TEMP05:   return "temp05";
+    case KM271_VT_TEMPNEG:  return "tempneg";
+    default:                return "number";
+  }
+}
 
 /**
  * *******************************************************************
@@ -659,6 +1155,21 @@ e_ret km271ProtInit(int rxPin, int txPin) {
   // Create the mutex to access the kmState structure in a safe manner
   accessMutex = xSemaphoreCreateMutex();
 
+  // generations restart at 0 after every boot
+  kmEpoch = esp_random() | 1;                                             // 0 is never a valid epoch
+
+  // build the group index of the value table
+  for (int g = 0; g < KM271_GRP_CNT; g++) {
+    kmGroupOfHi[kmGroupDefs[g].hiByte] = g + 1;
+  }
+  for (int i = KM271_VAL_CNT - 1; i >= 0; i--) {
+    uint8_t grp = kmGroupOfHi[kmValueDefs[i].reg >> 8];
+    if (grp) {
+      kmGroupFirst[grp-1] = i;
+      kmGroupCnt[grp-1]++;
+    }
+  }
+
   return RET_OK;  
 }
 
@@ -672,69 +1183,46 @@ e_ret km271ProtInit(int rxPin, int txPin) {
 void cyclicKM271(){
   // >>>>>>>>> KM271 Main Handling >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
   if(Serial2.readBytes(&rxByte, 1)) {                                   // Wait for RX byte, if timeout, just loop and read again
+    #ifdef USE_RAWBRIDGE
+    rawBridgeAdd(rxByte);                                               // raw byte stream for TCP clients
+    #endif
     // Protocol handling
-    kmRxBcc ^= rxByte;                                                  // Calculate BCC
-    switch(kmRxStatus) {
-      case KM_RX_RESYNC:                                                // Unknown state, discard everthing but STX
-        if(rxByte == KM_STX) {                                          // React on STX only to re-synchronise
-          kmRxBuf.buf[0] = KM_STX;                                      // Store current STX
-          kmRxBuf.len = 1;                                              // Set length
-          kmRxStatus = KM_RX_IDLE;                                      // Sync done, now continue to receive
-          handleRxBlock(kmRxBuf.buf, kmRxBuf.len, rxByte);              // Handle RX block
-        }
+    switch(km271RxByte(&kmRx, rxByte)) {
+      case KM271_RX_CTRL:                                               // STX, DLE, NAK
+      case KM271_RX_BLOCK:                                              // valid data block
+        handleRxBlock(kmRx.block.buf, kmRx.block.len, rxByte);          // Handle RX block, provide BCC for debug logging, too
         break;
-      case KM_RX_IDLE:                                                  // Start of block or command
-        kmRxBuf.buf[0] = rxByte;                                        // Store current byte
-        kmRxBuf.len = 1;                                                // Initialise length
-        kmRxBcc = rxByte;                                               // Reset BCC
-        if((rxByte == KM_STX) || (rxByte == KM_DLE) || (rxByte == KM_NAK)) {    // Give STX, DLE, NAK directly to caller
-          handleRxBlock(kmRxBuf.buf, kmRxBuf.len, rxByte);              // Handle RX block
-        } else {                                                        // Whole block will follow
-          kmRxStatus = KM_RX_ON;                                        // More data to follow, start collecting
-        }
-        break;                      
-      case KM_RX_ON:                                                    // Block reception ongoing
-        if(rxByte == KM_DLE) {                                          // Handle DLE doubling
-          kmRxStatus = KM_RX_DLE;                                       // Discard first received DLE, could be doubling or end of block, check in next state
-          break;                                                        // Quit here without storing
-        }
-        if(kmRxBuf.len >= KM_RX_BUF_LEN) {                              // Check allowed block len, if too long, re-sync
-          kmRxStatus = KM_RX_RESYNC;                                    // Enter re-sync
-          break;                                                        // Do not save data beyond array border
-        }
-        kmRxBuf.buf[kmRxBuf.len] = rxByte;                              // No DLE -> store regular, current byte
-        kmRxBuf.len++;                                                  // Adjust length in rx buffer
+      case KM271_RX_BCC_ERR:
+        sendTxBlock(KmCNAK, sizeof(KmCNAK));                            // Send NAK, ask for re-sending the block
+        kmProtStats.bccErrors++;
         break;
-      case KM_RX_DLE:                                                   // Entered when one DLE was already received
-        if(rxByte == KM_DLE) {                                          // Double DLE?
-          if(kmRxBuf.len >= KM_RX_BUF_LEN) {                            // Check allowed block len, if too long, re-sync
-            kmRxStatus = KM_RX_RESYNC;                                  // Enter re-sync
-            break;                                                      // Do not save data beyond array border
-          }
-          kmRxBuf.buf[kmRxBuf.len] = rxByte;                            // Yes -> store this DLE as valid part of data
-          kmRxBuf.len++;                                                // Adjust length in rx buffer
-          kmRxStatus = KM_RX_ON;                                        // Continue to receive block
-        } else {                                                        // This should be ETX now
-          if(rxByte == KM_ETX) {                                        // Really? then we are done, just waiting for BCC
-            kmRxStatus = KM_RX_BCC;                                     // Receive BCC and verify it
-          } else {
-            kmRxStatus = KM_RX_RESYNC;                                  // Something wrong, just try to restart 
-          }
-        }
+      case KM271_RX_RESYNC:
+        kmProtStats.resyncs++;
+        break;
+      default:
         break;
-      case KM_RX_BCC:                                                   // Last stage, BCC verification, "received BCC" ^ "calculated BCC" shall be 0 
-        if(!kmRxBcc) {                                                  // Block is valid
-          handleRxBlock(kmRxBuf.buf, kmRxBuf.len, rxByte);              // Handle RX block, provide BCC for debug logging, too
-        } else {
-          sendTxBlock(KmCNAK, sizeof(KmCNAK));                          // Send NAK, ask for re-sending the block
-        }
-        kmRxStatus = KM_RX_IDLE;                                        // Wait for next data or re-sent block
-        break;    
     } // end-case
   }  // end-if
   
   // global status logmode active
   km271LogModeActive = (KmRxBlockState == KM_TSK_LOGGING);
+
+  // start sending queued telegrams - the rest of a batch follows without log mode in between
+  if (!send_request && txQueueCnt && km271LogModeActive) {
+    km271TxQueuePop(send_buf);
+    send_request = true;
+  }
+
+  #ifdef USE_CONFIG_VALUES
+  // config values shed under mqtt backpressure
+  km271RepublishConfig();
+  #endif
+
+  // abandon latency measurement if the command was never confirmed
+  if (cmdStage >= 0 && (millis() - cmdStageTime[cmdStage]) > KM271_LAT_TIMEOUT) {
+    cmdStage = -1;
+    cmdLatAbandoned++;
+  }
 }
 
 /**
@@ -758,9 +1246,45 @@ void handleRxBlock(uint8_t *data, int len, uint8_t bcc) {
           sendTxBlock(KmCSTX, sizeof(KmCSTX));                              // Send STX to KM271
           break;
         case KM_DLE:                                                        // DLE received, KM ready to receive command
+          if (txAwaitAck) {                                                 // acknowledge of a sent telegram
+            cmdLatMark(KM271_CMD_STAGE_ACKED);
+            txAwaitAck = false;
+            txRetries = 0;
+            if (txQueueCnt) {                                               // more telegrams of a batch: request to send the next one
+              sendTxBlock(KmCSTX, sizeof(KmCSTX));
+              break;
+            }
+          } else if (txResend) {                                            // KM ready for the refused telegram
+            sendTxBlock(send_buf, sizeof(send_buf));
+            txResend = false;
+            txAwaitAck = true;
+            break;
+          } else if (txQueueCnt) {                                          // KM ready for the next telegram of a batch
+            km271TxQueuePop(send_buf);
+            sendTxBlock(send_buf, sizeof(send_buf));
+            kmProtStats.txTelegrams++;
+            txAwaitAck = true;
+            break;
+          }
           sendTxBlock(KmCLogMode, sizeof(KmCLogMode));                      // Send logging command
           KmRxBlockState = KM_TSK_LG_CMD;                                   // Switch to check for logging mode state
           break;
+        case KM_NAK:                                                        // telegram refused by the KM
+          if (!txAwaitAck) {
+            break;
+          }
+          txAwaitAck = false;
+          if (txRetries < KM271_TX_RETRIES) {                               // send it again after the next DLE
+            txRetries++;
+            kmProtStats.txRetries++;
+            txResend = true;
+          } else {                                                          // give up, continue with the batch or log mode
+            txRetries = 0;
+            kmProtStats.txFailed++;
+            LOG_W("km271: telegram refused, type 0x%02x", send_buf[0]);
+          }
+          sendTxBlock(KmCSTX, sizeof(KmCSTX));
+          break;
       }
       break;
     case KM_TSK_LG_CMD:                                                     // Check if logging mode is accepted by KM
@@ -768,6 +1292,13 @@ void handleRxBlock(uint8_t *data, int len, uint8_t bcc) {
         KmRxBlockState = KM_TSK_START;                                      // Back to START state
       } else {
         KmRxBlockState = KM_TSK_LOGGING;                                    // Command accepted, ready to log!
+        txAwaitAck = false;
+        txResend = false;
+        txRetries = 0;
+        kmProtStats.logModeStarts++;
+        if (!kmLogModeSince) {
+          kmLogModeSince = millis() | 1;
+        }
       }
       break;
     case KM_TSK_LOGGING:                                                    // We have reached logging state
@@ -779,17 +1310,152 @@ void handleRxBlock(uint8_t *data, int len, uint8_t bcc) {
           sendTxBlock(KmCDLE, sizeof(KmCDLE));                              // Confirm handling of block by sending DLE
         }
       } else if(data[0] == KM_DLE) {                                        // KM271 is ready to receive
+          cmdLatMark(KM271_CMD_STAGE_GRANTED);
           sendTxBlock(send_buf, sizeof(send_buf));                          // send buffer 
+          kmProtStats.txTelegrams++;
+          cmdLatMark(KM271_CMD_STAGE_SENT);
+          txAwaitAck = true;
+          txRetries = 0;
           send_request = false;                                             // reset send-request
           KmRxBlockState = KM_TSK_START;                                    // start log-mode again, to get all new values
       } else {                                                              // If not STX, it should be valid data block
         parseInfo(data, len);                                               // Handle data block with event information
+        kmProtStats.rxBlocks++;
         sendTxBlock(KmCDLE, sizeof(KmCDLE));                                // Confirm handling of block by sending DLE
       }
       break;
   }
 }
 
+/**
+ * *******************************************************************
+ * @brief   get the first config register of a write telegram type
+ * @details a write telegram with type t and offset o changes the config
+ *          block that is reported in log mode at km271WriteBaseRegister(t) + o
+ * @param   type: type byte of the write telegram (send_buf[0])
+ * @return  base register or 0xFFFF if unknown
+ * *******************************************************************/
+uint16_t km271WriteBaseRegister(uint8_t type) {
+  switch (type) {
+    case 0x07: return 0x0000;                                               // HC1 config
+    case 0x08: return 0x0038;                                               // HC2 config
+    case 0x0C: return 0x0077;                                               // DHW config
+    case 0x11: return 0x0100;                                               // HC1 program
+    case 0x12: return 0x0169;                                               // HC2 program
+    default:   return 0xFFFF;
+  }
+}
+
+/**
+ * *******************************************************************
+ * @brief   check a write telegram from outside (e.g. raw TCP clients)
+ * @details type and offset have to address the start of a config block
+ *          in kmWriteRanges
+ * @param   telegram: 8 byte write telegram (type, offset, 6 data bytes)
+ * @return  true if the telegram may be sent
+ * *******************************************************************/
+bool km271WriteAllowed(const uint8_t *telegram) {
+  uint16_t base = km271WriteBaseRegister(telegram[0]);
+  if (base == 0xFFFF) {
+    return false;
+  }
+  uint16_t reg = base + telegram[1];
+  for (size_t r = 0; r < KM271_WRITE_RANGES; r++) {
+    if (kmWriteRanges[r].type == telegram[0] && reg >= kmWriteRanges[r].first && reg <= kmWriteRanges[r].last
+        && (reg - kmWriteRanges[r].first) % 7 == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * *******************************************************************
+ * @brief   add a duration to a latency histogram
+ * @param   hist: histogram
+ * @param   ms: duration in milliseconds
+ * @return  none
+ * *******************************************************************/
+void cmdLatAdd(uint32_t *hist, uint32_t ms) {
+  uint8_t bucket = 0;
+  while (ms && bucket < KM271_LAT_BUCKETS - 1) {                            // bucket n: < 2^n ms
+    ms >>= 1;
+    bucket++;
+  }
+  hist[bucket]++;
+}
+
+/**
+ * *******************************************************************
+ * @brief   start the latency measurement of a queued telegram
+ * @details a new command replaces the current one
+ * @param   telegram: 8 byte write telegram
+ * @return  none
+ * *******************************************************************/
+void cmdLatQueued(const uint8_t *telegram) {
+  cmdStageTime[KM271_CMD_STAGE_RECEIVED] = cmdRxActive ? cmdRxTime : millis();  // not triggered by mqtt (e.g. DST change)
+  cmdStage = KM271_CMD_STAGE_RECEIVED;
+  cmdConfirmReg = 0xFFFF;
+  if (km271WriteBaseRegister(telegram[0]) != 0xFFFF) {
+    cmdConfirmReg = km271WriteBaseRegister(telegram[0]) + telegram[1];
+  }
+  cmdLatMark(KM271_CMD_STAGE_QUEUED);
+}
+
+/**
+ * *******************************************************************
+ * @brief   mark that the current command has reached the next stage
+ * @details only stages following directly the last reached stage are taken,
+ *          so out of order events of other telegrams are ignored
+ * @param   stage: reached stage
+ * @return  none
+ * *******************************************************************/
+void cmdLatMark(e_km271_cmdStage stage) {
+  if (cmdStage != stage - 1) return;                                        // not waiting for this stage
+  cmdStageTime[stage] = millis();
+  cmdLatAdd(cmdLatHist[stage], cmdStageTime[stage] - cmdStageTime[stage-1]);
+  cmdStage = stage;
+  if (stage == KM271_CMD_STAGE_CONFIRMED || (stage == KM271_CMD_STAGE_ACKED && cmdConfirmReg == 0xFFFF)) {
+    cmdLatAdd(cmdLatHist[0], cmdStageTime[stage] - cmdStageTime[KM271_CMD_STAGE_RECEIVED]);
+    cmdStage = -1;                                                          // measurement complete
+  }
+}
+
+/**
+ * *******************************************************************
+ * @brief   mark the receipt of a command by mqttCallback()
+ * @details to be called at the beginning (active = true) and the end
+ *          (active = false) of mqttCallback(). A command queued in
+ *          between takes the receipt time as start of its measurement.
+ * @param   active: true if the callback has started
+ * @return  none
+ * *******************************************************************/
+void km271CmdMarkReceived(bool active) {
+  cmdRxTime = millis();
+  cmdRxActive = active;
+}
+
+/**
+ * *******************************************************************
+ * @brief   send the command latency histograms via mqtt
+ * @details one array per stage with the number of commands per bucket
+ *          (<1ms, <2ms, <4ms ... <32s, >=32s), "total" covers the whole
+ *          path from mqtt receipt to the confirming log block.
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void sendKM271Latency(){
+  StaticJsonDocument<2048> latJSON;
+  for (int i = 0; i < KM271_CMD_STAGE_CNT; i++) {
+    JsonArray hist = latJSON.createNestedArray(cmdStageNames[i]);
+    for (int j = 0; j < KM271_LAT_BUCKETS; j++) {
+      hist.add(cmdLatHist[i][j]);
+    }
+  }
+  latJSON["abandoned"] = cmdLatAbandoned;
+  mqttPublishJson(addTopic("/info/latency"), latJSON, false);
+}
+
 /**
  * *******************************************************************
  * @brief   build info structure ans send it via mqtt
@@ -797,13 +1463,61 @@ void handleRxBlock(uint8_t *data, int len, uint8_t bcc) {
  * @return  none
  * *******************************************************************/
 void sendKM271Info(){
-  DynamicJsonDocument infoJSON(1024);
+  StaticJsonDocument<256> infoJSON;
   infoJSON[0]["logmode"] = km271LogModeActive;
-  infoJSON[0]["send_cmd_busy"] = send_request;
+  infoJSON[0]["send_cmd_busy"] = send_request || txQueueCnt;
   infoJSON[0]["date-time"] = getDateTimeString();
-  String sendInfoJSON;
-  serializeJson(infoJSON, sendInfoJSON);
-  mqttPublish(addTopic("/info"),String(sendInfoJSON).c_str(), false);
+  mqttPublishJson(addTopic("/info"), infoJSON, false);
+  if (kmModulesChanged) {
+    sendKM271Modules();
+  }
+}
+
+/**
+ * *******************************************************************
+ * @brief   get the register groups the controller has sent
+ * @param   none
+ * @return  bitmask of e_km271_group
+ * *******************************************************************/
+uint16_t km271GetGroups() {
+  return kmGroupsPresent;
+}
+
+/**
+ * *******************************************************************
+ * @brief   send the detected module set via mqtt
+ * @details module id, controller version, present register groups
+ *          and register high bytes without known group
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void sendKM271Modules(){
+  StaticJsonDocument<512> modJSON;
+  uint8_t raw, vk, nk;
+  if (km271GetValue(KM271_VAL_MODULE_ID, &raw)) {
+    modJSON["module_id"] = raw;
+  }
+  if (km271GetValue(KM271_VAL_VERSION_VK, &vk) && km271GetValue(KM271_VAL_VERSION_NK, &nk)) {
+    char version[8];
+    snprintf(version, sizeof(version), "%u.%u", vk, nk);
+    modJSON["version"] = version;
+  }
+  JsonArray groups = modJSON.createNestedArray("groups");
+  for (int g = 0; g < KM271_GRP_CNT; g++) {
+    if (kmGroupsPresent & (1 << g)) {
+      groups.add(kmGroupDefs[g].name);
+    }
+  }
+  JsonArray unknown = modJSON.createNestedArray("unknown");
+  for (int hi = 0x80; hi < 0x100; hi++) {
+    if (kmUnknownHi[hi >> 5] & (1UL << (hi & 0x1f))) {
+      char hex[5];
+      snprintf(hex, sizeof(hex), "0x%02x", hi);
+      unknown.add(hex);                                                   // copied by ArduinoJson (char*)
+    }
+  }
+  mqttPublishJson(addTopic("/info/modules"), modJSON, true);
+  kmModulesChanged = false;
 }
 
 /**
@@ -817,179 +1531,645 @@ void km271SetDateTime(){
   tm dti;                           // the structure tm holds time information in a more convient way
   time(&now);                       // read the current time
   localtime_r(&now, &dti);          // update the structure tm with the current time
-  send_request = true;
-  send_buf[0]= 0x01;                          // address
-  send_buf[1]= 0x00;                          // address
-  send_buf[2]= dti.tm_sec;                    // seconds
-  send_buf[3]= dti.tm_min;                    // minutes
-  send_buf[4]= dti.tm_hour;                   // hours (bit 0-4)
+  uint8_t telegram[8];
+  telegram[0]= 0x01;                          // address
+  telegram[1]= 0x00;                          // address
+  telegram[2]= dti.tm_sec;                    // seconds
+  telegram[3]= dti.tm_min;                    // minutes
+  telegram[4]= dti.tm_hour;                   // hours (bit 0-4)
   if (dti.tm_isdst>0)
-    send_buf[4] |= (1 << 6) & 0x40;           // if time ist DST  (bit 6) 
-  send_buf[5]= dti.tm_mday;                   // day of month
-  send_buf[6]= dti.tm_mon;                    // month
-  send_buf[6]|= (dti.tm_wday << 4) & 0x70;    // day of week (0=monday...6=sunday)
-  send_buf[7]= dti.tm_year-1900;              // year 
-  mqttPublish(addTopic("/message"), "date and time set!", false);
+    telegram[4] |= (1 << 6) & 0x40;           // if time ist DST  (bit 6) 
+  telegram[5]= dti.tm_mday;                   // day of month
+  telegram[6]= dti.tm_mon;                    // month
+  telegram[6]|= (dti.tm_wday << 4) & 0x70;    // day of week (0=monday...6=sunday)
+  telegram[7]= dti.tm_year-1900;              // year 
+  if (km271QueueTelegram(telegram)) {
+    mqttPublish(addTopic("/message"), "date and time set!", false);
+  } else {
+    mqttPublish(addTopic("/message"), "date and time: send queue full", false);
+  }
+}
+
+/**
+ * *******************************************************************
+ * @brief   get the actual value of a setvalue command from the config cache
+ * @param   sendCmd: send command
+ * @param   pValue: destination
+ * @return  false if the config block was not received yet
+ * *******************************************************************/
+bool km271GetCmdValue(e_km271_sendCmd sendCmd, int *pValue) {
+#ifdef USE_CONFIG_VALUES
+  if (sendCmd < 0 || sendCmd >= KM271_SENDCMD_CNT) {
+    return false;
+  }
+  const s_km271_cmdDef *def = &kmCmdDefs[sendCmd];
+  int idx = km271ConfigIndex(km271WriteBaseRegister(def->type) + def->offset);
+  if (idx < 0 || !(kmCfgValid[idx / 8] & (1 << (idx % 8)))) {
+    return false;
+  }
+  uint8_t raw = kmCfgRaw[idx][def->pos - 2];
+  *pValue = (def->min < 0) ? (int8_t)raw : raw;
+  return true;
+#else
+  return false;
+#endif
 }
 
 /**
  * *******************************************************************
  * @brief   prepare and send setvalues to buderus controller
  * @param   sendCmd: send command
- * @param   cmdPara: parameter
+ * @param   cmdPara: parameter (two's complement for negative values)
  * @return  none
  * *******************************************************************/
 void km271sendCmd(e_km271_sendCmd sendCmd, uint8_t cmdPara){
-
-  switch (sendCmd)
-  {
-  case KM271_SENDCMD_HK1_BA:
-    if (cmdPara>=0 && cmdPara<=2){
-      send_request = true;
-      send_buf[0]= 0x07;        // Daten-Typ für HK1 (0x07) 
-      send_buf[1]= 0x00;        // Offset
-      send_buf[2]= 0x65;
-      send_buf[3]= 0x65;
-      send_buf[4]= 0x65;
-      send_buf[5]= 0x65; 
-      send_buf[6]= cmdPara;     // 0:Nacht | 1:Tag | 2:AUTO
-      send_buf[7]= 0x65;
-      mqttPublish(addTopic("/message"), "setvalue: hk1_betriebsart - received", false);
+  char msg[64];
+  uint8_t telegram[8];
+  if (sendCmd < 0 || sendCmd >= KM271_SENDCMD_CNT) {
+    return;
+  }
+  int value = (kmCmdDefs[sendCmd].min < 0) ? (int8_t)cmdPara : cmdPara;
+  if (km271CmdTelegram(sendCmd, value, telegram)) {
+    if (km271QueueTelegram(telegram)) {
+      snprintf(msg, sizeof(msg), "setvalue: %s - received", kmCmdDefs[sendCmd].name);
     } else {
-      mqttPublish(addTopic("/message"), "setvalue: hk1_betriebsart - invald value", false);
+      snprintf(msg, sizeof(msg), "setvalue: %s - send queue full", kmCmdDefs[sendCmd].name);
     }
-    break;
-  
-  case KM271_SENDCMD_HK1_AUSLEGUNG:
-    if (cmdPara>=30 && cmdPara<=90){
-      send_request = true;
-      send_buf[0]= 0x07;        // Daten-Typ für HK1 (0x07)
-      send_buf[1]= 0x0E;        // Offset
-      send_buf[2]= 0x65;
-      send_buf[3]= 0x65;
-      send_buf[4]= 0x65;
-      send_buf[5]= 0x65;     
-      send_buf[6]= cmdPara;     // Auflösung: 1 °C Stellbereich: 30 – 90 °C WE: 75 °C
-      send_buf[7]= 0x65;
-      mqttPublish(addTopic("/message"), "setvalue: hk1_auslegung - received", false);
-    } else {
-      mqttPublish(addTopic("/message"), "setvalue: hk1_auslegung - invald value", false);
+  } else {
+    snprintf(msg, sizeof(msg), "setvalue: %s - invald value", kmCmdDefs[sendCmd].name);
+  }
+  mqttPublish(addTopic("/message"), msg, false);
+}
+
+/**
+ * *******************************************************************
+ * @brief   Retrieves the protocol health counters
+ * @param   pStats: The destination address the counters shall be stored to
+ * @return  none
+ * *******************************************************************/
+void km271GetProtStats(s_km271_protStats *pStats) {
+  memcpy(pStats, &kmProtStats, sizeof(s_km271_protStats));
+}
+
+/**
+ * *******************************************************************
+ * @brief   returns the status if LogMode is active
+ * @param   none
+ * @return  bool state of LogModeActive
+ * *******************************************************************/
+bool km271GetLogMode(){
+  return km271LogModeActive;
+}
+
+/**
+ * *******************************************************************
+ * @brief   add a write telegram to the send queue
+ * @details all queued telegrams are sent as one batch, the log mode
+ *          is started again after the last one
+ * @param   telegram: 8 bytes: type, offset, 6 data bytes (0x65 = unchanged)
+ * @return  false if the queue is full
+ * *******************************************************************/
+bool km271QueueTelegram(const uint8_t *telegram) {
+  if (txQueueCnt >= KM271_TX_QUEUE_LEN) {
+    return false;
+  }
+  memcpy(txQueue[(txQueueRd + txQueueCnt) % KM271_TX_QUEUE_LEN], telegram, 8);
+  txQueueCnt++;
+  cmdLatQueued(telegram);
+  return true;
+}
+
+/**
+ * *******************************************************************
+ * @brief   get free entries of the send queue
+ * @param   none
+ * @return  number of telegrams that can be queued
+ * *******************************************************************/
+uint8_t km271TxQueueFree() {
+  return KM271_TX_QUEUE_LEN - txQueueCnt;
+}
+
+/**
+ * *******************************************************************
+ * @brief   take the next telegram from the send queue
+ * @param   telegram: destination, 8 bytes
+ * @return  none
+ * *******************************************************************/
+void km271TxQueuePop(uint8_t *telegram) {
+  memcpy(telegram, txQueue[txQueueRd], 8);
+  txQueueRd = (txQueueRd + 1) % KM271_TX_QUEUE_LEN;
+  txQueueCnt--;
+}
+
+#ifdef USE_CONFIG_VALUES
+/**
+ * *******************************************************************
+ * @brief   get the index of a config block in the config cache
+ * @param   reg: register of the config block
+ * @return  index or -1 if the register is no config block
+ * *******************************************************************/
+int km271ConfigIndex(uint16_t reg) {
+  if (reg < 0x0100) {
+    return (reg % 7 == 0) ? reg / 7 : -1;
+  }
+  if ((reg - 0x0100) % 7 == 0 && (reg - 0x0100) / 7 < KM271_CFG_BLOCKS - 37) {
+    return 37 + (reg - 0x0100) / 7;
+  }
+  return -1;
+}
+
+/**
+ * *******************************************************************
+ * @brief   get the register of a config cache entry
+ * @param   idx: index in the config cache
+ * @return  register of the config block
+ * *******************************************************************/
+uint16_t km271ConfigRegister(int idx) {
+  return (idx < 37) ? idx * 7 : 0x0100 + (idx - 37) * 7;
+}
+
+/**
+ * *******************************************************************
+ * @brief   store a received config block in the config cache
+ * @param   reg: register of the config block
+ * @param   data: 6 data bytes of the block
+ * @return  none
+ * *******************************************************************/
+void km271StoreConfigBlock(uint16_t reg, const uint8_t *data) {
+  int idx = km271ConfigIndex(reg);
+  if (idx < 0) {
+    return;
+  }
+  memcpy(kmCfgRaw[idx], data, 6);
+  kmCfgValid[idx / 8] |= (1 << (idx % 8));
+}
+
+/**
+ * *******************************************************************
+ * @brief   get a switch point block of a program from the config cache
+ * @param   prg: program index (0 = HC1, 1 = HC2)
+ * @param   block: block index 0..13
+ * @return  pointer to the 6 data bytes
+ * *******************************************************************/
+uint8_t *km271ProgramBlock(uint8_t prg, uint8_t block) {
+  return kmCfgRaw[km271ConfigIndex(kmPrgBaseReg[prg] + block * 7)];
+}
+
+/**
+ * *******************************************************************
+ * @brief   check that all writable config blocks are in the config cache
+ * @param   list: destination for the registers of the missing blocks, e.g. "0038 003f"
+ * @param   len: size of list, the list ends with "..." if it is too short
+ * @return  number of missing blocks
+ * *******************************************************************/
+int km271MissingConfigBlocks(char *list, size_t len) {
+  int missing = 0;
+  size_t pos = 0;
+  list[0] = 0;
+  for (size_t r = 0; r < KM271_WRITE_RANGES; r++) {
+    for (uint16_t reg = kmWriteRanges[r].first; reg <= kmWriteRanges[r].last; reg += 7) {
+      int idx = km271ConfigIndex(reg);
+      if (idx >= 0 && (kmCfgValid[idx / 8] & (1 << (idx % 8)))) {
+        continue;
+      }
+      missing++;
+      if (pos + 9 < len) {                                                // room for " xxxx" and "..."
+        pos += snprintf(&list[pos], len - pos, "%s%04x", pos ? " " : "", reg);
+      } else if (pos + 3 < len) {
+        strcpy(&list[pos], "...");
+        pos = len;
+      }
     }
-    break;
-
-  case KM271_SENDCMD_HK1_PROGRAMM:
-    if (cmdPara>=0 && cmdPara<=8){
-      send_request = true;
-      send_buf[0]= 0x11;        // Daten-Typ
-      send_buf[1]= 0x00;        // Offset
-      send_buf[2]= cmdPara;     // Programmnummer 0..8
-      send_buf[3]= 0x65;
-      send_buf[4]= 0x65;
-      send_buf[5]= 0x65;     
-      send_buf[6]= 0x65; 
-      send_buf[7]= 0x65;
-      mqttPublish(addTopic("/message"), "setvalue: hk1_programm - received", false);
-    } else {
-      mqttPublish(addTopic("/message"), "setvalue: hk1_programm - invald value", false);
+  }
+  return missing;
+}
+
+/**
+ * *******************************************************************
+ * @brief   publish a backup of all received config blocks
+ * @details retained JSON on <topic>/config/backup:
+ *          {"version":1,"blocks":{"0000":"<12 hex digits>",...}}
+ *          The backup is refused until all writable blocks are received.
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void sendKM271ConfigBackup() {
+  char message[160], list[112];
+  int missing = km271MissingConfigBlocks(list, sizeof(list));
+  if (missing) {
+    snprintf(message, sizeof(message), "backup: %d blocks not received yet: %s", missing, list);
+    mqttPublish(addTopic("/message"), message, false);
+    return;
+  }
+  DynamicJsonDocument backupJSON(4096);
+  backupJSON["version"] = KM271_CFG_VERSION;
+  JsonObject blocks = backupJSON.createNestedObject("blocks");
+  for (int idx = 0; idx < KM271_CFG_BLOCKS; idx++) {
+    if (kmCfgValid[idx / 8] & (1 << (idx % 8))) {
+      char reg[5], hex[13];
+      snprintf(reg, sizeof(reg), "%04x", km271ConfigRegister(idx));
+      for (int i = 0; i < 6; i++) {
+        snprintf(&hex[i*2], 3, "%02x", kmCfgRaw[idx][i]);
+      }
+      blocks[reg] = hex;                                                  // key and value are copied (char*)
     }
-    break;
-
-  case KM271_SENDCMD_WW_BA:
-    if (cmdPara>=0 && cmdPara<=2){
-      send_request = true;
-      send_buf[0]= 0x0C;      // Daten-Typ für Warmwasser (0x0C)
-      send_buf[1]= 0x0E;      // Offset
-      send_buf[2]= cmdPara;   // 0:Nacht | 1:Tag | 2:AUTO
-      send_buf[3]= 0x65; 
-      send_buf[4]= 0x65;
-      send_buf[5]= 0x65; 
-      send_buf[6]= 0x65; 
-      send_buf[7]= 0x65;
-      mqttPublish(addTopic("/message"), "setvalue: dhw_mode - received", false);
-    } else {
-      mqttPublish(addTopic("/message"), "setvalue: dhw_mode - invald value", false);
+  }
+  mqttPublishJson(addTopic("/config/backup"), backupJSON, true);
+}
+
+/**
+ * *******************************************************************
+ * @brief   restore config blocks from a backup
+ * @details every block is compared with the config cache, only the
+ *          changed bytes are written (0x65 = unchanged). All telegrams
+ *          are queued as one batch, the log mode that is started again
+ *          afterwards confirms the new values.
+ *          The restore is refused until all writable blocks are received,
+ *          blocks without known write type are skipped.
+ * @param   json: backup as published by sendKM271ConfigBackup()
+ * @return  true if the telegrams were queued
+ * *******************************************************************/
+bool km271RestoreConfig(const char *json) {
+  DynamicJsonDocument backupJSON(4096);
+  char message[160], list[112];
+  int missing = km271MissingConfigBlocks(list, sizeof(list));
+  if (missing) {
+    snprintf(message, sizeof(message), "restore: %d blocks not received yet: %s", missing, list);
+    mqttPublish(addTopic("/message"), message, false);
+    return false;                                                         // unknown blocks could not be compared
+  }
+  if (deserializeJson(backupJSON, json) || backupJSON["version"] != KM271_CFG_VERSION) {
+    mqttPublish(addTopic("/message"), "restore: invalid backup", false);
+    return false;
+  }
+  JsonObject blocks = backupJSON["blocks"];
+  int telegrams = 0, skipped = 0;
+  // first pass counts the telegrams, the second one queues them - all or nothing
+  for (int pass = 0; pass < 2; pass++) {
+    for (JsonPair block : blocks) {
+      uint16_t reg = strtoul(block.key().c_str(), NULL, 16);
+      const char *hex = block.value().as<const char*>();
+      int idx = km271ConfigIndex(reg);
+      const s_km271_writeRange *range = NULL;
+      for (size_t r = 0; r < KM271_WRITE_RANGES; r++) {
+        if (reg >= kmWriteRanges[r].first && reg <= kmWriteRanges[r].last) {
+          range = &kmWriteRanges[r];
+        }
+      }
+      if (idx < 0 || range == NULL || hex == NULL || strlen(hex) != 12 || !(kmCfgValid[idx / 8] & (1 << (idx % 8)))) {
+        skipped += (pass == 0) ? 1 : 0;
+        continue;
+      }
+      uint8_t telegram[8];
+      bool changed = false, writable = true;
+      telegram[0] = range->type;
+      telegram[1] = reg - km271WriteBaseRegister(range->type);
+      for (int i = 0; i < 6; i++) {
+        char byteHex[3] = {hex[i*2], hex[i*2+1], 0};
+        uint8_t value = strtoul(byteHex, NULL, 16);
+        telegram[2+i] = 0x65;
+        if (value != kmCfgRaw[idx][i]) {
+          telegram[2+i] = value;
+          changed = true;
+          writable = writable && (value != 0x65);                         // 0x65 can not be written, it means "unchanged"
+        }
+      }
+      if (!changed || !writable) {
+        skipped += (pass == 0 && !writable) ? 1 : 0;
+        continue;
+      }
+      if (pass == 0) {
+        telegrams++;
+      } else {
+        km271QueueTelegram(telegram);
+      }
     }
-    break;
-
-  case KM271_SENDCMD_SOMMER_AB:
-    if (cmdPara>=9 && cmdPara<=31){
-      send_request = true;
-      send_buf[0]= 0x07;      // Daten-Typ für HK1 (0x07) 
-      send_buf[1]= 0x00;      // Offset 
-      send_buf[2]= 0x65;
-      send_buf[3]= cmdPara;   // 9:Winter | 10°-30° | 31:Sommer
-      send_buf[4]= 0x65;
-      send_buf[5]= 0x65; 
-      send_buf[6]= 0x65;
-      send_buf[7]= 0x65;
-      mqttPublish(addTopic("/message"), "setvalue: summer_threshold - received", false);
-    } else {
-      mqttPublish(addTopic("/message"), "setvalue: summer_threshold - invald value", false);
+    if (pass == 0 && telegrams > km271TxQueueFree()) {
+      snprintf(message, sizeof(message), "restore: %d telegrams do not fit into the send queue", telegrams);
+      mqttPublish(addTopic("/message"), message, false);
+      return false;
     }
-    break;
-
-  case KM271_SENDCMD_FROST_AB:
-    if (cmdPara>=-20 && cmdPara<=10){
-      send_request = true;
-      send_buf[0]= 0x07;      // Daten-Typ für HK1 (0x07) 
-      send_buf[1]= 0x31;      // Offset
-      send_buf[2]= 0x65;
-      send_buf[3]= 0x65;      
-      send_buf[4]= 0x65;
-      send_buf[5]= 0x65; 
-      send_buf[6]= 0x65;
-      send_buf[7]= cmdPara;    // -20° ... +10°
-      mqttPublish(addTopic("/message"), "setvalue: frost_ab - received", false);
-    } else {
-      mqttPublish(addTopic("/message"), "setvalue: frost_ab - invald value", false);
+  }
+  snprintf(message, sizeof(message), "restore: %d telegrams queued, %d blocks skipped", telegrams, skipped);
+  mqttPublish(addTopic("/message"), message, false);
+  return true;
+}
+
+/**
+ * *******************************************************************
+ * @brief   store a received switch point block in the program cache
+ * @details days with changed switch points are published as soon as
+ *          the whole program has been received
+ * @param   prg: program index (0 = HC1, 1 = HC2)
+ * @param   block: block index 0..13
+ * @param   data: 6 data bytes of the block
+ * @return  none
+ * *******************************************************************/
+void km271ParseProgramBlock(uint8_t prg, uint8_t block, uint8_t *data) {
+  s_km271_program *pPrg = &kmPrograms[prg];
+  uint8_t *raw = km271ProgramBlock(prg, block);
+  bool wasFull = (pPrg->valid == KM271_PRG_FULL);
+  if ((pPrg->valid & (1 << block)) && memcmp(raw, data, 6) == 0) {
+    return;                                                               // nothing has changed
+  }
+  // days of the old and the new switch points have changed
+  for (int i = 0; i < 6; i += 2) {
+    if (pPrg->valid & (1 << block)) {
+      pPrg->dirtyDays |= (1 << (raw[i] >> 4));
     }
-    break;
-
-  case KM271_SENDCMD_AUSSENHALT:
-    if (cmdPara>=-20 && cmdPara<=10){
-      send_request = true;
-      send_buf[0]= 0x07;      // Daten-Typ für HK1 (0x07)  
-      send_buf[1]= 0x15;      // Offset 
-      send_buf[2]= 0x65;
-      send_buf[3]= 0x65;       
-      send_buf[4]= cmdPara;   // -20° ... +10°
-      send_buf[5]= 0x65; 
-      send_buf[6]= 0x65;
-      send_buf[7]= 0x65;
-      mqttPublish(addTopic("/message"), "setvalue: aussenhalt_ab - received", false);
-    } else {
-      mqttPublish(addTopic("/message"), "setvalue: aussenhalt_ab - invald value", false);
+    pPrg->dirtyDays |= (1 << (data[i] >> 4));
+  }
+  km271StoreConfigBlock(kmPrgBaseReg[prg] + block * 7, data);
+  pPrg->valid |= (1 << block);
+
+  if (pPrg->valid != KM271_PRG_FULL) {
+    return;                                                               // wait for the complete program
+  }
+  if (!wasFull) {
+    pPrg->dirtyDays = 0x7F;                                               // first complete program: publish all days
+  }
+  if (mqttGetBackpressure() != MQTT_BP_NONE) {
+    return;                                                               // published later by km271RepublishConfig()
+  }
+  for (uint8_t day = 0; day < 7; day++) {
+    if (pPrg->dirtyDays & (1 << day)) {
+      sendKM271ProgramDay(prg, day);
     }
-    break;
-
-  case KM271_SENDCMD_WW_SOLL:
-    if (cmdPara>=30 && cmdPara<=60){
-      send_request = true;
-      send_buf[0]= 0x0C;        // Daten-Typ für Warmwasser (0x0C) DHW
-      send_buf[1]= 0x07;        // Offset
-      send_buf[2]= 0x65;
-      send_buf[3]= 0x65;       
-      send_buf[4]= 0x65;
-      send_buf[5]= cmdPara;     // 30°-60°
-      send_buf[6]= 0x65;
-      send_buf[7]= 0x65;
-      mqttPublish(addTopic("/message"), "setvalue: dhw_setpoint - received", false);
-    } else {
-      mqttPublish(addTopic("/message"), "setvalue: dhw_setpoint - invald value", false);
+  }
+  pPrg->dirtyDays = 0;
+}
+
+/**
+ * *******************************************************************
+ * @brief   publish config blocks that were shed under mqtt backpressure
+ * @details one block per call and only if the mqtt queue is not filled
+ *          above the high-water mark, the values are taken from the cache
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void km271RepublishConfig() {
+  if (mqttGetBackpressure() != MQTT_BP_NONE) {
+    return;
+  }
+  for (uint8_t prg = 0; prg < KM271_PRG_CNT; prg++) {
+    s_km271_program *pPrg = &kmPrograms[prg];
+    if (pPrg->valid == KM271_PRG_FULL && pPrg->dirtyDays) {
+      for (uint8_t day = 0; day < 7; day++) {
+        if (pPrg->dirtyDays & (1 << day)) {
+          sendKM271ProgramDay(prg, day);
+        }
+      }
+      pPrg->dirtyDays = 0;
+      return;
+    }
+  }
+  for (int idx = 0; idx < KM271_CFG_BLOCKS; idx++) {
+    if (kmCfgUnpublished[idx / 8] & (1 << (idx % 8))) {
+      kmCfgUnpublished[idx / 8] &= ~(1 << (idx % 8));
+      uint16_t reg = km271ConfigRegister(idx);
+      uint8_t data[8] = {(uint8_t)(reg >> 8), (uint8_t)(reg & 0xFF)};
+      s_km271_status tmpState;
+      memcpy(&data[2], kmCfgRaw[idx], 6);
+      km271PublishBlock(reg, data, tmpState);                             // config blocks do not use the status
+      return;
     }
-    break;
+  }
+}
 
-  default:
-    break;
+/**
+ * *******************************************************************
+ * @brief   publish the switch points of one day
+ * @details payload e.g. "05:30 on, 22:00 off" or "-" without switch points
+ * @param   prg: program index (0 = HC1, 1 = HC2)
+ * @param   day: 0 = monday .. 6 = sunday
+ * @return  none
+ * *******************************************************************/
+void sendKM271ProgramDay(uint8_t prg, uint8_t day) {
+  char topic[32];
+  char message[256];
+  char *cp = &message[0], *end = &message[sizeof(message)];
+  *cp = 0;
+  for (int n = 0; n < KM271_PRG_POINTS; n++) {
+    uint8_t *point = &km271ProgramBlock(prg, n / 3)[(n % 3) * 2];
+    if ((point[0] >> 4) == day && cp < end) {
+      cp += snprintf(cp, end - cp, "%s%02u:%02u %s", (cp == message) ? "" : ", ",
+                     point[1] / 6, (point[1] % 6) * 10, (point[0] & 0x01) ? "on" : "off");
+    }
   }
+  snprintf(topic, sizeof(topic), "/config/HC%u_program_%s", prg + 1, kmPrgDays[day]);
+  mqttPublish(addTopic(topic), (cp == message) ? "-" : message, false);
 }
 
 /**
  * *******************************************************************
- * @brief   returns the status if LogMode is active
+ * @brief   change the switch points of one day
+ * @details the new switch points take the slots of the old ones of this
+ *          day, additional ones use unused slots. Only the blocks that
+ *          differ from the cached program are written to the controller.
+ * @param   prg: program index (0 = HC1, 1 = HC2)
+ * @param   dayName: "mo" .. "su"
+ * @param   points: e.g. "05:30 on, 22:00 off", "-" = no switch points
+ * @return  true if the telegrams were queued
+ * *******************************************************************/
+bool km271SetProgramDay(uint8_t prg, const char *dayName, const char *points) {
+  uint8_t newPoints[KM271_PRG_POINTS][2];
+  uint8_t newCnt = 0;
+  uint8_t day;
+  uint8_t raw[KM271_PRG_BLOCKS][6];
+
+  for (day = 0; day < 7 && strcmp(dayName, kmPrgDays[day]) != 0; day++);
+  if (prg >= KM271_PRG_CNT || day >= 7) {
+    mqttPublish(addTopic("/message"), "setvalue: switch program - invalid day", false);
+    return false;
+  }
+  if (kmPrograms[prg].valid != KM271_PRG_FULL) {
+    mqttPublish(addTopic("/message"), "setvalue: switch program - program not received yet", false);
+    return false;
+  }
+
+  // parse "hh:mm on|off" separated by comma
+  const char *cp = points;
+  while (*cp && strcmp(cp, "-") != 0) {
+    unsigned hour, minute;
+    char state[4];
+    if (sscanf(cp, " %u:%u %3s", &hour, &minute, state) != 3 || hour > 23 || minute > 59 || minute % 10 ||
+        (strncmp(state, "on", 2) != 0 && strncmp(state, "off", 3) != 0) || newCnt >= KM271_PRG_POINTS) {
+      mqttPublish(addTopic("/message"), "setvalue: switch program - invalid switch point", false);
+      return false;
+    }
+    newPoints[newCnt][0] = (day << 4) | ((state[1] == 'n') ? 0x01 : 0x00);
+    newPoints[newCnt][1] = hour * 6 + minute / 10;
+    newCnt++;
+    cp = strchr(cp, ',');
+    if (cp == NULL) break;
+    cp++;
+  }
+
+  // new switch points into the slots of this day first, then into unused slots
+  for (int b = 0; b < KM271_PRG_BLOCKS; b++) {
+    memcpy(raw[b], km271ProgramBlock(prg, b), 6);
+  }
+  uint8_t used = 0;
+  for (int pass = 0; pass < 2; pass++) {
+    uint8_t slotDay = (pass == 0) ? day : KM271_PRG_UNUSED;
+    for (int n = 0; n < KM271_PRG_POINTS; n++) {
+      uint8_t *point = &raw[n / 3][(n % 3) * 2];
+      if ((point[0] >> 4) != slotDay) continue;
+      if (used < newCnt) {
+        point[0] = newPoints[used][0];
+        point[1] = newPoints[used][1];
+        used++;
+      } else if (pass == 0) {
+        point[0] = KM271_PRG_UNUSED << 4;                                 // switch point no longer used
+        point[1] = 0;
+      }
+    }
+  }
+  if (used < newCnt) {
+    mqttPublish(addTopic("/message"), "setvalue: switch program - too many switch points", false);
+    return false;
+  }
+
+  // write only the changed blocks
+  uint8_t changed = 0;
+  for (int b = 0; b < KM271_PRG_BLOCKS; b++) {
+    changed += memcmp(raw[b], km271ProgramBlock(prg, b), 6) ? 1 : 0;
+  }
+  if (changed > km271TxQueueFree()) {
+    mqttPublish(addTopic("/message"), "setvalue: switch program - send queue full", false);
+    return false;
+  }
+  for (int b = 0; b < KM271_PRG_BLOCKS; b++) {
+    if (memcmp(raw[b], km271ProgramBlock(prg, b), 6) != 0) {
+      uint8_t telegram[8];
+      telegram[0] = kmPrgWriteType[prg];
+      telegram[1] = 0x07 + b * 7;                                         // offset of the block to the program base register
+      memcpy(&telegram[2], raw[b], 6);
+      km271QueueTelegram(telegram);
+    }
+  }
+  mqttPublish(addTopic("/message"), "setvalue: switch program - received", false);
+  return true;
+}
+#endif
+
+/**
+ * *******************************************************************
+ * @brief   count a received block of a register that is not decoded
+ * @param   reg: register address
+ * @param   data: payload of the block
+ * @param   len: length of the payload
+ * @return  none
+ * *******************************************************************/
+void km271UnknownAdd(uint16_t reg, const uint8_t *data, int len) {
+  int i;
+  if (len > 6) len = 6;
+  for (i = 0; i < kmUnknownCnt && kmUnknown[i].reg != reg; i++);
+  if (i == kmUnknownCnt) {
+    if (kmUnknownCnt >= KM271_UNKNOWN_MAX) {
+      kmUnknownOverflow++;
+      return;
+    }
+    kmUnknownCnt++;
+    kmUnknown[i].reg = reg;
+    kmUnknown[i].firstSeen = millis();
+    kmUnknown[i].count = 0;
+    kmUnknown[i].changes = 0;
+  } else if (kmUnknown[i].len != len || memcmp(kmUnknown[i].last, data, len) != 0) {
+    kmUnknown[i].changes++;
+  }
+  kmUnknown[i].count++;
+  kmUnknown[i].len = len;
+  memcpy(kmUnknown[i].last, data, len);
+}
+
+/**
+ * *******************************************************************
+ * @brief   send the statistics of the registers that are not decoded
+ * @details {"overflow":n,"registers":[{"reg":"0x800a","first_seen":s,"count":n,"changes":n,"rate":n/min,"last":"hex"},...],
+ *          "unseen":["name",...]}, unseen: values of installed modules that were never received
  * @param   none
- * @return  bool state of LogModeActive
+ * @return  none
  * *******************************************************************/
-bool km271GetLogMode(){
-  return km271LogModeActive;
+void sendKM271Unknown() {
+  // root, registers with two copied strings each, names of unseen values (not copied)
+  const size_t size = JSON_OBJECT_SIZE(3) + JSON_ARRAY_SIZE(KM271_UNKNOWN_MAX)
+                    + KM271_UNKNOWN_MAX * (JSON_OBJECT_SIZE(6) + sizeof("0x0000") + 13)
+                    + JSON_ARRAY_SIZE(KM271_VAL_CNT);
+  DynamicJsonDocument unkJSON(size);
+  char hex[13], reg[7];
+  uint32_t now = millis();
+  unkJSON["overflow"] = kmUnknownOverflow;
+  JsonArray regs = unkJSON.createNestedArray("registers");
+  for (int i = 0; i < kmUnknownCnt; i++) {
+    JsonObject entry = regs.createNestedObject();
+    snprintf(reg, sizeof(reg), "0x%04x", kmUnknown[i].reg);
+    for (int n = 0; n < kmUnknown[i].len; n++) {
+      snprintf(&hex[n*2], 3, "%02x", kmUnknown[i].last[n]);
+    }
+    hex[kmUnknown[i].len * 2] = 0;
+    entry["reg"] = reg;                                                   // copied (char*)
+    entry["first_seen"] = kmUnknown[i].firstSeen / 1000;
+    entry["count"] = kmUnknown[i].count;
+    entry["changes"] = kmUnknown[i].changes;
+    entry["rate"] = (now - kmUnknown[i].firstSeen) ? (float)kmUnknown[i].changes * 60000.0f / (now - kmUnknown[i].firstSeen) : 0;
+    entry["last"] = hex;                                                  // copied (char*)
+  }
+  // values of installed modules the controller did not send after the start of log mode
+  if (kmLogModeSince && now - kmLogModeSince >= KM271_UNSEEN_TIME) {
+    JsonArray unseen = unkJSON.createNestedArray("unseen");
+    for (int g = 0; g < KM271_GRP_CNT; g++) {
+      if (!(kmGroupsPresent & (1 << g))) {
+        continue;
+      }
+      for (int id = kmGroupFirst[g]; id < kmGroupFirst[g] + kmGroupCnt[g]; id++) {
+        if (!kmValues[id].valid) {
+          unseen.add(kmValueDefs[id].name);                               // not copied (const char*)
+        }
+      }
+    }
+  }
+  mqttPublishJson(addTopic("/info/unknown"), unkJSON, false);
+}
+
+/**
+ * *******************************************************************
+ * @brief   start or stop the sampled trace of one register
+ * @param   param: "0x8224" or "0x8224,1000" (min. ms between messages), "off" = stop
+ * @return  none
+ * *******************************************************************/
+void km271SetTrace(const char *param) {
+  char *end;
+  uint16_t reg = strtoul(param, &end, 16);
+  if (end == param) {
+    kmTraceReg = 0xFFFF;
+    mqttPublish(addTopic("/message"), "trace: off", false);
+    return;
+  }
+  kmTraceReg = reg;
+  kmTraceInterval = (*end == ',') ? strtoul(end + 1, NULL, 10) : 0;
+  kmTraceLast = millis() - kmTraceInterval;
+  mqttPublish(addTopic("/message"), "trace: on", false);
+}
+
+/**
+ * *******************************************************************
+ * @brief   publish a block of the traced register
+ * @param   reg: register address
+ * @param   data: payload of the block
+ * @param   len: length of the payload
+ * @return  none
+ * *******************************************************************/
+void km271TraceSend(uint16_t reg, const uint8_t *data, int len) {
+  char topic[16];
+  char message[20];
+  char *cp = &message[0];
+  if (len > 6) len = 6;
+  *cp = 0;
+  for (int i = 0; i < len; i++) {
+    cp += snprintf(cp, &message[sizeof(message)] - cp, "%02x ", data[i]);
+  }
+  snprintf(topic, sizeof(topic), "/trace/0x%04x", reg);
+  mqttPublish(addTopic(topic), message, false);
+  kmTraceLast = millis();
 }
@@ -0,0 +1,279 @@
+//*****************************************************************************
+// 
+// Title      : KM271 protocol decoding without Arduino dependencies
+// Remark     : 3964R receive state machine, register table, value decoding and
+//              write telegrams of the setvalue commands.
+//              Used by the firmware (km271.cpp) and by the host tools in tools/.
+//
+//*****************************************************************************
+#include <km271_proto.h>
+#include <string.h>
+
+// ==================================================================================================
+// Register mirror of the status values - order has to match e_km271_valueId, sorted by register
+// ==================================================================================================
+const s_km271_valueDef kmValueDefs[KM271_VAL_CNT] = {
+  {0x8000, KM271_VT_BITFIELD, "HC1_operating_states_1"},
+  {0x8001, KM271_VT_BITFIELD, "HC1_operating_states_2"},
+  {0x8002, KM271_VT_TEMP,     "HC1_flow_setpoint"},
+  {0x8003, KM271_VT_TEMP,     "HC1_flow_temperature"},
+  {0x8004, KM271_VT_TEMP05,   "HC1_room_setpoint"},
+  {0x8005, KM271_VT_TEMP05,   "HC1_room_temperature"},
+  {0x8006, KM271_VT_NUMBER,   "HC1_on_time_optimization_duration"},
+  {0x8007, KM271_VT_NUMBER,   "HC1_off_time_optimization_duration"},
+  {0x8008, KM271_VT_NUMBER,   "HC1_pump"},
+  {0x8009, KM271_VT_NUMBER,   "HC1_mixer"},
+  {0x800c, KM271_VT_TEMP,     "HC1_heat_curve_10C"},
+  {0x800d, KM271_VT_TEMP,     "HC1_heat_curve_0C"},
+  {0x800e, KM271_VT_TEMP,     "HC1_heat_curve_-10C"},
+#ifdef USE_HC2
+  {0x8112, KM271_VT_BITFIELD, "HC2_operating_states_1"},
+  {0x8113, KM271_VT_BITFIELD, "HC2_operating_states_2"},
+  {0x8114, KM271_VT_TEMP,     "HC2_flow_setpoint"},
+  {0x8115, KM271_VT_TEMP,     "HC2_flow_temperature"},
+  {0x8116, KM271_VT_TEMP05,   "HC2_room_setpoint"},
+  {0x8117, KM271_VT_TEMP05,   "HC2_room_temperature"},
+  {0x8118, KM271_VT_NUMBER,   "HC2_on_time_optimization_duration"},
+  {0x8119, KM271_VT_NUMBER,   "HC2_off_time_optimization_duration"},
+  {0x811a, KM271_VT_NUMBER,   "HC2_pump"},
+  {0x811b, KM271_VT_NUMBER,   "HC2_mixer"},
+  {0x811e, KM271_VT_TEMP,     "HC2_heat_curve_10C"},
+  {0x811f, KM271_VT_TEMP,     "HC2_heat_curve_0C"},
+  {0x8120, KM271_VT_TEMP,     "HC2_heat_curve_-10C"},
+#endif
+#ifdef USE_HC3_HC4
+  {0x8224, KM271_VT_BITFIELD, "HC3_operating_states_1"},
+  {0x8225, KM271_VT_BITFIELD, "HC3_operating_states_2"},
+  {0x8226, KM271_VT_TEMP,     "HC3_flow_setpoint"},
+  {0x8227, KM271_VT_TEMP,     "HC3_flow_temperature"},
+  {0x8228, KM271_VT_TEMP05,   "HC3_room_setpoint"},
+  {0x8229, KM271_VT_TEMP05,   "HC3_room_temperature"},
+  {0x822a, KM271_VT_NUMBER,   "HC3_on_time_optimization_duration"},
+  {0x822b, KM271_VT_NUMBER,   "HC3_off_time_optimization_duration"},
+  {0x822c, KM271_VT_NUMBER,   "HC3_pump"},
+  {0x822d, KM271_VT_NUMBER,   "HC3_mixer"},
+  {0x8230, KM271_VT_TEMP,     "HC3_heat_curve_10C"},
+  {0x8231, KM271_VT_TEMP,     "HC3_heat_curve_0C"},
+  {0x8232, KM271_VT_TEMP,     "HC3_heat_curve_-10C"},
+  {0x8336, KM271_VT_BITFIELD, "HC4_operating_states_1"},
+  {0x8337, KM271_VT_BITFIELD, "HC4_operating_states_2"},
+  {0x8338, KM271_VT_TEMP,     "HC4_flow_setpoint"},
+  {0x8339, KM271_VT_TEMP,     "HC4_flow_temperature"},
+  {0x833a, KM271_VT_TEMP05,   "HC4_room_setpoint"},
+  {0x833b, KM271_VT_TEMP05,   "HC4_room_temperature"},
+  {0x833c, KM271_VT_NUMBER,   "HC4_on_time_optimization_duration"},
+  {0x833d, KM271_VT_NUMBER,   "HC4_off_time_optimization_duration"},
+  {0x833e, KM271_VT_NUMBER,   "HC4_pump"},
+  {0x833f, KM271_VT_NUMBER,   "HC4_mixer"},
+  {0x8342, KM271_VT_TEMP,     "HC4_heat_curve_10C"},
+  {0x8343, KM271_VT_TEMP,     "HC4_heat_curve_0C"},
+  {0x8344, KM271_VT_TEMP,     "HC4_heat_curve_-10C"},
+#endif
+  {0x8424, KM271_VT_BITFIELD, "DHW_operating_states_1"},
+  {0x8425, KM271_VT_BITFIELD, "DHW_operating_states_2"},
+  {0x8426, KM271_VT_TEMP,     "DHW_setpoint"},
+  {0x8427, KM271_VT_TEMP,     "DHW_temperature"},
+  {0x8428, KM271_VT_NUMBER,   "DHW_optimization_time"},
+  {0x8429, KM271_VT_BITFIELD, "DHW_pump_type"},
+  {0x882a, KM271_VT_TEMP,     "boiler_setpoint"},
+  {0x882b, KM271_VT_TEMP,     "boiler_temperature"},
+  {0x882c, KM271_VT_TEMP,     "burner_switch_on_temperature"},
+  {0x882d, KM271_VT_TEMP,     "burner_switch_off_temperature"},
+  {0x882e, KM271_VT_NUMBER,   "boiler_integral_1"},
+  {0x882f, KM271_VT_NUMBER,   "boiler_integral_2"},
+  {0x8830, KM271_VT_BITFIELD, "boiler_failure_states"},
+  {0x8831, KM271_VT_BITFIELD, "boiler_operating_states"},
+  {0x8832, KM271_VT_NUMBER,   "burner_control"},
+  {0x8833, KM271_VT_TEMP,     "exhaust_gas_temperature"},
+  {0x8836, KM271_VT_NUMBER,   "burner_lifetime_minutes65536"},
+  {0x8837, KM271_VT_NUMBER,   "burner_lifetime_minutes256"},
+  {0x8838, KM271_VT_NUMBER,   "burner_lifetime_minutes"},
+  {0x893c, KM271_VT_TEMPNEG,  "outside_temperature"},
+  {0x893d, KM271_VT_TEMPNEG,  "outside_temperature_damped"},
+  {0x893e, KM271_VT_NUMBER,   "version_VK"},
+  {0x893f, KM271_VT_NUMBER,   "version_NK"},
+  {0x8940, KM271_VT_NUMBER,   "module_id"},
+  {0xaa42, KM271_VT_BITFIELD, "ERR_alarm_status"},
+};
+
+
+/**
+ * *******************************************************************
+ * @brief   3964R receive state machine
+ * @details handles DLE doubling, block end and BCC check of one byte.
+ *          The caller has to answer blocks (DLE) and BCC errors (NAK).
+ * @param   rx: receive state
+ * @param   rxByte: received byte
+ * @return  result, the block is available in rx->block
+ * *******************************************************************/
+e_km271_rxResult km271RxByte(s_km271_rx *rx, uint8_t rxByte) {
+  rx->bcc ^= rxByte;                                                      // Calculate BCC
+  switch(rx->state) {
+    case KM_RX_RESYNC:                                                    // Unknown state, discard everthing but STX
+      if(rxByte == KM_STX) {                                              // React on STX only to re-synchronise
+        rx->block.buf[0] = KM_STX;                                        // Store current STX
+        rx->block.len = 1;                                                // Set length
+        rx->state = KM_RX_IDLE;                                           // Sync done, now continue to receive
+        return KM271_RX_CTRL;
+      }
+      break;
+    case KM_RX_IDLE:                                                      // Start of block or command
+      rx->block.buf[0] = rxByte;                                          // Store current byte
+      rx->block.len = 1;                                                  // Initialise length
+      rx->bcc = rxByte;                                                   // Reset BCC
+      if((rxByte == KM_STX) || (rxByte == KM_DLE) || (rxByte == KM_NAK)) {    // Give STX, DLE, NAK directly to caller
+        return KM271_RX_CTRL;
+      }
+      rx->state = KM_RX_ON;                                               // More data to follow, start collecting
+      break;
+    case KM_RX_ON:                                                        // Block reception ongoing
+      if(rxByte == KM_DLE) {                                              // Handle DLE doubling
+        rx->state = KM_RX_DLE;                                            // Discard first received DLE, could be doubling or end of block, check in next state
+        break;
+      }
+      if(rx->block.len >= KM_RX_BUF_LEN) {                                // Check allowed block len, if too long, re-sync
+        rx->state = KM_RX_RESYNC;
+        return KM271_RX_RESYNC;                                           // Do not save data beyond array border
+      }
+      rx->block.buf[rx->block.len++] = rxByte;                            // No DLE -> store regular, current byte
+      break;
+    case KM_RX_DLE:                                                       // Entered when one DLE was already received
+      if(rxByte == KM_DLE) {                                              // Double DLE?
+        if(rx->block.len >= KM_RX_BUF_LEN) {                              // Check allowed block len, if too long, re-sync
+          rx->state = KM_RX_RESYNC;
+          return KM271_RX_RESYNC;
+        }
+        rx->block.buf[rx->block.len++] = rxByte;                          // Yes -> store this DLE as valid part of data
+        rx->state = KM_RX_ON;                                             // Continue to receive block
+      } else if(rxByte == KM_ETX) {                                       // This should be ETX now, then we are done, just waiting for BCC
+        rx->state = KM_RX_BCC;
+      } else {
+        rx->state = KM_RX_RESYNC;                                         // Something wrong, just try to restart
+        return KM271_RX_RESYNC;
+      }
+      break;
+    case KM_RX_BCC:                                                       // Last stage, "received BCC" ^ "calculated BCC" shall be 0
+      rx->state = KM_RX_IDLE;                                             // Wait for next data or re-sent block
+      return rx->bcc ? KM271_RX_BCC_ERR : KM271_RX_BLOCK;
+  }
+  return KM271_RX_NONE;
+}
+
+// ==================================================================================================
+// Setvalue commands - order has to match e_km271_sendCmd
+// The names are the mqtt topics <topic>/setvalue/<name> and the command names of the rules
+// ==================================================================================================
+const s_km271_cmdDef kmCmdDefs[KM271_SENDCMD_CNT] = {
+  {0x07, 0x00, 6,   0,  2, "hk1_betriebsart"},                     // HK1 Betriebsart  0:Nacht | 1:Tag | 2:AUTO
+  {0x07, 0x0E, 6,  30, 90, "hk1_auslegung"},                       // HK1 Auslegung    Auflösung: 1 °C Stellbereich: 30 – 90 °C WE: 75 °C
+  {0x11, 0x00, 2,   0,  8, "hk1_programm"},                        // HK1 Programm     Programmnummer 0..8
+  {0x0C, 0x0E, 2,   0,  2, "ww_betriebsart"},                      // WW Betriebsart   0:Nacht | 1:Tag | 2:AUTO
+  {0x07, 0x00, 3,   9, 31, "sommer_ab"},                           // Sommer ab        9:Winter | 10°-30° | 31:Sommer
+  {0x07, 0x31, 7, -20, 10, "frost_ab"},                            // Frost ab         -20° ... +10°
+  {0x07, 0x15, 4, -20, 10, "aussenhalt_ab"},                       // Aussenhalt ab    -20° ... +10°
+  {0x0C, 0x07, 5,  30, 60, "ww_soll"},                             // WW Soll          30°-60°
+};
+
+/**
+ * *******************************************************************
+ * @brief   Find a register in the register table
+ * @details binary search, the table is sorted by register
+ * @param   reg: KM271 register address
+ * @return  value id or -1 if the register is not part of the table
+ * *******************************************************************/
+int km271FindValueDef(uint16_t reg) {
+  int lo = 0, hi = KM271_VAL_CNT - 1;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if (kmValueDefs[mid].reg == reg) {
+      return mid;
+    } else if (kmValueDefs[mid].reg < reg) {
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return -1;
+}
+
+/**
+ * *******************************************************************
+ * @brief   Find a setvalue command by its name
+ * @param   name: command name (as in the mqtt setvalue topics)
+ * @return  send command or -1 if the name is unknown
+ * *******************************************************************/
+int km271FindCmdDef(const char *name) {
+  for (int i = 0; name && i < KM271_SENDCMD_CNT; i++) {
+    if (strcmp(kmCmdDefs[i].name, name) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * *******************************************************************
+ * @brief   decode a raw byte according to the value type
+ * @param   type: value type
+ * @param   raw: received raw byte
+ * @return  decoded value
+ * *******************************************************************/
+float km271DecodeRaw(e_km271_valueType type, uint8_t raw) {
+  switch (type) {
+    case KM271_VT_TEMP05:  return decode05cTemp(raw);
+    case KM271_VT_TEMPNEG: return decodeNegTemp(raw);
+    default:               return (float)raw;
+  }
+}
+
+/**
+ * *******************************************************************
+ * @brief   Decodes KM271 temperatures with 0.5 C resolution
+ * @details The value is provided in 0.5 steps
+ * @param   data: the receive dat byte
+ * @return  the decoded value as float
+ * *******************************************************************/
+float decode05cTemp(uint8_t data) {
+  return ((float)data) / 2.0f;
+}
+
+
+/**
+ * *******************************************************************
+ * @brief   Decodes KM271 temperatures with negative temperature range
+ * @details Values >128 are negative
+ * @param   data: the receive dat byte
+ * @return  the decoded value as float
+  * ********************************************************************/
+float decodeNegTemp(uint8_t data) {
+  if(data > 128) {
+        return (((float)(256-data)) * -1.0f);
+  } else {
+        return (float)data;
+  }
+}
+
+/**
+ * *******************************************************************
+ * @brief   build the write telegram of a setvalue command
+ * @param   sendCmd: send command
+ * @param   value: parameter, negative values for signed commands
+ * @param   telegram: destination, 8 bytes (NULL: only check the range)
+ * @return  false if the command is unknown or the value out of range
+ * *******************************************************************/
+bool km271CmdTelegram(e_km271_sendCmd sendCmd, int value, uint8_t *telegram) {
+  if (sendCmd < 0 || sendCmd >= KM271_SENDCMD_CNT) {
+    return false;
+  }
+  const s_km271_cmdDef *def = &kmCmdDefs[sendCmd];
+  if (value < def->min || value > def->max) {
+    return false;
+  }
+  if (telegram) {
+    telegram[0] = def->type;
+    telegram[1] = def->offset;
+    memset(&telegram[2], 0x65, 6);                                          // 0x65: unchanged
+    telegram[def->pos] = (uint8_t)value;
+  }
+  return true;
+}
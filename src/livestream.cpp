@@ -0,0 +1,155 @@
+//*****************************************************************************
+// 
+// Title      : optional live value stream for browsers (Server-Sent Events)
+// Remark     : every connection gets a snapshot of all values first and then
+//              only the changes. Each client has its own "changed" flags
+//              instead of a queue, so a slow client just skips intermediate
+//              values and never blocks other clients or the KM271 handling.
+//              if you dont want to use this, you can disable this in config.h
+//*****************************************************************************
+#include <livestream.h>
+#include <WiFi.h>
+#include <lwip/sockets.h>
+
+/* V A R I A B L E S ********************************************************/
+typedef struct {
+  WiFiClient  client;
+  bool        active;                                   // slot in use
+  bool        dirty[KM271_VAL_CNT];                     // value has to be sent to this client
+  char        out[LIVE_OUT_LEN];                        // pending output
+  uint8_t     outLen;                                   // length of pending output
+  uint8_t     outPos;                                   // already sent part of pending output
+  uint32_t    lastSend;                                 // timestamp of last output
+} s_liveClient;
+
+WiFiServer    liveServer(LIVE_PORT);
+s_liveClient  liveClients[LIVE_MAX_CLIENTS];
+
+/**
+ * *******************************************************************
+ * @brief   Basic Setup for the live stream
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void setupLiveStream() {
+  liveServer.begin();
+  liveServer.setNoDelay(true);
+  km271SubscribeAll(liveStreamValueChanged, NULL);
+}
+
+/**
+ * *******************************************************************
+ * @brief   mark a changed value for all connected clients
+ * @details observer of all values of the register mirror
+ * @param   id: value id
+ * @return  none
+ * *******************************************************************/
+void liveStreamValueChanged(e_km271_valueId id, uint8_t raw, float value, void *ctx) {
+  for (int i = 0; i < LIVE_MAX_CLIENTS; i++) {
+    liveClients[i].dirty[id] = true;
+  }
+}
+
+/**
+ * *******************************************************************
+ * @brief   accept a new client and prepare the snapshot
+ * @param   client: new client
+ * @return  none
+ * *******************************************************************/
+void liveAccept(WiFiClient client) {
+  for (int i = 0; i < LIVE_MAX_CLIENTS; i++) {
+    s_liveClient *lc = &liveClients[i];
+    if (!lc->active) {
+      lc->client = client;
+      lc->active = true;
+      for (int j = 0; j < KM271_VAL_CNT; j++) {
+        lc->dirty[j] = true;                            // full snapshot first
+      }
+      lc->outLen = snprintf(lc->out, sizeof(lc->out),
+        "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\n"
+        "Access-Control-Allow-Origin: *\r\nConnection: keep-alive\r\n\r\n");
+      lc->outPos = 0;
+      lc->lastSend = millis();
+      return;
+    }
+  }
+  client.stop();                                        // no free slot
+}
+
+/**
+ * *******************************************************************
+ * @brief   send pending output without blocking
+ * @param   lc: client
+ * @return  true if the whole output was sent
+ * *******************************************************************/
+bool liveSendPending(s_liveClient *lc) {
+  while (lc->outPos < lc->outLen) {
+    int res = send(lc->client.fd(), lc->out + lc->outPos, lc->outLen - lc->outPos, MSG_DONTWAIT);
+    if (res < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        lc->client.stop();                              // connection lost
+        lc->active = false;
+      }
+      return false;                                     // socket full, try again later
+    }
+    lc->outPos += res;
+    lc->lastSend = millis();
+  }
+  lc->outLen = lc->outPos = 0;
+  return true;
+}
+
+/**
+ * *******************************************************************
+ * @brief   prepare the next event of a client
+ * @param   lc: client
+ * @return  false if there is nothing to send
+ * *******************************************************************/
+bool liveNextEvent(s_liveClient *lc) {
+  uint8_t raw;
+  for (int i = 0; i < KM271_VAL_CNT; i++) {
+    if (lc->dirty[i]) {
+      lc->dirty[i] = false;
+      if (km271GetValue((e_km271_valueId)i, &raw)) {    // always the latest value
+        lc->outLen = snprintf(lc->out, sizeof(lc->out), "event: value\ndata: {\"id\":%d,\"name\":\"%s\",\"value\":%g}\n\n",
+          i, km271GetValueDef((e_km271_valueId)i)->name, km271DecodeValue((e_km271_valueId)i, raw));
+        lc->outPos = 0;
+        return true;
+      }
+    }
+  }
+  if ((millis() - lc->lastSend) > LIVE_KEEPALIVE) {
+    lc->outLen = snprintf(lc->out, sizeof(lc->out), ": keepalive\n\n");
+    lc->outPos = 0;
+    return true;
+  }
+  return false;
+}
+
+/**
+ * *******************************************************************
+ * @brief   Cyclic function for the live stream
+ * @details every client gets at most LIVE_EVENTS_CYCLE events per call
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void cyclicLiveStream() {
+  if (liveServer.hasClient()) {
+    liveAccept(liveServer.available());
+  }
+  for (int i = 0; i < LIVE_MAX_CLIENTS; i++) {
+    s_liveClient *lc = &liveClients[i];
+    if (!lc->active) continue;
+    if (!lc->client.connected()) {
+      lc->client.stop();
+      lc->active = false;
+      continue;
+    }
+    while (lc->client.available()) {
+      lc->client.read();                                // request header is not needed
+    }
+    for (int n = 0; n < LIVE_EVENTS_CYCLE && lc->active; n++) {
+      if (!liveSendPending(lc) || !liveNextEvent(lc)) break;
+    }
+  }
+}
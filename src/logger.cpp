@@ -0,0 +1,186 @@
+//*****************************************************************************
+// 
+// Title      : asynchronous ring buffer logger
+// Remark     : log calls only store a small binary record (time, level, format
+//              pointer, integer arguments, one copied string) in a ring. The
+//              formatting and the slow output to Serial and to a tcp log client
+//              is done by a low priority task. Records up to LOG_MQTT_LEVEL are
+//              published on <topic>/log from the loop task, because the mqtt
+//              client must not be used from another task.
+//              If the ring is full, the oldest records are overwritten.
+//*****************************************************************************
+#include <logger.h>
+#include <mqtt.h>
+#include <WiFi.h>
+#include <lwip/sockets.h>
+
+/* V A R I A B L E S ********************************************************/
+typedef struct {
+  uint32_t    time;                                     // millis() of the log call
+  const char *fmt;                                      // format string constant
+  uint32_t    args[3];                                  // integer arguments
+  uint8_t     level;                                    // log level
+  bool        hasStr;                                   // str is the first argument of fmt
+  char        str[LOG_STR_LEN];                         // copied string argument
+} s_logRecord;
+
+uint8_t       logLevel = LOG_MAX_LEVEL;                 // actual runtime level
+s_logRecord   logRing[LOG_RING_LEN];
+uint32_t      logWritePos = 0;                          // absolute write position
+uint32_t      logTaskPos = 0;                           // read position of the drain task (Serial, tcp)
+uint32_t      logMqttPos = 0;                           // read position of the mqtt output
+uint32_t      logLost = 0;                              // records overwritten before output
+portMUX_TYPE  logMux = portMUX_INITIALIZER_UNLOCKED;
+TaskHandle_t  logTask = NULL;
+WiFiServer    logServer(LOG_PORT);
+WiFiClient    logClient;
+const char   *logLevelNames[] = {"-", "E", "W", "I", "D"};
+
+/**
+ * *******************************************************************
+ * @brief   store a log record in the ring
+ * @details use the LOG_x macros instead, they check the level first
+ * @param   level: log level
+ * @param   str: string that is copied as first argument of fmt, or NULL
+ * @param   fmt: format string constant
+ * @param   a0..a2: integer arguments
+ * @return  none
+ * *******************************************************************/
+void logWrite(uint8_t level, const char *str, const char *fmt, uint32_t a0, uint32_t a1, uint32_t a2) {
+  portENTER_CRITICAL(&logMux);
+  s_logRecord *rec = &logRing[logWritePos % LOG_RING_LEN];
+  rec->time = millis();
+  rec->fmt = fmt;
+  rec->args[0] = a0;
+  rec->args[1] = a1;
+  rec->args[2] = a2;
+  rec->level = level;
+  rec->hasStr = (str != NULL);
+  if (str) {
+    strncpy(rec->str, str, LOG_STR_LEN - 1);
+    rec->str[LOG_STR_LEN - 1] = 0;
+  }
+  logWritePos++;
+  portEXIT_CRITICAL(&logMux);
+  if (logTask) {
+    xTaskNotifyGive(logTask);                           // wake up the drain task
+  }
+}
+
+/**
+ * *******************************************************************
+ * @brief   take the next record of a reader and format it
+ * @details records above maxLevel are skipped without formatting
+ * @param   pos: read position of the reader
+ * @param   maxLevel: highest level the reader is interested in
+ * @param   line: output buffer, LOG_LINE_LEN
+ * @return  false if there is no record
+ * *******************************************************************/
+bool logNextLine(uint32_t *pos, uint8_t maxLevel, char *line) {
+  s_logRecord rec;
+  do {
+    portENTER_CRITICAL(&logMux);
+    if (*pos == logWritePos) {
+      portEXIT_CRITICAL(&logMux);
+      return false;
+    }
+    if (logWritePos - *pos > LOG_RING_LEN) {            // reader too slow, records are overwritten
+      logLost += logWritePos - *pos - LOG_RING_LEN;
+      *pos = logWritePos - LOG_RING_LEN;
+    }
+    rec = logRing[*pos % LOG_RING_LEN];
+    (*pos)++;
+    portEXIT_CRITICAL(&logMux);
+  } while (rec.level > maxLevel);
+
+  int len = snprintf(line, LOG_LINE_LEN, "%lu.%03lu %s ", (unsigned long)(rec.time / 1000), (unsigned long)(rec.time % 1000), logLevelNames[rec.level]);
+  if (rec.hasStr) {
+    snprintf(line + len, LOG_LINE_LEN - len, rec.fmt, rec.str, rec.args[0], rec.args[1], rec.args[2]);
+  } else {
+    snprintf(line + len, LOG_LINE_LEN - len, rec.fmt, rec.args[0], rec.args[1], rec.args[2]);
+  }
+  return true;
+}
+
+/**
+ * *******************************************************************
+ * @brief   write all pending records to Serial and the tcp log client
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void logDrain() {
+  char line[LOG_LINE_LEN];
+  while (logNextLine(&logTaskPos, LOG_LVL_DEBUG, line)) {
+    Serial.println(line);
+    if (logClient.connected()) {
+      strncat(line, "\r\n", LOG_LINE_LEN - strlen(line) - 1);
+      send(logClient.fd(), line, strlen(line), MSG_DONTWAIT);   // a slow log client just misses lines
+    }
+  }
+}
+
+/**
+ * *******************************************************************
+ * @brief   drain task: waits for new records and writes them out
+ * @param   param: unused
+ * @return  none
+ * *******************************************************************/
+void logTaskFunc(void *param) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(500));
+    if (WiFi.status() == WL_CONNECTED && logServer.hasClient()) {
+      logClient.stop();
+      logClient = logServer.available();                // newest client replaces the old one
+    }
+    logDrain();
+  }
+}
+
+/**
+ * *******************************************************************
+ * @brief   Basic Setup for the logger
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void setupLogger() {
+  logServer.begin();
+  xTaskCreate(logTaskFunc, "logger", LOG_TASK_STACK, NULL, LOG_TASK_PRIO, &logTask);
+}
+
+/**
+ * *******************************************************************
+ * @brief   set the runtime log level
+ * @details levels above LOG_MAX_LEVEL are not compiled in
+ * @param   level: LOG_LVL_NONE .. LOG_LVL_DEBUG
+ * @return  none
+ * *******************************************************************/
+void logSetLevel(uint8_t level) {
+  logLevel = (level > LOG_MAX_LEVEL) ? LOG_MAX_LEVEL : level;
+}
+
+/**
+ * *******************************************************************
+ * @brief   wait until all pending records are written, e.g. before a restart
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void logFlush() {
+  for (int i = 0; i < 50 && logTaskPos != logWritePos; i++) {
+    delay(10);                                          // give the drain task time to write out
+  }
+  Serial.flush();
+}
+
+/**
+ * *******************************************************************
+ * @brief   Cyclic function for the logger
+ * @details publishes important records via mqtt (loop task only)
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void cyclicLogger() {
+  char line[LOG_LINE_LEN];
+  while (mqttQueueFree() > 0 && logNextLine(&logMqttPos, LOG_MQTT_LEVEL, line)) {
+    mqttPublish(addTopic("/log"), line, false);
+  }
+}
@@ -7,6 +7,42 @@
   #include <oilmeter.h>
 #endif
 
+#ifdef USE_COMPACT_PAYLOAD
+  #include <compact.h>
+#endif
+
+#ifdef USE_INFLUXDB
+  #include <influx.h>
+#endif
+
+#ifdef USE_HTTPSERVER
+  #include <httpserver.h>
+#endif
+
+#ifdef USE_LIVESTREAM
+  #include <livestream.h>
+#endif
+
+#ifdef USE_RAWBRIDGE
+  #include <rawbridge.h>
+#endif
+
+#ifdef USE_MODBUS
+  #include <modbus.h>
+#endif
+
+#ifdef USE_MULTICAST
+  #include <multicast.h>
+#endif
+
+#ifdef USE_HISTORY
+  #include <history.h>
+#endif
+
+#ifdef USE_RULES
+  #include <rules.h>
+#endif
+
 // PIN Assignment
 #define LED_WIFI        21     // LED for WiFi Status
 #define LED_HEARBEAT    22     // LED for heartbeat
@@ -18,6 +54,8 @@
 muTimer mainTimer = muTimer();  // timer for cyclic info
 muTimer heartbeat = muTimer();  // timer for heartbeat signal
 muTimer dstTimer = muTimer();   // timer to check daylight saving time change
+muTimer latencyTimer = muTimer(); // timer for command latency info
+muTimer unknownTimer = muTimer(); // timer for statistics of not decoded registers
 
 bool main_reboot = true;        // reboot flag
 int dst_old;                    // reminder for change of daylight saving time 
@@ -32,6 +70,9 @@ void storeData(){
   #ifdef USE_OILMETER
     cmdStoreOilmeter();
   #endif
+  #ifdef USE_HISTORY
+    historyFlush();
+  #endif
 }
 
 /**
@@ -52,6 +93,9 @@ void setup()
   Serial.begin(115200);
   while(!Serial) {} // Wait
 
+  // asynchronous logger (Serial, tcp, mqtt)
+  setupLogger();
+
   pinMode(LED_WIFI, OUTPUT);        // LED for Wifi-Status
   pinMode(LED_HEARBEAT, OUTPUT);    // LED for heartbeat
   pinMode(LED_LOGMODE, OUTPUT);     // LED for LogMode-Status
@@ -64,6 +108,46 @@ void setup()
     setupOilmeter();
   #endif
 
+  // setup compact payload
+  #ifdef USE_COMPACT_PAYLOAD
+    setupCompact();
+  #endif
+
+  // setup InfluxDB sink
+  #ifdef USE_INFLUXDB
+    setupInflux();
+  #endif
+
+  // setup http server
+  #ifdef USE_HTTPSERVER
+    setupHttpServer();
+  #endif
+
+  // setup live stream
+  #ifdef USE_LIVESTREAM
+    setupLiveStream();
+  #endif
+
+  #ifdef USE_RAWBRIDGE
+    setupRawBridge();
+  #endif
+
+  #ifdef USE_MODBUS
+    setupModbus();
+  #endif
+
+  #ifdef USE_MULTICAST
+    setupMulticast();
+  #endif
+
+  #ifdef USE_HISTORY
+    setupHistory();
+  #endif
+
+  #ifdef USE_RULES
+    setupRules();
+  #endif
+
   // send initial WiFi infos
   sendWiFiInfo();
 
@@ -94,16 +178,89 @@ void loop()
   // cyclic call for KM271
   cyclicKM271();
 
+  // publish important log records
+  cyclicLogger();
+
   // cyclic Oilmeter
   #ifdef USE_OILMETER
     cyclicOilmeter();
   #endif
 
+  // cyclic compact payload
+  #ifdef USE_COMPACT_PAYLOAD
+    cyclicCompact();
+  #endif
+
+  // cyclic InfluxDB sink
+  #ifdef USE_INFLUXDB
+    cyclicInflux();
+  #endif
+
+  // cyclic http server
+  #ifdef USE_HTTPSERVER
+    cyclicHttpServer();
+  #endif
+
+  // cyclic live stream
+  #ifdef USE_LIVESTREAM
+    cyclicLiveStream();
+  #endif
+
+  // cyclic raw byte stream
+  #ifdef USE_RAWBRIDGE
+    cyclicRawBridge();
+  #endif
+
+  // cyclic Modbus TCP server
+  #ifdef USE_MODBUS
+    cyclicModbus();
+  #endif
+
+  // cyclic multicast sink
+  #ifdef USE_MULTICAST
+    cyclicMulticast();
+  #endif
+
+  // cyclic value history
+  #ifdef USE_HISTORY
+    cyclicHistory();
+  #endif
+
+  // cyclic rules
+  #ifdef USE_RULES
+    cyclicRules();
+  #endif
+
   // send cyclic infos
   if (mainTimer.cycleTrigger(10000))
   {
     sendWiFiInfo();
     sendKM271Info();
+    sendMqttInfo();
+    #ifdef USE_RAWBRIDGE
+      sendRawBridgeInfo();
+    #endif
+    #ifdef USE_HISTORY
+      sendHistoryInfo();
+    #endif
+    #ifdef USE_INFLUXDB
+      sendInfluxInfo();
+    #endif
+  }
+
+  // send command latency histograms
+  if (latencyTimer.cycleTrigger(60000))
+  {
+    sendKM271Latency();
+    #ifdef USE_RULES
+      sendRulesInfo();
+    #endif
+  }
+
+  // send statistics of not decoded registers
+  if (unknownTimer.cycleTrigger(300000))
+  {
+    sendKM271Unknown();
   }
 
   // check every hour if DST has changed
@@ -0,0 +1,272 @@
+//*****************************************************************************
+// 
+// Title      : optional Modbus TCP server
+// Remark     : input registers (function 4): address = value id of the register
+//              mirror (e_km271_valueId), temperatures scaled by 10, other
+//              values raw. 0x8000 = not received yet.
+//              holding registers (function 3, 6, 16): address = setvalue
+//              command (e_km271_sendCmd), signed. Writes are checked against
+//              the range of the command (exception 3) and queued as write
+//              telegrams (exception 6 if the send queue is full). Reads
+//              return the value of the config cache (USE_CONFIG_VALUES),
+//              otherwise the last written value.
+//              Requests are handled without blocking, a slow poller only
+//              delays its own answers.
+//              if you dont want to use this, you can disable this in config.h
+//*****************************************************************************
+#include <modbus.h>
+#include <WiFi.h>
+#include <lwip/sockets.h>
+
+/* V A R I A B L E S ********************************************************/
+typedef struct {
+  WiFiClient  client;
+  bool        active;                                   // slot in use
+  uint8_t     in[MB_ADU_LEN];                           // received part of the request
+  uint16_t    inLen;                                    // received bytes
+  uint8_t     out[MB_ADU_LEN];                          // pending response
+  uint16_t    outLen;                                   // length of pending response
+  uint16_t    outPos;                                   // already sent part of pending response
+} s_mbClient;
+
+WiFiServer    mbServer(MB_PORT);
+s_mbClient    mbClients[MB_MAX_CLIENTS];
+uint16_t      mbHolding[KM271_SENDCMD_CNT];             // last written value per setvalue command (without config cache)
+
+/**
+ * *******************************************************************
+ * @brief   Basic Setup for the Modbus TCP server
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void setupModbus() {
+  for (int i = 0; i < KM271_SENDCMD_CNT; i++) {
+    mbHolding[i] = MB_INVALID;
+  }
+  mbServer.begin();
+  mbServer.setNoDelay(true);
+}
+
+/**
+ * *******************************************************************
+ * @brief   get the input register of a value
+ * @param   id: value id = register address
+ * @return  register value
+ * *******************************************************************/
+uint16_t mbInputRegister(e_km271_valueId id) {
+  uint8_t raw;
+  if (!km271GetValue(id, &raw)) {
+    return MB_INVALID;
+  }
+  switch (km271GetValueDef(id)->type) {
+    case KM271_VT_TEMP:
+    case KM271_VT_TEMP05:
+    case KM271_VT_TEMPNEG:
+      return (uint16_t)(int16_t)lroundf(km271DecodeValue(id, raw) * 10);
+    default:
+      return raw;
+  }
+}
+
+/**
+ * *******************************************************************
+ * @brief   get a holding register
+ * @param   addr: register address = setvalue command
+ * @return  register value
+ * *******************************************************************/
+uint16_t mbHoldingRegister(uint16_t addr) {
+#ifdef USE_CONFIG_VALUES
+  int value;
+  return km271GetCmdValue((e_km271_sendCmd)addr, &value) ? (uint16_t)(int16_t)value : MB_INVALID;
+#else
+  return mbHolding[addr];
+#endif
+}
+
+/**
+ * *******************************************************************
+ * @brief   write holding registers
+ * @details all values are checked first, then queued as write telegrams
+ *          - a request is either sent completely or not at all
+ * @param   addr: first register address = setvalue command
+ * @param   qty: number of registers
+ * @param   data: big endian register values
+ * @return  0 or exception code
+ * *******************************************************************/
+uint8_t mbWriteHolding(uint16_t addr, uint16_t qty, const uint8_t *data) {
+  uint8_t telegram[8];
+  for (int i = 0; i < qty; i++) {
+    if (!km271CmdTelegram((e_km271_sendCmd)(addr + i), (int16_t)((data[i*2] << 8) | data[i*2 + 1]), NULL)) {
+      return 3;                                         // illegal data value
+    }
+  }
+  if (km271TxQueueFree() < qty) {
+    return 6;                                           // server device busy
+  }
+  for (int i = 0; i < qty; i++) {
+    uint16_t value = (data[i*2] << 8) | data[i*2 + 1];
+    km271CmdTelegram((e_km271_sendCmd)(addr + i), (int16_t)value, telegram);
+    km271QueueTelegram(telegram);
+    mbHolding[addr + i] = value;
+  }
+  return 0;
+}
+
+/**
+ * *******************************************************************
+ * @brief   prepare an exception response
+ * @param   mc: client
+ * @param   code: exception code
+ * @return  PDU length
+ * *******************************************************************/
+uint16_t mbException(s_mbClient *mc, uint8_t code) {
+  mc->out[7] = mc->in[7] | 0x80;
+  mc->out[8] = code;
+  return 2;
+}
+
+/**
+ * *******************************************************************
+ * @brief   handle a complete request and prepare the response
+ * @param   mc: client
+ * @return  none
+ * *******************************************************************/
+void mbHandleRequest(s_mbClient *mc) {
+  uint8_t  *pdu = &mc->in[7];
+  uint8_t  *res = &mc->out[7];
+  uint16_t  addr = (pdu[1] << 8) | pdu[2];
+  uint16_t  qty = (pdu[3] << 8) | pdu[4];
+  uint16_t  len;
+  uint8_t   code;
+
+  memcpy(mc->out, mc->in, 7);                           // transaction id, protocol id, unit id
+  res[0] = pdu[0];
+  switch (pdu[0]) {
+    case 3:                                             // read holding registers
+    case 4:                                             // read input registers
+      if (qty < 1 || qty > MB_MAX_READ) {
+        len = mbException(mc, 3);
+      } else if (addr + qty > ((pdu[0] == 3) ? (int)KM271_SENDCMD_CNT : (int)KM271_VAL_CNT)) {
+        len = mbException(mc, 2);
+      } else {
+        res[1] = qty * 2;
+        for (int i = 0; i < qty; i++) {
+          uint16_t value = (pdu[0] == 3) ? mbHoldingRegister(addr + i) : mbInputRegister((e_km271_valueId)(addr + i));
+          res[2 + i*2] = value >> 8;
+          res[3 + i*2] = value & 0xFF;
+        }
+        len = 2 + qty * 2;
+      }
+      break;
+    case 6:                                             // write single register
+      if (addr >= KM271_SENDCMD_CNT) {
+        len = mbException(mc, 2);
+      } else if ((code = mbWriteHolding(addr, 1, &pdu[3])) != 0) {
+        len = mbException(mc, code);
+      } else {
+        memcpy(&res[1], &pdu[1], 4);                    // echo address and value
+        len = 5;
+      }
+      break;
+    case 16:                                            // write multiple registers
+      if (qty < 1 || qty > 123 || pdu[5] != qty * 2 || mc->inLen != 13 + qty * 2) {
+        len = mbException(mc, 3);
+      } else if (addr + qty > KM271_SENDCMD_CNT) {
+        len = mbException(mc, 2);
+      } else if ((code = mbWriteHolding(addr, qty, &pdu[6])) != 0) {
+        len = mbException(mc, code);
+      } else {
+        memcpy(&res[1], &pdu[1], 4);                    // address and quantity
+        len = 5;
+      }
+      break;
+    default:
+      len = mbException(mc, 1);                         // illegal function
+      break;
+  }
+  mc->out[4] = (len + 1) >> 8;                          // length: unit id + PDU
+  mc->out[5] = (len + 1) & 0xFF;
+  mc->outLen = 7 + len;
+  mc->outPos = 0;
+}
+
+/**
+ * *******************************************************************
+ * @brief   send pending response without blocking
+ * @param   mc: client
+ * @return  true if the whole response was sent
+ * *******************************************************************/
+bool mbSendPending(s_mbClient *mc) {
+  while (mc->outPos < mc->outLen) {
+    int res = send(mc->client.fd(), mc->out + mc->outPos, mc->outLen - mc->outPos, MSG_DONTWAIT);
+    if (res < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        mc->client.stop();                              // connection lost
+        mc->active = false;
+      }
+      return false;                                     // socket full, try again later
+    }
+    mc->outPos += res;
+  }
+  mc->outLen = mc->outPos = 0;
+  return true;
+}
+
+/**
+ * *******************************************************************
+ * @brief   receive request bytes of a client
+ * @details a new request is only read after the last response was sent
+ * @param   mc: client
+ * @return  none
+ * *******************************************************************/
+void mbReceive(s_mbClient *mc) {
+  while (mc->client.available() && mc->outLen == 0) {
+    mc->in[mc->inLen++] = mc->client.read();
+    if (mc->inLen < 7) continue;                        // MBAP header not complete
+    uint16_t frameLen = 6 + ((mc->in[4] << 8) | mc->in[5]);
+    if (mc->in[2] != 0 || mc->in[3] != 0 || frameLen < 12 || frameLen > MB_ADU_LEN) {
+      mc->client.stop();                                // no Modbus TCP
+      mc->active = false;
+      return;
+    }
+    if (mc->inLen == frameLen) {
+      mbHandleRequest(mc);
+      mc->inLen = 0;
+      mbSendPending(mc);
+    }
+  }
+}
+
+/**
+ * *******************************************************************
+ * @brief   Cyclic function for the Modbus TCP server
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void cyclicModbus() {
+  if (mbServer.hasClient()) {
+    WiFiClient client = mbServer.available();
+    int i;
+    for (i = 0; i < MB_MAX_CLIENTS && mbClients[i].active; i++);
+    if (i < MB_MAX_CLIENTS) {
+      mbClients[i].client = client;
+      mbClients[i].active = true;
+      mbClients[i].inLen = 0;
+      mbClients[i].outLen = mbClients[i].outPos = 0;
+    } else {
+      client.stop();                                    // no free slot
+    }
+  }
+  for (int i = 0; i < MB_MAX_CLIENTS; i++) {
+    s_mbClient *mc = &mbClients[i];
+    if (!mc->active) continue;
+    if (!mc->client.connected()) {
+      mc->client.stop();
+      mc->active = false;
+      continue;
+    }
+    if (mbSendPending(mc) && mc->active) {
+      mbReceive(mc);
+    }
+  }
+}
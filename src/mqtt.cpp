@@ -3,6 +3,15 @@
 #include <km271.h>
 #include <WiFi.h>
 #include <oilmeter.h>
+#include <algorithm>
+
+#ifdef USE_COMPACT_PAYLOAD
+  #include <compact.h>
+#endif
+
+#ifdef USE_RULES
+  #include <rules.h>
+#endif
 
 // ======================================================
 // declaration
@@ -10,6 +19,70 @@
 WiFiClient espClient;
 PubSubClient mqtt_client(espClient);
 
+#define MQTT_STREAM_CHUNK   64    // chunk size for streamed JSON payloads
+
+#define MQTT_QUEUE_SIZE     32    // number of slots of the outgoing queue
+#define MQTT_QUEUE_SLOT     136   // topic and payload of a short message, longer messages use several slots
+#define MQTT_QUEUE_MAX_SLOTS 8    // max slots of one message, longer messages are refused
+#define MQTT_SEND_WINDOW    8     // max messages handed to the socket per mqttCyclic() call
+#define MQTT_SEND_RETRIES   20    // the first queued message is dropped after this many failed publish attempts
+#define MQTT_PACKET_HEADER  7     // PubSubClient: max. fixed header (5) + topic length (2) of a publish packet
+#define MQTT_QUEUE_HIGH     24    // high-water mark: above this, low priority messages are shed
+
+#define MQTT_PING_TIME      30000 // interval of the broker round-trip self-ping
+#define MQTT_RTT_SAMPLES    100   // number of round-trip samples kept for statistics
+#ifdef USE_RULES
+  #define MQTT_RX_BUFFER    (RULES_JSON_LEN + 128)  // client buffer: a rule set as large as the parser memory, topic and header
+#else
+  #define MQTT_RX_BUFFER    2048  // client buffer, must hold the largest incoming message (config restore)
+#endif
+
+// outgoing message queue, filled by mqttPublish() and drained by mqttCyclic()
+typedef struct {
+  uint8_t   slots;                          // slots used by the message, 0 = unused slot at the end of the queue
+  boolean   retained;
+  uint8_t   topicClass;
+} s_mqtt_msg;
+
+s_mqtt_msg  mqttQueue[MQTT_QUEUE_SIZE];
+char        mqttQueueData[MQTT_QUEUE_SIZE * MQTT_QUEUE_SLOT];  // per slot "topic\0payload\0", continued in the following slots
+uint8_t     mqttQueueHead = 0;              // next slot to send
+uint8_t     mqttQueueCount = 0;             // number of used slots
+bool        mqttSendFailed = false;         // last publish attempt was refused by the socket
+uint8_t     mqttHeadFails = 0;              // failed publish attempts of the first queued message
+
+s_mqttStats mqttStats[MQTT_CLASS_CNT];      // publish statistics per topic class
+const char *mqttClassNames[MQTT_CLASS_CNT] = {"status", "message", "config", "other"};
+
+muTimer     mqttPingTimer = muTimer();      // timer for broker round-trip self-ping
+uint32_t    mqttPingStamp = 0;              // timestamp of the outstanding ping, 0 = none
+uint16_t    mqttRttSamples[MQTT_RTT_SAMPLES];
+uint16_t    mqttRttCount = 0;               // number of valid samples
+uint16_t    mqttRttIdx = 0;                 // next sample to overwrite
+
+/**
+ * *******************************************************************
+ * @brief   small Print adapter that collects serialized bytes in chunks
+ * @details PubSubClient forwards every single write() directly to the
+ *          TCP socket, so the JSON serializer output is gathered here
+ *          and handed over in blocks of MQTT_STREAM_CHUNK bytes.
+ * *******************************************************************/
+class MqttChunkPrint : public Print {
+  public:
+    size_t write(uint8_t c) override {
+      buf[len++] = c;
+      if (len == sizeof(buf)) flush();
+      return 1;
+    }
+    void flush() override {
+      if (len) mqtt_client.write(buf, len);
+      len = 0;
+    }
+  private:
+    uint8_t buf[MQTT_STREAM_CHUNK];
+    size_t  len = 0;
+};
+
 
 /**
  * *******************************************************************
@@ -33,11 +106,18 @@ const char * addTopic(const char *suffix){
  * *******************************************************************/
 void mqttCallback(char* topic, byte* payload, unsigned int length) {
   payload[length] = '\0';
+
+  // answer of the round-trip self-ping - handle first to keep the measurement clean
+  if (strcmp (topic, addTopic("/ping")) == 0){
+    mqttPingReceived((char*)payload);
+    return;
+  }
+  km271CmdMarkReceived(true);                             // start of command latency measurement
   String payloadString = String((char*)payload);
   long intVal = payloadString.toInt();
+  int sendCmd;
 
-  Serial.print("topic: ");
-  Serial.println(topic);
+  LOG_D_S("mqtt rx: %s", topic);
 
   // ESP restarten auf Kommando
   if (strcmp (topic, addTopic("/cmd/restart")) == 0){
@@ -47,51 +127,128 @@ void mqttCallback(char* topic, byte* payload, unsigned int length) {
   }
   // set date and time
   else if (strcmp (topic, addTopic("/cmd/setdatetime")) == 0){
-    Serial.println("cmd set date time");
-    mqtt_client.publish(addTopic("/message"), "cmd datetime requested!");
+    LOG_I("cmd set date time");
+    mqttPublish(addTopic("/message"), "cmd datetime requested!", false);
     km271SetDateTime();
   }
+  // sampled trace of one register
+  else if (strcmp (topic, addTopic("/cmd/trace")) == 0){
+    km271SetTrace(payloadString.c_str());
+  }
+  // runtime log level
+  else if (strcmp (topic, addTopic("/cmd/loglevel")) == 0){
+    logSetLevel(intVal);
+  }
+  // values changed since generation, payload "epoch:generation"
+  else if (strcmp (topic, addTopic("/cmd/sync")) == 0){
+    char *sep;
+    uint32_t epoch = strtoul(payloadString.c_str(), &sep, 10);
+    uint32_t since = (*sep == ':') ? strtoul(sep + 1, NULL, 10) : 0;       // without epoch: all values
+    sendKM271Changes(epoch, since);
+  }
   // set oilmeter
   else if (strcmp (topic, addTopic("/setvalue/oilcounter")) == 0){
-    Serial.println("cmd setvalue oilcounter");
+    LOG_I("cmd setvalue oilcounter: %ld", intVal);
     cmdSetOilmeter(intVal);
   }
-  // HK1 Betriebsart
-  else if (strcmp (topic, addTopic("/setvalue/hk1_betriebsart")) == 0){  
-    km271sendCmd(KM271_SENDCMD_HK1_BA, intVal);
+  // setvalue commands, topic names from the command table
+  else if (strncmp (topic + strlen(MQTT_TOPIC), "/setvalue/", 10) == 0 && (sendCmd = km271FindCmdDef(topic + strlen(MQTT_TOPIC) + 10)) >= 0){
+    km271sendCmd((e_km271_sendCmd)sendCmd, intVal);
   }
-  // HK1 Programm
-  else if (strcmp (topic, addTopic("/setvalue/hk1_programm")) == 0){  
-    km271sendCmd(KM271_SENDCMD_HK1_PROGRAMM, intVal);
+  #ifdef USE_CONFIG_VALUES
+  // config backup / restore
+  else if (strcmp (topic, addTopic("/cmd/backup")) == 0){
+    sendKM271ConfigBackup();
   }
-  // HK1 Auslegung
-  else if (strcmp (topic, addTopic("/setvalue/hk1_auslegung")) == 0){  
-    km271sendCmd(KM271_SENDCMD_HK1_AUSLEGUNG, intVal);
+  else if (strcmp (topic, addTopic("/cmd/restore")) == 0){
+    km271RestoreConfig(payloadString.c_str());
   }
-  // WW Betriebsart
-  else if (strcmp (topic, addTopic("/setvalue/ww_betriebsart")) == 0){
-    km271sendCmd(KM271_SENDCMD_WW_BA, intVal);
+  // HK1/HK2 Schaltzeiten eines Tages
+  else if (strncmp (topic + strlen(MQTT_TOPIC), "/setvalue/hc1_program/", 22) == 0){
+    km271SetProgramDay(0, topic + strlen(MQTT_TOPIC) + 22, payloadString.c_str());
   }
-  // Sommer-Ab Temperatur
-  else if (strcmp (topic, addTopic("/setvalue/sommer_ab")) == 0){
-    km271sendCmd(KM271_SENDCMD_SOMMER_AB, intVal);
-  }  
-  // Frost-Ab Temperatur
-  else if (strcmp (topic, addTopic("/setvalue/frost_ab")) == 0){
-    km271sendCmd(KM271_SENDCMD_FROST_AB, intVal);
-  } 
-  // Aussenhalt-Ab Temperatur
-  else if (strcmp (topic, addTopic("/setvalue/aussenhalt_ab")) == 0){
-    km271sendCmd(KM271_SENDCMD_AUSSENHALT, intVal);
-  } 
-  // WW-Temperatur
-  else if (strcmp (topic, addTopic("/setvalue/ww_soll")) == 0){
-    km271sendCmd(KM271_SENDCMD_WW_SOLL, intVal);
-  } 
+  #ifdef USE_HC2
+  else if (strncmp (topic + strlen(MQTT_TOPIC), "/setvalue/hc2_program/", 22) == 0){
+    km271SetProgramDay(1, topic + strlen(MQTT_TOPIC) + 22, payloadString.c_str());
+  }
+  #endif
+  #endif
+  #ifdef USE_RULES
+  // on-device rules
+  else if (strcmp (topic, addTopic("/cmd/rules")) == 0){
+    if (rulesLoad(payloadString.c_str(), true)) {
+      mqttPublish(addTopic("/message"), "rules loaded", false);
+    } else {
+      mqttPublish(addTopic("/message"), "rules invalid - not loaded", false);
+    }
+  }
+  #endif
 
+  km271CmdMarkReceived(false);
 }
 
 
+/**
+ * *******************************************************************
+ * @brief   send a cyclic self-ping to measure the broker round-trip time
+ * @details the actual timestamp is published to a topic the device has
+ *          subscribed to itself. The time until it arrives back in
+ *          mqttCallback() covers WiFi and broker, but not the KM271 bus.
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void mqttPing(){
+  if (mqttPingTimer.cycleTrigger(MQTT_PING_TIME) && mqtt_client.connected()) {
+    char stamp[12];
+    mqttPingStamp = millis() | 1;                         // never 0, 0 means no ping outstanding
+    snprintf(stamp, sizeof(stamp), "%lu", (unsigned long)mqttPingStamp);
+    if (!mqtt_client.publish(addTopic("/ping"), stamp, false)) {
+      mqttPingStamp = 0;
+    }
+  }
+}
+
+/**
+ * *******************************************************************
+ * @brief   store the round-trip time of a received self-ping
+ * @param   payload: received payload (timestamp of the ping)
+ * @return  none
+ * *******************************************************************/
+void mqttPingReceived(const char* payload){
+  uint32_t stamp = strtoul(payload, NULL, 10);
+  if (mqttPingStamp == 0 || stamp != mqttPingStamp) {
+    return;                                               // not our outstanding ping
+  }
+  uint32_t rtt = millis() - stamp;
+  mqttRttSamples[mqttRttIdx] = rtt > 0xFFFF ? 0xFFFF : rtt;
+  mqttRttIdx = (mqttRttIdx + 1) % MQTT_RTT_SAMPLES;
+  if (mqttRttCount < MQTT_RTT_SAMPLES) mqttRttCount++;
+  mqttPingStamp = 0;
+}
+
+/**
+ * *******************************************************************
+ * @brief   get min/avg/p99 of the broker round-trip time
+ * @param   pRtt: destination for the statistics
+ * @return  none
+ * *******************************************************************/
+void mqttGetRtt(s_mqttRtt *pRtt){
+  uint16_t sorted[MQTT_RTT_SAMPLES];
+  uint32_t sum = 0;
+
+  memset(pRtt, 0, sizeof(s_mqttRtt));
+  if (!mqttRttCount) return;
+  memcpy(sorted, mqttRttSamples, mqttRttCount * sizeof(uint16_t));
+  std::sort(sorted, sorted + mqttRttCount);
+  for (int i = 0; i < mqttRttCount; i++) {
+    sum += sorted[i];
+  }
+  pRtt->samples = mqttRttCount;
+  pRtt->min = sorted[0];
+  pRtt->avg = sum / mqttRttCount;
+  pRtt->p99 = sorted[(mqttRttCount * 99 - 1) / 100];
+}
+
 /**
  * *******************************************************************
  * @brief   Check MQTT connection and automatic reconnect
@@ -100,6 +257,8 @@ void mqttCallback(char* topic, byte* payload, unsigned int length) {
  * *******************************************************************/
 void mqttCyclic(){
     mqtt_client.loop();
+    mqttSendQueue();
+    mqttPing();
     
     const char* willTopic = addTopic("/status");
     const char* willMsg = "offline";
@@ -109,24 +268,27 @@ void mqttCyclic(){
     if (!mqtt_client.connected() && (WiFi.status() == WL_CONNECTED)) {
         while (!mqtt_client.connected() && mqtt_retry < 5 && WiFi.status() == WL_CONNECTED) {
             mqtt_retry++;
-            Serial.println("MQTT not connected, reconnect...");
+            LOG_W("MQTT not connected, reconnect...");
             res = mqtt_client.connect(HOSTNAME, MQTT_USER, MQTT_PW, willTopic, 0, 1, willMsg);
             if (!res) {
-                Serial.print("failed, rc=");
-                Serial.print(mqtt_client.state());
-                Serial.println(", retrying");
+                LOG_W("MQTT connect failed, rc=%d, retrying", mqtt_client.state());
                 delay(MQTT_RECONNECT);
             } else {
-                Serial.println("MQTT connected");
+                LOG_I("MQTT connected");
                 // Once connected, publish an announcement...
                 sendWiFiInfo();
+                #ifdef USE_COMPACT_PAYLOAD
+                  sendCompactSchema();
+                #endif
                 // ... and resubscribe
                 mqtt_client.subscribe(addTopic("/cmd/#"));
                 mqtt_client.subscribe(addTopic("/setvalue/#"));
+                mqtt_client.subscribe(addTopic("/ping"));
             }          
         }
         if(mqtt_retry >= 5){
-          Serial.print("MQTT connection not possible, rebooting...");
+          LOG_E("MQTT connection not possible, rebooting...");
+          logFlush();
           storeData(); // store Data before reboot
           delay(500);
           ESP.restart();
@@ -143,16 +305,263 @@ void mqttCyclic(){
 void mqttSetup(){
   mqtt_client.setServer(MQTT_SERVER, 1883);
   mqtt_client.setCallback(mqttCallback);
+  #if defined(USE_CONFIG_VALUES) || defined(USE_RULES)
+  mqtt_client.setBufferSize(MQTT_RX_BUFFER);              // incoming config restore and rules are larger than the default 256 bytes
+  #endif
 }
 
 
+/**
+ * *******************************************************************
+ * @brief   get the topic class of a topic for statistics and shedding
+ * @param   sendtopic: full topic
+ * @return  topic class
+ * *******************************************************************/
+e_mqttTopicClass mqttTopicClass(const char* sendtopic){
+  const char *suffix = sendtopic + strlen(MQTT_TOPIC);
+  if (strncmp(sendtopic, MQTT_TOPIC, strlen(MQTT_TOPIC)) != 0) {
+    return MQTT_CLASS_OTHER;
+  } else if (strncmp(suffix, "/status/", 8) == 0) {
+    return MQTT_CLASS_STATUS;
+  } else if (strcmp(suffix, "/message") == 0) {
+    return MQTT_CLASS_MESSAGE;
+  } else if (strncmp(suffix, "/config/", 8) == 0) {
+    return MQTT_CLASS_CONFIG;
+  }
+  return MQTT_CLASS_OTHER;
+}
+
+/**
+ * *******************************************************************
+ * @brief   publish a message directly and update statistics
+ * @param   sendtopic: topic to publish
+ * @param   payload: payload to publish
+ * @param   retained: retained flag
+ * @param   topicClass: topic class for statistics
+ * @return  true if the message was sent
+ * *******************************************************************/
+bool mqttPublishDirect(const char* sendtopic, const char* payload, boolean retained, uint8_t topicClass){
+  bool res = mqtt_client.publish(sendtopic, payload, retained);
+  if (res) {
+    mqttStats[topicClass].sent++;
+    mqttStats[topicClass].bytes += strlen(payload);
+  } else {
+    mqttStats[topicClass].failed++;
+  }
+  mqttSendFailed = !res;
+  return res;
+}
+
 /**
  * *******************************************************************
  * @brief   MQTT Publish function for external use
+ * @details the message is copied into the outgoing queue and sent
+ *          later by mqttCyclic(), so the KM271 protocol handling does
+ *          not wait for the socket. publish() itself is still blocking,
+ *          it is only moved to mqttCyclic() in the same loop.
+ *          A message longer than one slot uses several consecutive
+ *          slots, so all messages are sent in the order of the calls.
+ *          The slots of a message never wrap around the end of the queue,
+ *          unused slots at the end are skipped.
+ * @param   sendtopic: topic to publish
+ * @param   payload: payload to publish
+ * @param   retained: retained flag
+ * @return  false if the message was dropped because the queue is full or it is too long
+ * *******************************************************************/
+bool mqttPublish(const char* sendtopic, const char* payload, boolean retained){
+  e_mqttTopicClass topicClass = mqttTopicClass(sendtopic);
+  size_t topicLen = strlen(sendtopic) + 1;
+  size_t len = topicLen + strlen(payload) + 1;
+  size_t slots = (len + MQTT_QUEUE_SLOT - 1) / MQTT_QUEUE_SLOT;
+  if (slots > MQTT_QUEUE_MAX_SLOTS || MQTT_PACKET_HEADER + len - 2 > mqtt_client.getBufferSize()) {   // publish() would always fail
+    mqttStats[topicClass].failed++;
+    LOG_W_S("mqtt: message too long: %s", sendtopic);
+    return false;
+  }
+  e_mqttBackpressure bp = mqttGetBackpressure();
+  if (bp == MQTT_BP_FULL || (bp == MQTT_BP_HIGH && topicClass >= MQTT_CLASS_CONFIG)) {
+    mqttStats[topicClass].dropped++;                      // backpressure: shed message
+    return false;
+  }
+  if (!mqttQueueCount) {
+    mqttQueueHead = 0;                                    // empty queue: start at the first slot
+  }
+  uint8_t tail = (mqttQueueHead + mqttQueueCount) % MQTT_QUEUE_SIZE;
+  uint8_t skip = (tail + slots > MQTT_QUEUE_SIZE) ? MQTT_QUEUE_SIZE - tail : 0;
+  if (mqttQueueCount + skip + slots > MQTT_QUEUE_SIZE) {
+    mqttStats[topicClass].dropped++;                      // not enough free slots
+    return false;
+  }
+  for (; skip; skip--) {                                  // message does not fit before the end of the queue
+    mqttQueue[tail].slots = 0;
+    tail = (tail + 1) % MQTT_QUEUE_SIZE;
+    mqttQueueCount++;
+  }
+  s_mqtt_msg *msg = &mqttQueue[tail];
+  char *data = &mqttQueueData[tail * MQTT_QUEUE_SLOT];
+  memcpy(data, sendtopic, topicLen);
+  strcpy(data + topicLen, payload);
+  msg->slots = slots;
+  msg->retained = retained;
+  msg->topicClass = topicClass;
+  mqttQueueCount += slots;
+  return true;
+}
+
+/**
+ * *******************************************************************
+ * @brief   send queued messages to the broker
+ * @details at most MQTT_SEND_WINDOW messages are sent per call. If the
+ *          socket does not accept a message, it stays in the queue and
+ *          will be retried with the next call. After MQTT_SEND_RETRIES
+ *          failed attempts it is dropped, so one message can not stall
+ *          the queue.
  * @param   none
  * @return  none
  * *******************************************************************/
-void mqttPublish(const char* sendtopic, const char* payload, boolean retained){
-  mqtt_client.publish(sendtopic, payload, retained);
+void mqttSendQueue(){
+  uint8_t sent = 0;
+  while (mqttQueueCount && sent < MQTT_SEND_WINDOW && mqtt_client.connected()) {
+    s_mqtt_msg *msg = &mqttQueue[mqttQueueHead];
+    if (!msg->slots) {                                    // unused slot at the end of the queue
+      mqttQueueHead = (mqttQueueHead + 1) % MQTT_QUEUE_SIZE;
+      mqttQueueCount--;
+      continue;
+    }
+    const char *topic = &mqttQueueData[mqttQueueHead * MQTT_QUEUE_SLOT];
+    if (!mqttPublishDirect(topic, topic + strlen(topic) + 1, msg->retained, msg->topicClass)) {
+      if (++mqttHeadFails < MQTT_SEND_RETRIES) {
+        break;                                            // socket busy, try again later
+      }
+      mqttStats[msg->topicClass].dropped++;
+      LOG_W_S("mqtt: message dropped after failed retries: %s", topic);
+    }
+    mqttHeadFails = 0;
+    mqttQueueHead = (mqttQueueHead + msg->slots) % MQTT_QUEUE_SIZE;
+    mqttQueueCount -= msg->slots;
+    sent++;
+  }
+}
+
+/**
+ * *******************************************************************
+ * @brief   number of free slots in the outgoing queue
+ * @details can be used by producers to reduce the amount of messages
+ * @param   none
+ * @return  free queue slots
+ * *******************************************************************/
+uint8_t mqttQueueFree(){
+  return MQTT_QUEUE_SIZE - mqttQueueCount;
+}
+
+/**
+ * *******************************************************************
+ * @brief   actual backpressure state of the outgoing queue
+ * @details producers should skip low priority messages (config values,
+ *          debug information) as long as the state is not MQTT_BP_NONE
+ * @param   none
+ * @return  backpressure state
+ * *******************************************************************/
+e_mqttBackpressure mqttGetBackpressure(){
+  if (mqttQueueCount >= MQTT_QUEUE_SIZE) {
+    return MQTT_BP_FULL;
+  } else if (mqttQueueCount >= MQTT_QUEUE_HIGH || mqttSendFailed) {
+    return MQTT_BP_HIGH;
+  }
+  return MQTT_BP_NONE;
 }
 
+/**
+ * *******************************************************************
+ * @brief   count a message that was not even created by the producer
+ *          because of backpressure
+ * @param   topicClass: topic class of the skipped message
+ * @return  none
+ * *******************************************************************/
+void mqttStatShed(e_mqttTopicClass topicClass){
+  mqttStats[topicClass].dropped++;
+}
+
+/**
+ * *******************************************************************
+ * @brief   get the publish statistics of a topic class
+ * @param   topicClass: topic class
+ * @param   pStats: destination for the statistics
+ * @return  name of the topic class
+ * *******************************************************************/
+const char *mqttGetStats(e_mqttTopicClass topicClass, s_mqttStats *pStats){
+  memcpy(pStats, &mqttStats[topicClass], sizeof(s_mqttStats));
+  return mqttClassNames[topicClass];
+}
+
+/**
+ * *******************************************************************
+ * @brief   send publish statistics in JSON format via MQTT
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void sendMqttInfo(){
+  StaticJsonDocument<512> mqttJSON;
+  mqttJSON["queue"] = mqttQueueCount;
+  mqttJSON["backpressure"] = (int)mqttGetBackpressure();
+  for (int i = 0; i < MQTT_CLASS_CNT; i++) {
+    JsonObject cls = mqttJSON.createNestedObject(mqttClassNames[i]);
+    cls["sent"] = mqttStats[i].sent;
+    cls["failed"] = mqttStats[i].failed;
+    cls["dropped"] = mqttStats[i].dropped;
+    cls["bytes"] = mqttStats[i].bytes;
+  }
+  mqttPublishJson(addTopic("/info/mqtt"), mqttJSON, false);
+}
+
+/**
+ * *******************************************************************
+ * @brief   MQTT Publish function for JSON documents
+ * @details the document is serialized directly into the MQTT socket
+ *          (beginPublish/endPublish), so the payload is neither copied
+ *          into a String nor limited by the PubSubClient buffer size
+ * @param   sendtopic: topic to publish
+ * @param   doc: JSON document to send
+ * @param   retained: retained flag
+ * @return  true if the message was sent
+ * *******************************************************************/
+bool mqttPublishJson(const char* sendtopic, const JsonDocument& doc, boolean retained){
+  size_t len = measureJson(doc);
+  if (!mqtt_client.beginPublish(sendtopic, len, retained)) {
+    mqttStats[MQTT_CLASS_OTHER].failed++;
+    return false;
+  }
+  MqttChunkPrint chunkPrint;
+  serializeJson(doc, chunkPrint);
+  chunkPrint.flush();
+  if (!mqtt_client.endPublish()) {
+    mqttStats[MQTT_CLASS_OTHER].failed++;
+    return false;
+  }
+  mqttStats[MQTT_CLASS_OTHER].sent++;
+  mqttStats[MQTT_CLASS_OTHER].bytes += len;
+  return true;
+}
+
+/**
+ * *******************************************************************
+ * @brief   MQTT Publish function for binary payloads
+ * @details the payload is written directly into the MQTT socket
+ *          and is not limited by the PubSubClient buffer size
+ * @param   sendtopic: topic to publish
+ * @param   payload: binary payload
+ * @param   len: length of the payload
+ * @param   retained: retained flag
+ * @return  true if the message was sent
+ * *******************************************************************/
+bool mqttPublishBinary(const char* sendtopic, const uint8_t* payload, size_t len, boolean retained){
+  if (!mqtt_client.beginPublish(sendtopic, len, retained) ||
+      mqtt_client.write(payload, len) != len ||
+      !mqtt_client.endPublish()) {
+    mqttStats[MQTT_CLASS_OTHER].failed++;
+    return false;
+  }
+  mqttStats[MQTT_CLASS_OTHER].sent++;
+  mqttStats[MQTT_CLASS_OTHER].bytes += len;
+  return true;
+}
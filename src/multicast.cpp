@@ -0,0 +1,124 @@
+//*****************************************************************************
+// 
+// Title      : optional udp multicast of value changes
+// Remark     : changed values of the register mirror are sent as compact binary
+//              datagrams to a multicast group, without broker. Every datagram
+//              has a sequence number, a cyclic datagram with all values lets
+//              receivers detect lost datagrams and resync.
+//              datagram (little endian):
+//                "KM", version, type (0 = changes, 1 = all values),
+//                sequence (uint32), decode time (uint64, us since epoch), count,
+//                count * (value id, value type, raw byte)
+//              reference receiver: tools/mcast_receive.py
+//              if you dont want to use this, you can disable this in config.h
+//*****************************************************************************
+#include <multicast.h>
+#include <basics.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <sys/time.h>
+
+/* V A R I A B L E S ********************************************************/
+WiFiUDP  mcastUdp;
+bool     mcastDirty[KM271_VAL_CNT];           // value has changed since the last datagram
+uint8_t  mcastDirtyCnt = 0;                   // number of changed values
+uint32_t mcastFirstChange = 0;                // timestamp of the oldest unsent change
+uint64_t mcastDecodeTime = 0;                 // decode time of the oldest unsent change (us since epoch)
+uint32_t mcastSeq = 0;                        // sequence number of the next datagram
+muTimer  mcastFullTimer = muTimer();          // timer for cyclic datagram with all values
+
+uint8_t  mcastBuf[MCAST_HEADER_LEN + KM271_VAL_CNT * 3];
+
+/**
+ * *******************************************************************
+ * @brief   Basic Setup for the multicast sink
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void setupMulticast() {
+  km271SubscribeAll(multicastValueChanged, NULL);
+}
+
+/**
+ * *******************************************************************
+ * @brief   get the actual time
+ * @return  us since epoch (valid after NTP sync)
+ * *******************************************************************/
+uint64_t mcastTimeUs() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (uint64_t)tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+/**
+ * *******************************************************************
+ * @brief   mark a value of the register mirror as changed
+ * @details observer of all values of the register mirror
+ * @param   id: value id
+ * @return  none
+ * *******************************************************************/
+void multicastValueChanged(e_km271_valueId id, uint8_t raw, float value, void *ctx) {
+  if (mcastDirty[id]) return;
+  if (!mcastDirtyCnt) {
+    mcastFirstChange = millis();
+    mcastDecodeTime = mcastTimeUs();
+  }
+  mcastDirty[id] = true;
+  mcastDirtyCnt++;
+}
+
+/**
+ * *******************************************************************
+ * @brief   build and send a datagram
+ * @param   type: MCAST_TYPE_DELTA or MCAST_TYPE_FULL
+ * @return  none
+ * *******************************************************************/
+void mcastSend(uint8_t type) {
+  uint8_t *p = &mcastBuf[MCAST_HEADER_LEN];
+  uint8_t cnt = 0;
+  uint8_t raw;
+  uint64_t decodeTime = (type == MCAST_TYPE_FULL) ? mcastTimeUs() : mcastDecodeTime;
+
+  for (int i = 0; i < KM271_VAL_CNT; i++) {
+    if ((type == MCAST_TYPE_FULL || mcastDirty[i]) && km271GetValue((e_km271_valueId)i, &raw)) {
+      *p++ = i;
+      *p++ = km271GetValueDef((e_km271_valueId)i)->type;
+      *p++ = raw;
+      cnt++;
+    }
+    mcastDirty[i] = false;                    // a full datagram contains all changes, too
+  }
+  mcastDirtyCnt = 0;
+
+  mcastBuf[0] = 'K';
+  mcastBuf[1] = 'M';
+  mcastBuf[2] = MCAST_VERSION;
+  mcastBuf[3] = type;
+  for (int i = 0; i < 4; i++) mcastBuf[4 + i] = (mcastSeq >> (i * 8)) & 0xFF;
+  for (int i = 0; i < 8; i++) mcastBuf[8 + i] = (decodeTime >> (i * 8)) & 0xFF;
+  mcastBuf[16] = cnt;
+  mcastSeq++;
+
+  mcastUdp.beginPacket(MCAST_GROUP, MCAST_PORT);
+  mcastUdp.write(mcastBuf, p - mcastBuf);
+  mcastUdp.endPacket();
+}
+
+/**
+ * *******************************************************************
+ * @brief   Cyclic function for the multicast sink
+ * @details changes are sent after MCAST_DELTA_TIME, all values every
+ *          MCAST_FULL_TIME
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void cyclicMulticast() {
+  if (WiFi.status() != WL_CONNECTED) {
+    return;
+  }
+  if (mcastFullTimer.cycleTrigger(MCAST_FULL_TIME)) {
+    mcastSend(MCAST_TYPE_FULL);
+  } else if (mcastDirtyCnt && (millis() - mcastFirstChange) >= MCAST_DELTA_TIME) {
+    mcastSend(MCAST_TYPE_DELTA);
+  }
+}
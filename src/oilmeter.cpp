@@ -9,6 +9,10 @@
 #include <basics.h>
 #include <EEPROM.h>
 
+#ifdef USE_INFLUXDB
+  #include <influx.h>
+#endif
+
 /* V A R I A B L E S ********************************************************/
 int addr = 0;                             // start address for EEPROM
 int writeCounter =0;                      // counter for write to EEPROM
@@ -33,6 +37,20 @@ muTimer oilCyclicInfo = muTimer();        // timer for cyclic information
 void sendOilmeter() {
   // publish actual value
   mqttPublish(addTopic("/oilcounter"), String(data.oilcounter).c_str(), true);
+
+  #ifdef USE_INFLUXDB
+    influxAddLine("oilcounter", data.oilcounter);
+  #endif
+}
+
+/**
+ * *******************************************************************
+ * @brief   get actual value of the Oilcounter
+ * @param   none
+ * @return  oilcounter (1 = 0,01 litre)
+ * *******************************************************************/
+long getOilmeter() {
+  return data.oilcounter;
 }
 
 /**
@@ -76,8 +94,7 @@ void setupOilmeter(){
   EEPROM.begin(sizeof(data));
   EEPROM.get(addr,data);
   
-  Serial.print("restored value from Flash: ");
-  Serial.println(data.oilcounter);
+  LOG_I("restored value from Flash: %ld", data.oilcounter);
   String message = "oilcounter was set to: " + String(data.oilcounter);
   mqttPublish(addTopic("/message"), String(message).c_str(), false);
 
@@ -102,7 +119,7 @@ void cyclicOilmeter()
   if (statusTrigger && !reboot) {
       data.oilcounter = data.oilcounter + 2;            // one impulse = 0,02 litre
       writeCounter++;                                   // increase counter for writing to EEPROM
-      Serial.println(data.oilcounter);
+      LOG_D("oilcounter: %ld", data.oilcounter);
       sendOilmeter();                                   // send new Countervalue via MQTT
   }
 
@@ -0,0 +1,248 @@
+//*****************************************************************************
+// 
+// Title      : optional raw KM271 byte stream via TCP
+// Remark     : all bytes received from the KM271 are stored once in a shared
+//              ring. Every client has its own read cursor and is served
+//              directly from the ring without copy. A slow client only loses
+//              its own data, the KM271 handling is never blocked.
+//              The stream is read only, bytes sent by clients are discarded.
+//              With USE_RAWBRIDGE_WRITE one client on a second port can send
+//              write telegrams as 3964R frames (STX / DLE, data with DLE
+//              doubling, DLE ETX BCC / DLE or NAK). Only telegrams for the
+//              writable config blocks are accepted, they are queued like
+//              every other write telegram, so the 3964R handshake with the
+//              KM271 is done by the KM271 driver only.
+//              if you dont want to use this, you can disable this in config.h
+//*****************************************************************************
+#include <rawbridge.h>
+#include <mqtt.h>
+#include <basics.h>
+#include <WiFi.h>
+#include <lwip/sockets.h>
+
+/* V A R I A B L E S ********************************************************/
+typedef struct {
+  WiFiClient  client;
+  bool        active;                                   // slot in use
+  uint32_t    cursor;                                   // read position in the shared ring (absolute)
+  uint32_t    lost;                                     // bytes this client has missed
+} s_rawClient;
+
+WiFiServer    rawServer(RAW_PORT);
+s_rawClient   rawClients[RAW_MAX_CLIENTS];
+uint8_t       rawRing[RAW_RING_LEN];                    // received KM271 bytes
+uint32_t      rawWritePos = 0;                          // absolute write position, ring index = pos % RAW_RING_LEN
+
+#ifdef USE_RAWBRIDGE_WRITE
+  WiFiServer  rawWriteServer(RAW_WRITE_PORT);
+  WiFiClient  rawWriter;                                // the only client that may write
+  s_km271_rx  rawWriterRx;                              // 3964R receive state of the write client
+  uint32_t    rawWriterLast = 0;                        // millis() of the last received byte
+  uint32_t    rawTelegrams = 0;                         // write telegrams queued
+  uint32_t    rawRejected = 0;                          // valid write telegrams rejected (send queue full)
+  uint32_t    rawInvalid = 0;                           // frames with BCC error, wrong length or not writable block
+  uint32_t    rawTimeouts = 0;                          // frames aborted by the inter-byte timeout
+#endif
+
+/**
+ * *******************************************************************
+ * @brief   Basic Setup for the raw byte stream
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void setupRawBridge() {
+  rawServer.begin();
+  rawServer.setNoDelay(true);
+  #ifdef USE_RAWBRIDGE_WRITE
+    rawWriteServer.begin();
+    rawWriteServer.setNoDelay(true);
+  #endif
+}
+
+/**
+ * *******************************************************************
+ * @brief   store a received KM271 byte in the shared ring
+ * @details called for every byte by the KM271 receive handling
+ * @param   rxByte: received byte
+ * @return  none
+ * *******************************************************************/
+void rawBridgeAdd(uint8_t rxByte) {
+  rawRing[rawWritePos % RAW_RING_LEN] = rxByte;
+  rawWritePos++;
+}
+
+/**
+ * *******************************************************************
+ * @brief   send the pending part of the ring to a client without blocking
+ * @param   rc: client
+ * @return  none
+ * *******************************************************************/
+void rawSendPending(s_rawClient *rc) {
+  if (rawWritePos - rc->cursor > RAW_RING_LEN) {          // overwritten by new data, skip the lost part
+    rc->lost += rawWritePos - rc->cursor - RAW_RING_LEN;
+    rc->cursor = rawWritePos - RAW_RING_LEN;
+  }
+  while (rc->cursor != rawWritePos) {
+    uint32_t idx = rc->cursor % RAW_RING_LEN;
+    uint32_t len = rawWritePos - rc->cursor;
+    if (len > RAW_RING_LEN - idx) {
+      len = RAW_RING_LEN - idx;                         // up to the end of the ring, the rest in the next loop
+    }
+    int res = send(rc->client.fd(), &rawRing[idx], len, MSG_DONTWAIT);
+    if (res < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        rc->client.stop();                              // connection lost
+        rc->active = false;
+      }
+      return;                                           // socket full, try again later
+    }
+    rc->cursor += res;
+  }
+}
+
+#ifdef USE_RAWBRIDGE_WRITE
+/**
+ * *******************************************************************
+ * @brief   receive 3964R framed write telegrams of the write client
+ * @details the frames are decoded with the same state machine as the
+ *          KM271 data. A frame starts with STX (answered with DLE), a
+ *          valid telegram is answered with DLE, everything else with NAK.
+ *          Bytes outside of a frame are discarded.
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void rawWriterReceive() {
+  if (rawWriterRx.state != KM_RX_RESYNC && millis() - rawWriterLast > RAW_BYTE_TIMEOUT) {
+    rawWriterRx.state = KM_RX_RESYNC;                   // frame not complete in time
+    rawTimeouts++;
+  }
+  while (rawWriter.available()) {
+    uint8_t answer = 0;
+    rawWriterLast = millis();
+    switch (km271RxByte(&rawWriterRx, rawWriter.read())) {
+      case KM271_RX_CTRL:
+        if (rawWriterRx.block.buf[0] == KM_STX) {
+          rawWriterRx.state = KM_RX_IDLE;               // ready to receive the frame
+          answer = KM_DLE;
+        } else {
+          rawWriterRx.state = KM_RX_RESYNC;             // only STX starts a frame
+        }
+        break;
+      case KM271_RX_BLOCK:
+        if (rawWriterRx.block.len != 8 || !km271WriteAllowed(rawWriterRx.block.buf)) {
+          rawInvalid++;
+          answer = KM_NAK;
+        } else if (km271QueueTelegram(rawWriterRx.block.buf)) {
+          rawTelegrams++;
+          answer = KM_DLE;
+        } else {
+          rawRejected++;
+          answer = KM_NAK;
+        }
+        rawWriterRx.state = KM_RX_RESYNC;
+        break;
+      case KM271_RX_BCC_ERR:
+        rawInvalid++;
+        answer = KM_NAK;
+        rawWriterRx.state = KM_RX_RESYNC;
+        break;
+      case KM271_RX_RESYNC:
+        rawInvalid++;
+        break;
+      default:
+        break;
+    }
+    if (answer) {
+      rawWriter.write(answer);
+    }
+  }
+}
+
+/**
+ * *******************************************************************
+ * @brief   accept and serve the write client
+ * @details only one write client at a time, a second one is refused
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void cyclicRawWriter() {
+  if (rawWriteServer.hasClient()) {
+    WiFiClient client = rawWriteServer.available();
+    if (rawWriter.connected()) {
+      client.stop();                                    // already in use
+    } else {
+      rawWriter = client;
+      rawWriterRx.state = KM_RX_RESYNC;
+    }
+  }
+  if (rawWriter.connected()) {
+    rawWriterReceive();
+  }
+}
+#endif
+
+/**
+ * *******************************************************************
+ * @brief   Cyclic function for the raw byte stream
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void cyclicRawBridge() {
+  if (rawServer.hasClient()) {
+    WiFiClient client = rawServer.available();
+    int i;
+    for (i = 0; i < RAW_MAX_CLIENTS && rawClients[i].active; i++);
+    if (i < RAW_MAX_CLIENTS) {
+      rawClients[i].client = client;
+      rawClients[i].active = true;
+      rawClients[i].cursor = rawWritePos;               // new clients start with the actual data
+      rawClients[i].lost = 0;
+    } else {
+      client.stop();                                    // no free slot
+    }
+  }
+  for (int i = 0; i < RAW_MAX_CLIENTS; i++) {
+    s_rawClient *rc = &rawClients[i];
+    if (!rc->active) continue;
+    if (!rc->client.connected()) {
+      rc->client.stop();
+      rc->active = false;
+      continue;
+    }
+    while (rc->client.available()) {
+      rc->client.read();                                // the stream is read only
+    }
+    rawSendPending(rc);
+  }
+  #ifdef USE_RAWBRIDGE_WRITE
+    cyclicRawWriter();
+  #endif
+}
+
+/**
+ * *******************************************************************
+ * @brief   send raw bridge statistics via mqtt
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void sendRawBridgeInfo() {
+  StaticJsonDocument<256> rawJSON;
+  uint32_t clients = 0, lost = 0;
+  for (int i = 0; i < RAW_MAX_CLIENTS; i++) {
+    if (rawClients[i].active) {
+      clients++;
+      lost += rawClients[i].lost;
+    }
+  }
+  rawJSON["clients"] = clients;
+  rawJSON["rx_bytes"] = rawWritePos;
+  rawJSON["lost_bytes"] = lost;
+  #ifdef USE_RAWBRIDGE_WRITE
+    rawJSON["writer"] = rawWriter.connected();
+    rawJSON["telegrams"] = rawTelegrams;
+    rawJSON["rejected"] = rawRejected;
+    rawJSON["invalid"] = rawInvalid;
+    rawJSON["timeouts"] = rawTimeouts;
+  #endif
+  mqttPublishJson(addTopic("/info/rawbridge"), rawJSON, false);
+}
@@ -0,0 +1,383 @@
+//*****************************************************************************
+// 
+// Title      : optional on-device rules
+// Remark     : simple automations that work without broker and network.
+//              A rule has up to 8 conditions on decoded values (all have to
+//              be true) and sends a setvalue command if it becomes true
+//              ("then") and optionally another one if it becomes false again
+//              ("else"). Only the conditions of a changed value are evaluated.
+//              Commands are sent like the mqtt setvalues via km271sendCmd().
+//              The rules are loaded as JSON from mqtt <topic>/cmd/rules and
+//              stored on LittleFS for the next start, e.g.
+//              [{"name":"ww_day_if_cold",
+//                "if":[["outside_temperature","<",0],["DHW_temperature","<",45]],
+//                "then":["ww_betriebsart",1], "else":["ww_betriebsart",2],
+//                "interval":300}]
+//              operators: == != < <= > >= and & (raw value has one of the bits)
+//              if you dont want to use this, you can disable this in config.h
+//*****************************************************************************
+#include <rules.h>
+#include <mqtt.h>
+#include <basics.h>
+#include <LittleFS.h>
+
+/* T Y P E S ****************************************************************/
+typedef enum {
+  RULE_OP_EQ,
+  RULE_OP_NE,
+  RULE_OP_LT,
+  RULE_OP_LE,
+  RULE_OP_GT,
+  RULE_OP_GE,
+  RULE_OP_BIT,
+} e_ruleOp;
+
+typedef enum {
+  RULE_ACT_NONE,                                        // no command sent yet
+  RULE_ACT_THEN,                                        // "then" command sent
+  RULE_ACT_ELSE,                                        // "else" command sent (or none defined)
+} e_ruleAct;
+
+typedef struct {
+  float       val;                                      // value to compare with
+  uint8_t     id;                                       // value id
+  uint8_t     op;                                       // e_ruleOp
+  uint8_t     rule;                                     // rule index
+  uint8_t     bit;                                      // bit of the condition in the rule masks
+  uint8_t     next;                                     // next condition of the same value (index + 1, 0 = end)
+} s_ruleCond;
+
+typedef struct {
+  char        name[RULES_NAME_LEN];
+  uint8_t     condMask;                                 // one bit per condition
+  uint8_t     validMask;                                // conditions with a received value
+  uint8_t     trueMask;                                 // conditions that are true
+  int8_t      thenCmd;                                  // e_km271_sendCmd, -1 = none
+  int8_t      elseCmd;
+  uint8_t     thenPara;
+  uint8_t     elsePara;
+  uint8_t     lastAct;                                  // e_ruleAct
+  uint32_t    interval;                                 // min. time between two commands [ms]
+  uint32_t    lastCmd;                                  // millis() of the last command
+  uint32_t    evals;                                    // condition evaluations
+  uint32_t    evalUs;                                   // sum of evaluation time [us]
+  uint32_t    evalMaxUs;                                // longest evaluation [us]
+  uint32_t    cmds;                                     // commands sent
+  uint32_t    delayed;                                  // commands delayed by the interval or a busy send buffer
+  bool        pending;                                  // a command waits for the end of the interval
+} s_rule;
+
+/* V A R I A B L E S ********************************************************/
+s_rule        rules[RULES_MAX];
+uint8_t       rulesCnt = 0;
+s_ruleCond    ruleConds[RULES_MAX_CONDS];
+uint8_t       ruleCondsCnt = 0;
+uint8_t       ruleCondHead[KM271_VAL_CNT];              // first condition per value (index + 1, 0 = none)
+bool          rulesPending = false;                     // a command waits for the end of the interval
+
+const char *ruleOpNames[] = {"==", "!=", "<", "<=", ">", ">=", "&"};
+
+/**
+ * *******************************************************************
+ * @brief   find the value id of a value name
+ * @param   name: value name (as in the mqtt status topics)
+ * @return  value id, -1 if unknown
+ * *******************************************************************/
+static int rulesFindValue(const char *name) {
+  for (int i = 0; name && i < KM271_VAL_CNT; i++) {
+    if (strcmp(km271GetValueDef((e_km271_valueId)i)->name, name) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * *******************************************************************
+ * @brief   find a string in a table
+ * @param   table: table of names
+ * @param   cnt: entries of the table
+ * @param   name: name to find
+ * @return  index, -1 if unknown
+ * *******************************************************************/
+static int rulesFindName(const char * const *table, int cnt, const char *name) {
+  for (int i = 0; name && i < cnt; i++) {
+    if (strcmp(table[i], name) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * *******************************************************************
+ * @brief   evaluate one condition
+ * @param   cond: condition
+ * @param   raw: raw value
+ * @param   value: decoded value
+ * @return  true if the condition is true
+ * *******************************************************************/
+static bool rulesCompare(const s_ruleCond *cond, uint8_t raw, float value) {
+  switch (cond->op) {
+    case RULE_OP_EQ:  return value == cond->val;
+    case RULE_OP_NE:  return value != cond->val;
+    case RULE_OP_LT:  return value <  cond->val;
+    case RULE_OP_LE:  return value <= cond->val;
+    case RULE_OP_GT:  return value >  cond->val;
+    case RULE_OP_GE:  return value >= cond->val;
+    case RULE_OP_BIT: return (raw & (uint8_t)cond->val) != 0;
+  }
+  return false;
+}
+
+/**
+ * *******************************************************************
+ * @brief   send the command of a rule if its state has changed
+ * @details a rule sends "then" once all conditions are true, and "else"
+ *          once they are not true anymore. Commands closer than the
+ *          interval of the rule or while another command is being sent
+ *          are delayed.
+ * @param   r: rule
+ * @return  none
+ * *******************************************************************/
+static void rulesAct(s_rule *r) {
+  bool wasPending = r->pending;
+  uint8_t act;
+  r->pending = false;
+  if (r->validMask != r->condMask) {
+    return;                                                         // not all values received yet
+  }
+  if (r->trueMask == r->condMask) {
+    act = RULE_ACT_THEN;
+  } else if (r->lastAct == RULE_ACT_THEN) {
+    act = RULE_ACT_ELSE;
+  } else {
+    return;
+  }
+  if (act == r->lastAct) {
+    return;
+  }
+  int8_t cmd = (act == RULE_ACT_THEN) ? r->thenCmd : r->elseCmd;
+  if (cmd >= 0) {
+    if ((r->cmds && millis() - r->lastCmd < r->interval) || !km271TxQueueFree()) {
+      if (!wasPending) r->delayed++;
+      r->pending = true;
+      rulesPending = true;                                          // try again in cyclicRules()
+      return;
+    }
+    km271sendCmd((e_km271_sendCmd)cmd, (act == RULE_ACT_THEN) ? r->thenPara : r->elsePara);
+    r->lastCmd = millis();
+    r->cmds++;
+    if (act == RULE_ACT_THEN) {
+      LOG_I_S("rule %s: then", r->name);
+    } else {
+      LOG_I_S("rule %s: else", r->name);
+    }
+  }
+  r->lastAct = act;
+}
+
+/**
+ * *******************************************************************
+ * @brief   evaluate the conditions of a changed value
+ * @details observer of all values of the register mirror. Only the
+ *          conditions of this value are evaluated.
+ * @param   id: value id
+ * @param   raw: raw value
+ * @param   value: decoded value
+ * @return  none
+ * *******************************************************************/
+void rulesValueChanged(e_km271_valueId id, uint8_t raw, float value, void *ctx) {
+  for (uint8_t n = ruleCondHead[id]; n; n = ruleConds[n-1].next) {
+    const s_ruleCond *cond = &ruleConds[n-1];
+    s_rule *r = &rules[cond->rule];
+    uint32_t start = micros();
+    r->validMask |= cond->bit;
+    if (rulesCompare(cond, raw, value)) {
+      r->trueMask |= cond->bit;
+    } else {
+      r->trueMask &= ~cond->bit;
+    }
+    rulesAct(r);
+    uint32_t us = micros() - start;
+    r->evals++;
+    r->evalUs += us;
+    if (us > r->evalMaxUs) r->evalMaxUs = us;
+  }
+}
+
+/**
+ * *******************************************************************
+ * @brief   parse a command ["name", parameter]
+ * @details the parameter is checked against the range of the command
+ * @param   cmd: JSON array or null
+ * @param   pCmd: command, -1 if not given
+ * @param   pPara: parameter
+ * @return  false if the command is invalid
+ * *******************************************************************/
+static bool rulesParseCmd(JsonVariantConst cmd, int8_t *pCmd, uint8_t *pPara) {
+  *pCmd = -1;
+  *pPara = 0;
+  if (cmd.isNull()) {
+    return true;
+  }
+  int c = km271FindCmdDef(cmd[0]);                                  // same names as the mqtt setvalue topics
+  if (c < 0 || !cmd[1].is<int>() || !km271CmdTelegram((e_km271_sendCmd)c, cmd[1].as<int>(), NULL)) {
+    return false;                                                   // unknown command or parameter out of its range
+  }
+  *pCmd = c;
+  *pPara = (uint8_t)cmd[1].as<int>();                               // negative values as two's complement, see km271sendCmd()
+  return true;
+}
+
+/**
+ * *******************************************************************
+ * @brief   load rules from JSON
+ * @details the rules are checked completely before they replace the
+ *          actual rules, invalid rules keep the actual ones
+ * @param   json: array of rules
+ * @param   store: store the rules on LittleFS for the next start
+ * @return  false if the rules are invalid
+ * *******************************************************************/
+bool rulesLoad(const char *json, bool store) {
+  static s_rule newRules[RULES_MAX];
+  static s_ruleCond newConds[RULES_MAX_CONDS];
+  DynamicJsonDocument doc(RULES_JSON_LEN);
+  uint8_t newCnt = 0, newCondsCnt = 0;
+  uint8_t raw;
+
+  if (deserializeJson(doc, json) || !doc.is<JsonArray>() || doc.size() > RULES_MAX) {
+    LOG_W("rules: invalid JSON or too many rules");
+    return false;
+  }
+  for (JsonObjectConst jr : doc.as<JsonArrayConst>()) {
+    s_rule *r = &newRules[newCnt];
+    memset(r, 0, sizeof(*r));
+    strlcpy(r->name, jr["name"] | "rule", sizeof(r->name));
+    r->interval = (jr["interval"] | RULES_INTERVAL) * 1000UL;
+    JsonArrayConst conds = jr["if"];
+    if (conds.size() == 0 || conds.size() > RULES_RULE_CONDS || newCondsCnt + conds.size() > RULES_MAX_CONDS) {
+      LOG_W_S("rules: %s has no or too many conditions", r->name);
+      return false;
+    }
+    for (JsonArrayConst jc : conds) {
+      s_ruleCond *c = &newConds[newCondsCnt];
+      int id = rulesFindValue(jc[0]);
+      int op = rulesFindName(ruleOpNames, sizeof(ruleOpNames) / sizeof(ruleOpNames[0]), jc[1]);
+      if (id < 0 || op < 0 || !jc[2].is<float>()) {
+        LOG_W_S("rules: %s has an invalid condition", r->name);
+        return false;
+      }
+      c->id = id;
+      c->op = op;
+      c->val = jc[2].as<float>();
+      c->rule = newCnt;
+      c->bit = (uint8_t)(r->condMask + 1) & ~r->condMask;           // next free bit
+      r->condMask |= c->bit;
+      newCondsCnt++;
+    }
+    if (!rulesParseCmd(jr["then"], &r->thenCmd, &r->thenPara) || !rulesParseCmd(jr["else"], &r->elseCmd, &r->elsePara)) {
+      LOG_W_S("rules: %s has an invalid command or parameter", r->name);
+      return false;
+    }
+    newCnt++;
+  }
+
+  // activate the new rules, the conditions are evaluated with the actual values
+  memcpy(rules, newRules, sizeof(rules));
+  memcpy(ruleConds, newConds, sizeof(ruleConds));
+  rulesCnt = newCnt;
+  ruleCondsCnt = newCondsCnt;
+  rulesPending = false;
+  memset(ruleCondHead, 0, sizeof(ruleCondHead));
+  for (int i = ruleCondsCnt - 1; i >= 0; i--) {
+    ruleConds[i].next = ruleCondHead[ruleConds[i].id];
+    ruleCondHead[ruleConds[i].id] = i + 1;
+  }
+  for (int i = 0; i < KM271_VAL_CNT; i++) {
+    if (ruleCondHead[i] && km271GetValue((e_km271_valueId)i, &raw)) {
+      rulesValueChanged((e_km271_valueId)i, raw, km271DecodeValue((e_km271_valueId)i, raw), NULL);
+    }
+  }
+  LOG_I("rules: %d rules loaded", rulesCnt);
+
+  if (store) {
+    File f = LittleFS.open(RULES_FILE);
+    if (f) {
+      bool same = f.readString() == json;                           // e.g. retained message after reconnect
+      f.close();
+      if (same) {
+        return true;
+      }
+    }
+    f = LittleFS.open(RULES_FILE, FILE_WRITE);
+    if (!f || f.print(json) != strlen(json)) {
+      LOG_W("rules: store failed");
+    }
+    if (f) {
+      f.close();
+    }
+  }
+  return true;
+}
+
+/**
+ * *******************************************************************
+ * @brief   Basic Setup for the rules
+ * @details loads the rules stored on LittleFS
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void setupRules() {
+  km271SubscribeAll(rulesValueChanged, NULL);
+  if (!LittleFS.begin(true)) {
+    LOG_E("rules: LittleFS mount failed");
+    return;
+  }
+  File f = LittleFS.open(RULES_FILE);
+  if (f) {
+    String json = f.readString();
+    f.close();
+    rulesLoad(json.c_str(), false);
+  }
+}
+
+/**
+ * *******************************************************************
+ * @brief   Cyclic function for the rules
+ * @details sends delayed commands after the interval of their rule
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void cyclicRules() {
+  if (!rulesPending) {
+    return;
+  }
+  rulesPending = false;
+  for (int i = 0; i < rulesCnt; i++) {
+    rulesAct(&rules[i]);                                            // sets rulesPending again if still too early
+  }
+}
+
+/**
+ * *******************************************************************
+ * @brief   send state and evaluation costs of all rules via mqtt
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+void sendRulesInfo() {
+  DynamicJsonDocument rulesJSON(256 + RULES_MAX * 192);
+  JsonArray arr = rulesJSON.to<JsonArray>();
+  for (int i = 0; i < rulesCnt; i++) {
+    const s_rule *r = &rules[i];
+    JsonObject jr = arr.createNestedObject();
+    jr["name"] = r->name;
+    jr["state"] = (r->validMask != r->condMask) ? "unknown" : (r->trueMask == r->condMask) ? "true" : "false";
+    jr["evals"] = r->evals;
+    jr["avg_us"] = r->evals ? r->evalUs / r->evals : 0;
+    jr["max_us"] = r->evalMaxUs;
+    jr["cmds"] = r->cmds;
+    jr["delayed"] = r->delayed;
+  }
+  mqttPublishJson(addTopic("/info/rules"), rulesJSON, false);
+}
@@ -0,0 +1,16 @@
+// host mock: the parts of Arduino.h used by the tested modules
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+#include <math.h>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+uint32_t millis();
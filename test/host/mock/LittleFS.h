@@ -0,0 +1,86 @@
+// host mock: LittleFS in RAM, counts the write accesses
+#pragma once
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+typedef std::map<std::string, std::vector<uint8_t>> t_mockFiles;
+extern t_mockFiles  mockFiles;
+extern uint32_t     mockFsWrites;                       // open for write, write, remove
+extern size_t       mockFsTotal;                        // totalBytes()
+
+class File {
+public:
+  std::string path;
+  bool        valid = false;
+  bool        dir = false;
+  size_t      pos = 0;
+  std::string next;                                     // directory: last returned name
+
+  operator bool() const { return valid; }
+  size_t size() { return valid ? mockFiles[path].size() : 0; }
+  size_t write(const uint8_t *buf, size_t len) {
+    std::vector<uint8_t> &v = mockFiles[path];
+    v.insert(v.end(), buf, buf + len);
+    mockFsWrites++;
+    return len;
+  }
+  size_t read(uint8_t *buf, size_t len) {
+    std::vector<uint8_t> &v = mockFiles[path];
+    size_t n = (pos < v.size()) ? min(len, v.size() - pos) : 0;
+    memcpy(buf, v.data() + pos, n);
+    pos += n;
+    return n;
+  }
+  bool seek(uint32_t p) { pos = p; return p <= mockFiles[path].size(); }
+  void close() { valid = false; }
+  const char *name() { return path.c_str(); }
+  File openNextFile() {
+    File f;
+    for (auto it = mockFiles.upper_bound(next); it != mockFiles.end(); it++) {
+      if (it->first.compare(0, path.size() + 1, path + "/") == 0) {
+        next = f.path = it->first;
+        f.valid = true;
+        break;
+      }
+    }
+    return f;
+  }
+};
+
+class FS {
+public:
+  bool begin(bool format) { return true; }
+  bool mkdir(const char *path) { return true; }
+  File open(const char *path, const char *mode = FILE_READ) {
+    File f;
+    f.path = path;
+    if (f.path == "/hist") {
+      f.valid = f.dir = true;
+      return f;
+    }
+    if (mode[0] == 'r') {
+      if (!mockFiles.count(f.path)) return f;
+    } else {
+      if (mode[0] == 'w') mockFiles[f.path].clear();
+      mockFiles[f.path];
+      mockFsWrites++;
+    }
+    f.valid = true;
+    return f;
+  }
+  bool remove(const char *path) { mockFsWrites++; return mockFiles.erase(path); }
+  size_t totalBytes() { return mockFsTotal; }
+  size_t usedBytes() {
+    size_t n = 0;
+    for (auto &f : mockFiles) n += f.second.size();
+    return n;
+  }
+};
+
+extern FS LittleFS;
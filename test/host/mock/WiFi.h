@@ -0,0 +1,43 @@
+// host mock: WiFiServer / WiFiClient, the test plays the remote side
+#pragma once
+#include <Arduino.h>
+#include <deque>
+#include <memory>
+#include <string>
+
+// one TCP connection
+struct MockConn {
+  int         fd;
+  std::string in;                                       // request from the remote side
+  size_t      inPos = 0;
+  std::string out;                                      // data sent by the module
+  bool        open = true;
+  size_t      window = 0;                               // bytes send() accepts per call, 0 = EAGAIN
+};
+extern std::deque<std::shared_ptr<MockConn>> mockPending;
+
+class WiFiClient {
+public:
+  std::shared_ptr<MockConn> c;
+
+  int fd() { return c ? c->fd : -1; }
+  uint8_t connected() { return c && c->open; }
+  int available() { return c ? c->in.size() - c->inPos : 0; }
+  int read() { return available() ? (uint8_t)c->in[c->inPos++] : -1; }
+  size_t print(const char *s) { if (c) c->out += s; return strlen(s); }
+  void stop() { if (c) c->open = false; c.reset(); }
+};
+
+class WiFiServer {
+public:
+  WiFiServer(uint16_t port) {}
+  void begin() {}
+  void setNoDelay(bool nodelay) {}
+  bool hasClient() { return !mockPending.empty(); }
+  WiFiClient available() {
+    WiFiClient client;
+    client.c = mockPending.front();
+    mockPending.pop_front();
+    return client;
+  }
+};
@@ -0,0 +1,10 @@
+// host mock: no logging
+#pragma once
+#define LOG_E(...)    do {} while (0)
+#define LOG_W(...)    do {} while (0)
+#define LOG_I(...)    do {} while (0)
+#define LOG_D(...)    do {} while (0)
+#define LOG_E_S(...)  do {} while (0)
+#define LOG_W_S(...)  do {} while (0)
+#define LOG_I_S(...)  do {} while (0)
+#define LOG_D_S(...)  do {} while (0)
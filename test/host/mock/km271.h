@@ -0,0 +1,13 @@
+// host mock: register mirror, config cache and send queue are provided by the test
+#pragma once
+#include <km271_proto.h>
+
+typedef void (*km271ValueCallback)(e_km271_valueId id, uint8_t raw, float value, void *ctx);
+
+bool  km271GetValue(e_km271_valueId id, uint8_t *pRaw);
+float km271DecodeValue(e_km271_valueId id, uint8_t raw);
+const s_km271_valueDef *km271GetValueDef(e_km271_valueId id);
+bool  km271SubscribeAll(km271ValueCallback callback, void *ctx);
+bool  km271GetCmdValue(e_km271_sendCmd sendCmd, int *pValue);
+bool  km271QueueTelegram(const uint8_t *telegram);
+uint8_t km271TxQueueFree();
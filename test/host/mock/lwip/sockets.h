@@ -0,0 +1,3 @@
+// host mock: send() is replaced by the test, see mockSend in test_history.cpp
+#pragma once
+#include <sys/socket.h>
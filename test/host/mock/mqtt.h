@@ -0,0 +1,10 @@
+// host mock: mqtt publishes are dropped
+#pragma once
+#include <Arduino.h>
+
+template<int N> struct StaticJsonDocument {
+  struct Member { template<class T> Member &operator=(T v) { return *this; } };
+  Member operator[](const char *key) { return Member(); }
+};
+template<class D> bool mqttPublishJson(const char *topic, const D &doc, bool retained) { return true; }
+inline const char *addTopic(const char *suffix) { return suffix; }
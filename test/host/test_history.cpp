@@ -0,0 +1,232 @@
+//*****************************************************************************
+//
+// Title      : host test of src/history.cpp
+// Remark     : runs the history module against the mocks in mock/:
+//              - the value observer never touches the file system
+//              - all changes of a time range are exported in time order
+//              - the export sends at most one chunk per cyclicHistory()
+//              - old days are deleted after 42 days or if the flash is full
+//
+//*****************************************************************************
+#include <history.h>
+#include <WiFi.h>
+#include <vector>
+
+/* M O C K S ****************************************************************/
+t_mockFiles   mockFiles;
+uint32_t      mockFsWrites = 0;
+size_t        mockFsTotal = 1400000;
+FS            LittleFS;
+std::deque<std::shared_ptr<MockConn>> mockPending;
+std::vector<std::shared_ptr<MockConn>> mockConns;
+
+static uint32_t   mockMillis = 0;
+static time_t     mockNow = 1760000000;
+static uint8_t    mockRaw[KM271_VAL_CNT];
+static bool       mockValid[KM271_VAL_CNT];
+
+uint32_t millis() { return mockMillis; }
+extern "C" time_t time(time_t *t) { if (t) *t = mockNow; return mockNow; }
+extern "C" ssize_t send(int fd, const void *buf, size_t len, int flags) {
+  MockConn *c = mockConns[fd].get();
+  if (!c->window) {
+    errno = EAGAIN;
+    return -1;
+  }
+  size_t n = min(len, c->window);
+  c->out.append((const char *)buf, n);
+  return n;
+}
+
+bool km271GetValue(e_km271_valueId id, uint8_t *pRaw) {
+  if (!mockValid[id]) return false;
+  *pRaw = mockRaw[id];
+  return true;
+}
+float km271DecodeValue(e_km271_valueId id, uint8_t raw) { return km271DecodeRaw(kmValueDefs[id].type, raw); }
+const s_km271_valueDef *km271GetValueDef(e_km271_valueId id) { return &kmValueDefs[id]; }
+bool km271SubscribeAll(km271ValueCallback callback, void *ctx) { return true; }
+
+extern uint32_t histDropped;
+
+/* T E S T S ****************************************************************/
+static int failed = 0;
+#define CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failed++; } } while (0)
+
+typedef struct {
+  uint32_t    time;
+  std::string line;
+} s_change;
+
+/**
+ * *******************************************************************
+ * @brief   change random values for some time, as the KM271 receive path
+ * @param   count: number of changes
+ * @param   maxStep: max. seconds between two changes
+ * @param   cyclic: call cyclicHistory() after every change
+ * @param   log: the expected CSV lines are added here
+ * @return  none
+ * *******************************************************************/
+static void changeValues(int count, int maxStep, bool cyclic, std::vector<s_change> *log) {
+  for (int i = 0; i < count; i++) {
+    mockNow += rand() % (maxStep + 1);
+    mockMillis += 1000 * (rand() % (maxStep + 1));
+    int id = rand() % KM271_VAL_CNT;
+    uint8_t raw = rand() % 256;
+    if (mockValid[id] && mockRaw[id] == raw) {
+      continue;
+    }
+    mockRaw[id] = raw;
+    mockValid[id] = true;
+    uint32_t writes = mockFsWrites;
+    historyValueChanged((e_km271_valueId)id, raw, 0, NULL);
+    CHECK(mockFsWrites == writes);                                  // observer: RAM only
+    if (log) {
+      char line[80];
+      snprintf(line, sizeof(line), "%lu,%s,%g\n", (unsigned long)mockNow, kmValueDefs[id].name, km271DecodeRaw(kmValueDefs[id].type, raw));
+      log->push_back({(uint32_t)mockNow, line});
+    }
+    if (cyclic) {
+      cyclicHistory();
+    }
+  }
+}
+
+/**
+ * *******************************************************************
+ * @brief   connect to the export server
+ * @param   request: request line
+ * @param   window: bytes accepted per send()
+ * @return  connection
+ * *******************************************************************/
+static std::shared_ptr<MockConn> connectExport(const char *request, size_t window) {
+  std::shared_ptr<MockConn> c = std::make_shared<MockConn>();
+  c->fd = mockConns.size();
+  c->in = std::string(request) + "\r\nHost: esp\r\n\r\n";
+  c->window = window;
+  mockConns.push_back(c);
+  mockPending.push_back(c);
+  return c;
+}
+
+/**
+ * *******************************************************************
+ * @brief   remove the chunked transfer encoding
+ * @param   resp: http response
+ * @param   body: decoded body
+ * @return  false if the chunks are malformed or the last chunk is missing
+ * *******************************************************************/
+static bool dechunk(const std::string &resp, std::string *body) {
+  size_t pos = resp.find("\r\n\r\n");
+  if (pos == std::string::npos) return false;
+  pos += 4;
+  for (;;) {
+    size_t len = strtoul(resp.c_str() + pos, NULL, 16);
+    pos = resp.find("\r\n", pos);
+    if (pos == std::string::npos) return false;
+    pos += 2;
+    if (!len) return resp.compare(pos, std::string::npos, "\r\n") == 0;
+    if (pos + len + 2 > resp.size() || resp.compare(pos + len, 2, "\r\n") != 0) return false;
+    body->append(resp, pos, len);
+    pos += len + 2;
+  }
+}
+
+static void testObserverAndExport() {
+  std::vector<s_change> log;
+  uint32_t start = mockNow;
+  changeValues(200000, 20, true, &log);                             // about 22 days
+  CHECK(mockNow - start > 20 * 86400);
+  CHECK(histDropped == 0);
+
+  // export two days in the middle through a slow connection
+  uint32_t from = start + 3 * 86400 + 5000, to = from + 2 * 86400;
+  char req[96];
+  snprintf(req, sizeof(req), "GET /history?from=%lu&to=%lu HTTP/1.1", (unsigned long)from, (unsigned long)to);
+  std::shared_ptr<MockConn> c = connectExport(req, 0);
+  size_t maxStep = 0;
+  int calls = 0;
+  while (c->open && calls < 1000000) {
+    size_t len = c->out.size();
+    c->window = (calls % 7 == 3) ? 0 : (calls % 5 == 1) ? 100 : 4096;  // socket full now and then
+    cyclicHistory();
+    maxStep = max(maxStep, c->out.size() - len);
+    calls++;
+  }
+  CHECK(!c->open);
+  CHECK(maxStep <= HISTORY_OUT_LEN);                                // one chunk per call
+  CHECK(c->out.compare(0, 15, "HTTP/1.1 200 OK") == 0);
+
+  std::string body;
+  CHECK(dechunk(c->out, &body));
+  CHECK(body.compare(0, 16, "time,name,value\n") == 0);
+
+  // every change in the range is exported, all lines are in time order and range
+  size_t found = 0, total = 0;
+  for (const s_change &ch : log) {
+    if (ch.time < from || ch.time > to) continue;
+    total++;
+    if (body.find(ch.line) != std::string::npos) found++;
+  }
+  CHECK(total > 1000);
+  CHECK(found == total);
+  bool sorted = true;
+  uint32_t prev = 0;
+  for (size_t p = body.find('\n') + 1; p < body.size(); p = body.find('\n', p) + 1) {
+    uint32_t t = strtoul(body.c_str() + p, NULL, 10);
+    if (t < prev || t < from || t > to) sorted = false;
+    prev = t;
+  }
+  CHECK(sorted);
+  printf("export: %zu of %zu changes, %zu bytes in %d calls\n", found, total, body.size(), calls);
+}
+
+static void testServerErrors() {
+  std::shared_ptr<MockConn> a = connectExport("GET /history HTTP/1.1", 0);
+  cyclicHistory();                                                  // a is the active export
+  std::shared_ptr<MockConn> b = connectExport("GET /history HTTP/1.1", 1000);
+  cyclicHistory();
+  CHECK(b->out.compare(0, 12, "HTTP/1.1 503") == 0);
+  CHECK(!b->open);
+  mockMillis += HISTORY_TIMEOUT + 1;                                // a does not take any data
+  cyclicHistory();
+  CHECK(!a->open);
+
+  std::shared_ptr<MockConn> d = connectExport("GET /other HTTP/1.1", 1000);
+  for (int i = 0; i < 5 && d->open; i++) cyclicHistory();
+  CHECK(d->out.compare(0, 12, "HTTP/1.1 404") == 0);
+  CHECK(!d->open);
+}
+
+static void testFullBuffer() {
+  uint32_t writes = mockFsWrites, dropped = histDropped;
+  changeValues(5000, 0, false, NULL);                               // no main loop: the buffer overflows
+  CHECK(mockFsWrites == writes);
+  CHECK(histDropped > dropped);
+  cyclicHistory();
+  CHECK(mockFsWrites > writes);
+}
+
+static void testRetention() {
+  size_t days = 0;
+  changeValues(100000, 60, true, NULL);                             // about 35 more days
+  for (auto &f : mockFiles) {
+    if (f.first.find(".dat") != std::string::npos) days++;
+  }
+  CHECK(days <= HISTORY_DAYS + 1);
+
+  mockFsTotal = LittleFS.usedBytes() / 2 + HISTORY_MIN_FREE;        // flash nearly full
+  changeValues(20000, 20, true, NULL);
+  CHECK(LittleFS.totalBytes() - LittleFS.usedBytes() >= HISTORY_MIN_FREE / 2);
+}
+
+int main() {
+  srand(3);
+  setupHistory();
+  testObserverAndExport();
+  testServerErrors();
+  testFullBuffer();
+  testRetention();
+  printf("%s\n", failed ? "history: FAILED" : "history: ok");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,179 @@
+//*****************************************************************************
+//
+// Title      : host test of src/modbus.cpp
+// Remark     : canned Modbus TCP requests are given to mbHandleRequest(),
+//              the responses and the queued write telegrams are checked.
+//              modbus.cpp is included to reach its internal client type.
+//
+//*****************************************************************************
+#include "../../src/modbus.cpp"
+#include <string>
+#include <vector>
+
+/* M O C K S ****************************************************************/
+std::deque<std::shared_ptr<MockConn>> mockPending;
+
+static uint8_t    mockRaw[KM271_VAL_CNT];
+static bool       mockValid[KM271_VAL_CNT];
+static int        mockCmdValue[KM271_SENDCMD_CNT];
+static bool       mockCmdValid[KM271_SENDCMD_CNT];
+static std::vector<std::vector<uint8_t>> mockQueue;
+static uint8_t    mockQueueFree = 48;
+
+uint32_t millis() { return 0; }
+extern "C" ssize_t send(int fd, const void *buf, size_t len, int flags) { return len; }
+
+bool km271GetValue(e_km271_valueId id, uint8_t *pRaw) {
+  if (!mockValid[id]) return false;
+  *pRaw = mockRaw[id];
+  return true;
+}
+float km271DecodeValue(e_km271_valueId id, uint8_t raw) { return km271DecodeRaw(kmValueDefs[id].type, raw); }
+const s_km271_valueDef *km271GetValueDef(e_km271_valueId id) { return &kmValueDefs[id]; }
+bool km271GetCmdValue(e_km271_sendCmd sendCmd, int *pValue) {
+  if (!mockCmdValid[sendCmd]) return false;
+  *pValue = mockCmdValue[sendCmd];
+  return true;
+}
+bool km271QueueTelegram(const uint8_t *telegram) {
+  if (!mockQueueFree) return false;
+  mockQueue.push_back(std::vector<uint8_t>(telegram, telegram + 8));
+  mockQueueFree--;
+  return true;
+}
+uint8_t km271TxQueueFree() { return mockQueueFree; }
+
+/* T E S T S ****************************************************************/
+static int failed = 0;
+#define CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failed++; } } while (0)
+
+/**
+ * *******************************************************************
+ * @brief   handle one request
+ * @param   pdu: function code and data
+ * @return  response PDU (without MBAP header)
+ * *******************************************************************/
+static std::vector<uint8_t> request(std::vector<uint8_t> pdu) {
+  static s_mbClient mc;
+  uint16_t len = pdu.size() + 1;
+  uint8_t mbap[7] = {0x12, 0x34, 0, 0, (uint8_t)(len >> 8), (uint8_t)len, 1};
+  memcpy(mc.in, mbap, 7);
+  memcpy(&mc.in[7], pdu.data(), pdu.size());
+  mc.inLen = 7 + pdu.size();
+  mbHandleRequest(&mc);
+  CHECK(mc.out[0] == 0x12 && mc.out[1] == 0x34 && mc.out[6] == 1);   // transaction and unit id
+  CHECK(mc.outLen == 6 + ((mc.out[4] << 8) | mc.out[5]));
+  return std::vector<uint8_t>(&mc.out[7], &mc.out[mc.outLen]);
+}
+
+static bool isException(const std::vector<uint8_t> &res, uint8_t fc, uint8_t code) {
+  return res == std::vector<uint8_t>{(uint8_t)(fc | 0x80), code};
+}
+
+static std::vector<uint8_t> telegram(uint8_t type, uint8_t offset, uint8_t pos, uint8_t value) {
+  std::vector<uint8_t> t = {type, offset, 0x65, 0x65, 0x65, 0x65, 0x65, 0x65};
+  t[pos] = value;
+  return t;
+}
+
+static void testReads() {
+  int temp = -1, other = -1;
+  for (int i = 0; i < KM271_VAL_CNT; i++) {
+    if (kmValueDefs[i].type == KM271_VT_TEMP05 && temp < 0) temp = i;
+    if (kmValueDefs[i].type == KM271_VT_BITFIELD && other < 0) other = i;
+  }
+  mockRaw[temp] = 43;                                               // 21.5 °C
+  mockValid[temp] = true;
+  mockRaw[other] = 0xA5;
+  mockValid[other] = true;
+  mockValid[temp + 1] = false;
+
+  std::vector<uint8_t> res = request({4, 0, (uint8_t)temp, 0, 2});
+  CHECK(res == (std::vector<uint8_t>{4, 4, 0, 215, 0x80, 0x00}));   // 21.5 * 10, not received
+  res = request({4, 0, (uint8_t)other, 0, 1});
+  CHECK(res == (std::vector<uint8_t>{4, 2, 0, 0xA5}));
+  CHECK(isException(request({4, 0, 0, 0, 0}), 4, 3));               // quantity 0
+  CHECK(isException(request({4, 0, 0, 0, 126}), 4, 3));             // quantity > 125
+  CHECK(isException(request({4, 0, (uint8_t)(KM271_VAL_CNT - 1), 0, 2}), 4, 2));
+
+  // holding registers: value of the config cache, signed
+  memset(mockCmdValid, 0, sizeof(mockCmdValid));
+  mockCmdValue[KM271_SENDCMD_FROST_AB] = -5;
+  mockCmdValid[KM271_SENDCMD_FROST_AB] = true;
+  mockCmdValue[KM271_SENDCMD_AUSSENHALT] = 3;
+  mockCmdValid[KM271_SENDCMD_AUSSENHALT] = true;
+  res = request({3, 0, KM271_SENDCMD_FROST_AB, 0, 3});
+#ifdef USE_CONFIG_VALUES
+  CHECK(res == (std::vector<uint8_t>{3, 6, 0xFF, 0xFB, 0, 3, 0x80, 0x00}));
+#else
+  CHECK(res == (std::vector<uint8_t>{3, 6, 0x80, 0x00, 0x80, 0x00, 0x80, 0x00}));
+#endif
+  CHECK(isException(request({3, 0, 0, 0, KM271_SENDCMD_CNT + 1}), 3, 2));
+}
+
+static void testWriteSingle() {
+  mockQueue.clear();
+  std::vector<uint8_t> res = request({6, 0, KM271_SENDCMD_HK1_AUSLEGUNG, 0, 75});
+  CHECK(res == (std::vector<uint8_t>{6, 0, KM271_SENDCMD_HK1_AUSLEGUNG, 0, 75}));
+  CHECK(mockQueue.size() == 1 && mockQueue[0] == telegram(0x07, 0x0E, 6, 75));
+
+  res = request({6, 0, KM271_SENDCMD_FROST_AB, 0xFF, 0xFB});        // -5 °C
+  CHECK(res.size() == 5 && res[0] == 6);
+  CHECK(mockQueue.size() == 2 && mockQueue[1] == telegram(0x07, 0x31, 7, 0xFB));
+
+  // out of range values are refused, not truncated
+  CHECK(isException(request({6, 0, KM271_SENDCMD_HK1_AUSLEGUNG, 0, 91}), 6, 3));
+  CHECK(isException(request({6, 0, KM271_SENDCMD_HK1_BA, 0x01, 0x01}), 6, 3));     // 257
+  CHECK(isException(request({6, 0, KM271_SENDCMD_FROST_AB, 0xFF, 0xEB}), 6, 3));   // -21
+  CHECK(isException(request({6, 0, KM271_SENDCMD_WW_SOLL, 0, 0xFB}), 6, 3));       // 251 is no -5
+  CHECK(isException(request({6, 0, KM271_SENDCMD_CNT, 0, 1}), 6, 2));
+  CHECK(mockQueue.size() == 2);
+#ifndef USE_CONFIG_VALUES
+  CHECK(mbHoldingRegister(KM271_SENDCMD_HK1_AUSLEGUNG) == 75);
+  CHECK(mbHoldingRegister(KM271_SENDCMD_HK1_BA) == MB_INVALID);
+#endif
+
+  mockQueueFree = 0;
+  CHECK(isException(request({6, 0, KM271_SENDCMD_WW_SOLL, 0, 50}), 6, 6));         // queue full: busy
+  mockQueueFree = 48;
+}
+
+static void testWriteMultiple() {
+  mockQueue.clear();
+  std::vector<uint8_t> res = request({16, 0, KM271_SENDCMD_FROST_AB, 0, 3, 6, 0xFF, 0xF6, 0, 5, 0, 45});
+  CHECK(res == (std::vector<uint8_t>{16, 0, KM271_SENDCMD_FROST_AB, 0, 3}));
+  CHECK(mockQueue.size() == 3);                                     // every register has its own telegram
+  CHECK(mockQueue[0] == telegram(0x07, 0x31, 7, 0xF6));
+  CHECK(mockQueue[1] == telegram(0x07, 0x15, 4, 5));
+  CHECK(mockQueue[2] == telegram(0x0C, 0x07, 5, 45));
+
+  // one invalid value: nothing is sent
+  mockQueue.clear();
+  CHECK(isException(request({16, 0, KM271_SENDCMD_FROST_AB, 0, 3, 6, 0, 1, 0, 2, 0, 99}), 16, 3));
+  CHECK(mockQueue.empty());
+
+  // not enough room in the send queue: nothing is sent
+  mockQueueFree = 1;
+  CHECK(isException(request({16, 0, KM271_SENDCMD_FROST_AB, 0, 2, 4, 0, 1, 0, 2}), 16, 6));
+  CHECK(mockQueue.empty());
+  mockQueueFree = 48;
+
+  CHECK(isException(request({16, 0, 0, 0, 2, 3, 0, 1, 0, 2}), 16, 3));                    // byte count
+  CHECK(isException(request({16, 0, KM271_SENDCMD_WW_SOLL, 0, 2, 4, 0, 40, 0, 40}), 16, 2));
+  CHECK(isException(request({16, 0, 0, 0, 0, 0}), 16, 3));                                 // quantity 0
+  CHECK(mockQueue.empty());
+}
+
+static void testOther() {
+  CHECK(isException(request({0x2B, 0x0E, 1, 0}), 0x2B, 1));         // illegal function
+}
+
+int main() {
+  setupModbus();
+  testReads();
+  testWriteSingle();
+  testWriteMultiple();
+  testOther();
+  printf("%s\n", failed ? "modbus: FAILED" : "modbus: ok");
+  return failed ? 1 : 0;
+}
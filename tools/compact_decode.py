@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+"""
+Host decoder for the compact MessagePack payload of ESP_Buderus_KM271.
+
+Subscribes to <topic>/compact/schema and <topic>/compact and prints every
+received value with its name. With --stats the text status topics
+(<topic>/status/#) are received as well, and the bytes of both are
+compared on exit. Both are counted over the same time, with the real
+topics and payloads as sent by the device. The captured payloads are
+decoded again on exit to compare the decode time of both formats.
+
+requires: pip install paho-mqtt msgpack
+
+usage:    compact_decode.py --host 192.168.1.2 [--topic esp_heizung] [--stats]
+"""
+import argparse
+import json
+import time
+
+import msgpack
+import paho.mqtt.client as mqtt
+
+DECODE_ROUNDS = 200                                       # repetitions of the decode measurement
+
+
+def text_value(payload):
+    """decode a text status payload like a text subscriber: number if possible, else string"""
+    text = payload.decode()
+    try:
+        return float(text)
+    except ValueError:
+        return text
+
+
+def decode_time(decode, payloads):
+    """time of decoding all payloads once [s], best of DECODE_ROUNDS"""
+    best = None
+    for _ in range(DECODE_ROUNDS):
+        start = time.perf_counter()
+        for payload in payloads:
+            decode(payload)
+        elapsed = time.perf_counter() - start
+        best = elapsed if best is None else min(best, elapsed)
+    return best
+
+
+def packet_size(topic, payload):
+    """size of a QoS 0 publish packet: fixed header, remaining length, topic length, topic, payload"""
+    remaining = 2 + len(topic.encode()) + len(payload)
+    size_len = 1
+    while remaining >= 128 ** size_len:
+        size_len += 1
+    return 1 + size_len + remaining
+
+
+class CompactDecoder:
+    def __init__(self, topic, stats):
+        self.topic = topic
+        self.stats = stats
+        self.schema = {}
+        self.frames = 0
+        self.values = 0
+        self.texts = 0
+        self.compact_bytes = 0
+        self.text_bytes = 0
+        self.compact_payloads = []
+        self.text_payloads = []
+
+    def on_connect(self, client, userdata, flags, rc):
+        client.subscribe(self.topic + "/compact/schema")
+        client.subscribe(self.topic + "/compact")
+        if self.stats:
+            client.subscribe(self.topic + "/status/#")
+
+    def on_message(self, client, userdata, msg):
+        if msg.topic.endswith("/compact/schema"):
+            schema = json.loads(msg.payload)
+            self.schema = {v["id"]: v for v in schema["values"]}
+            print("schema version %d with %d values" % (schema["version"], len(self.schema)))
+            return
+        if msg.topic.startswith(self.topic + "/status/"):
+            if not msg.retain:                            # retained messages were sent before the start
+                self.texts += 1
+                self.text_bytes += packet_size(msg.topic, msg.payload)
+                self.text_payloads.append(msg.payload)
+            return
+
+        frame = msgpack.unpackb(msg.payload, strict_map_key=False)
+        self.frames += 1
+        self.compact_bytes += packet_size(msg.topic, msg.payload)
+        if self.stats:
+            self.compact_payloads.append(msg.payload)
+
+        for vid, value in frame.items():
+            name = self.schema.get(vid, {}).get("name", "id_%d" % vid)
+            print("%-40s %s" % (name, value))
+            self.values += 1
+
+    def report(self):
+        if not self.frames:
+            print("no frames received")
+            return
+        print("\ncompact: %d frames, %d values, %d bytes" % (self.frames, self.values, self.compact_bytes))
+        print("text   : %d messages, %d bytes" % (self.texts, self.text_bytes))
+        if self.compact_bytes:
+            print("size ratio text/compact: %.1f" % (self.text_bytes / self.compact_bytes))
+        if self.values and self.texts:
+            unpack = lambda payload: msgpack.unpackb(payload, strict_map_key=False)
+            compact_us = decode_time(unpack, self.compact_payloads) * 1e6
+            text_us = decode_time(text_value, self.text_payloads) * 1e6
+            print("decode compact: %.0f us, %.2f us/value" % (compact_us, compact_us / self.values))
+            print("decode text   : %.0f us, %.2f us/value" % (text_us, text_us / self.texts))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="decode ESP_Buderus_KM271 compact payload")
+    parser.add_argument("--host", required=True, help="mqtt broker")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--user")
+    parser.add_argument("--password")
+    parser.add_argument("--topic", default="esp_heizung", help="MQTT_TOPIC of the device")
+    parser.add_argument("--stats", action="store_true", help="compare the bytes with the text status topics")
+    args = parser.parse_args()
+
+    decoder = CompactDecoder(args.topic, args.stats)
+    client = mqtt.Client()
+    if args.user:
+        client.username_pw_set(args.user, args.password)
+    client.on_connect = decoder.on_connect
+    client.on_message = decoder.on_message
+    client.connect(args.host, args.port)
+    try:
+        client.loop_forever()
+    except KeyboardInterrupt:
+        pass
+    if args.stats:
+        decoder.report()
+
+
+if __name__ == "__main__":
+    main()
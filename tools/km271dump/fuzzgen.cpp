@@ -0,0 +1,133 @@
+//*****************************************************************************
+//
+// Title      : deterministic fuzz capture for km271dump
+// Remark     : writes a byte stream as recorded from the KM271 in log mode,
+//              mixed with the errors the decoder has to survive:
+//              - blocks with stuffed DLEs (register and payload)
+//              - blocks longer than the receive buffer
+//              - blocks with wrong BCC, DLE followed by a wrong byte
+//              - garbage, single STX / DLE / NAK
+//              The same seed and length always give the same file.
+//              With -l only valid log mode blocks of known registers are
+//              written, as a realistic capture for speed measurements.
+//
+// usage      : fuzzgen [-l] [-s seed] [-n bytes] out
+//
+//*****************************************************************************
+#include <km271_proto.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <unistd.h>
+
+/* V A R I A B L E S ********************************************************/
+static uint64_t               rngState;
+
+/**
+ * *******************************************************************
+ * @brief   random number, independent of the C library
+ * @param   n: upper limit
+ * @return  0 .. n-1
+ * *******************************************************************/
+static uint32_t rnd(uint32_t n) {
+  rngState = rngState * 6364136223846793005ull + 1442695040888963407ull;
+  return (uint32_t)(rngState >> 33) % n;
+}
+
+/**
+ * *******************************************************************
+ * @brief   random byte, DLE is chosen more often than by chance
+ * @return  byte
+ * *******************************************************************/
+static uint8_t rndByte() {
+  return rnd(8) ? (uint8_t)rnd(256) : KM_DLE;
+}
+
+/**
+ * *******************************************************************
+ * @brief   append one framed block "STX data DLE ETX BCC"
+ * @param   out: stream
+ * @param   data: block without framing
+ * @param   bccErr: write a wrong BCC
+ * @return  none
+ * *******************************************************************/
+static void addBlock(std::vector<uint8_t> *out, const std::vector<uint8_t> &data, bool bccErr) {
+  uint8_t bcc = 0;
+  out->push_back(KM_STX);
+  for (uint8_t b : data) {
+    out->push_back(b);
+    bcc ^= b;
+    if (b == KM_DLE) {                                 // DLE doubling, both DLEs are part of the BCC
+      out->push_back(b);
+      bcc ^= b;
+    }
+  }
+  out->push_back(KM_DLE);
+  out->push_back(KM_ETX);
+  bcc ^= KM_DLE ^ KM_ETX;
+  out->push_back(bccErr ? bcc ^ (1 + rnd(255)) : bcc);
+}
+
+int main(int argc, char **argv) {
+  uint64_t seed = 1;
+  size_t len = 4u << 20;
+  bool logOnly = false;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "ls:n:")) != -1) {
+    switch (opt) {
+      case 'l': logOnly = true; break;
+      case 's': seed = strtoull(optarg, NULL, 0); break;
+      case 'n': len = strtoull(optarg, NULL, 0); break;
+      default:
+        fprintf(stderr, "usage: fuzzgen [-l] [-s seed] [-n bytes] out\n");
+        return 2;
+    }
+  }
+  if (optind != argc - 1) {
+    fprintf(stderr, "usage: fuzzgen [-l] [-s seed] [-n bytes] out\n");
+    return 2;
+  }
+  rngState = seed;
+
+  std::vector<uint8_t> out;
+  out.reserve(len + 64);
+  while (out.size() < len) {
+    std::vector<uint8_t> data;
+    uint32_t kind = logOnly ? 0 : rnd(100);
+    if (kind < 70) {                                   // log mode block of a known register
+      uint16_t reg = kmValueDefs[rnd(KM271_VAL_CNT)].reg;
+      data = {(uint8_t)(reg >> 8), (uint8_t)reg, rndByte()};
+      addBlock(&out, data, false);
+    } else if (kind < 78) {                            // block of 1..KM_RX_BUF_LEN bytes, DLE stuffed
+      for (uint32_t n = 1 + rnd(KM_RX_BUF_LEN); n; n--) data.push_back(rndByte());
+      addBlock(&out, data, false);
+    } else if (kind < 84) {                            // wrong BCC
+      for (uint32_t n = 3 + rnd(4); n; n--) data.push_back(rndByte());
+      addBlock(&out, data, true);
+    } else if (kind < 88) {                            // too long for the receive buffer
+      for (uint32_t n = KM_RX_BUF_LEN + 1 + rnd(40); n; n--) data.push_back(rndByte());
+      addBlock(&out, data, false);
+    } else if (kind < 91) {                            // DLE followed by a wrong byte
+      out.push_back(KM_STX);
+      out.push_back(0x80 + rnd(0x30));
+      out.push_back(KM_DLE);
+      out.push_back(0x20 + rnd(0x40));
+    } else if (kind < 95) {                            // single control bytes
+      static const uint8_t ctrl[] = {KM_STX, KM_DLE, KM_NAK};
+      out.push_back(ctrl[rnd(3)]);
+    } else {                                           // garbage
+      for (uint32_t n = 1 + rnd(64); n; n--) out.push_back(rnd(256));
+    }
+  }
+  out.resize(len);
+
+  FILE *f = fopen(argv[optind], "wb");
+  if (!f || fwrite(out.data(), 1, out.size(), f) != out.size() || fclose(f) != 0) {
+    perror(argv[optind]);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,702 @@
+//*****************************************************************************
+// 
+// Title      : km271dump - decode recorded KM271 3964R captures on a host
+// Remark     : input files are raw byte streams as received from the KM271,
+//              e.g. recorded from the raw TCP bridge (nc <ip> 8271 > capture.bin).
+//              Files are memory mapped and split into chunks that are decoded
+//              in parallel. Each chunk starts decoding a bit earlier to find the
+//              block framing, blocks are assigned to the chunk they start in.
+//              The output is written in input order.
+//
+// usage      : km271dump [-f csv|jsonl|columns] [-o out] [-j threads] [-s scanner] file...
+//              km271dump -V|-B file...   verify / benchmark the frame scanners
+//
+//*****************************************************************************
+#include <km271_proto.h>
+#include "scan.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* D E F I N E S ************************************************************/
+#ifndef CHUNK_LEN
+#define CHUNK_LEN     (8u << 20)                       // bytes per parallel task (text buffers of written chunks are reused)
+#endif
+#ifndef SCAN_SAMPLE_LEN
+#define SCAN_SAMPLE_LEN (1u << 20)                     // bytes decoded by every scanner to choose the fastest one
+#endif
+#ifndef CHUNK_SYNC
+#define CHUNK_SYNC    4096                             // bytes decoded before a chunk to find the framing
+#endif
+
+/* T Y P E S ****************************************************************/
+typedef enum {
+  FMT_CSV,                                             // file,offset,register,name,raw,value
+  FMT_JSONL,                                           // one JSON object per line
+  FMT_COLUMNS,                                         // per value: <name>.offset.u64 and <name>.value.f32
+} e_format;
+
+typedef struct {
+  std::string         name;                            // file name
+  const uint8_t      *data;                            // mapped content
+  size_t              len;                             // file length
+  std::string         prefix;                          // start of every csv / jsonl line up to the offset
+} s_input;
+
+typedef struct {
+  size_t              file;                            // index of the input file
+  size_t              begin;                           // first byte of the chunk
+  size_t              end;                             // first byte after the chunk
+} s_task;
+
+typedef struct {
+  std::string                 text;                    // csv / jsonl output
+  std::vector<uint64_t>       offsets[KM271_VAL_CNT];  // columns output
+  std::vector<float>          values[KM271_VAL_CNT];
+  uint64_t                    blocks;                  // valid data blocks
+  uint64_t                    bccErrors;               // blocks with wrong BCC
+  uint64_t                    resyncs;                 // protocol errors
+  bool                        done;                    // result is complete
+} s_result;
+
+/* V A R I A B L E S ********************************************************/
+static e_format               outFormat = FMT_CSV;
+static std::vector<s_input>   inputs;
+static std::vector<s_task>    tasks;
+static std::vector<s_result>  results;
+static std::atomic<size_t>    nextTask(0);
+static size_t                 written = 0;             // results already written
+static size_t                 window = 0;              // max tasks ahead of the writer
+static std::mutex             resMutex;
+static std::condition_variable resCond;
+static std::string            valuePrefix[KM271_VAL_CNT];   // csv / jsonl text between offset and raw per value
+static int16_t                valueOfReg[0x10000];          // value id per register, -1 = none
+static std::vector<std::string> freeText;                   // written text buffers, reused to avoid page faults
+static size_t (*scanFn)(s_km271_scan *, const uint8_t *, size_t, size_t, size_t, km271ScanCb, void *) = km271Scan;
+
+/**
+ * *******************************************************************
+ * @brief   write an unsigned decimal number
+ * @param   p: destination
+ * @param   v: number
+ * @return  position after the number
+ * *******************************************************************/
+static inline char *putUint(char *p, uint64_t v) {
+  char tmp[20];
+  int n = 0;
+  do {
+    tmp[n++] = '0' + v % 10;
+    v /= 10;
+  } while (v);
+  while (n) {
+    *p++ = tmp[--n];
+  }
+  return p;
+}
+
+/**
+ * *******************************************************************
+ * @brief   write a byte as two lower case hex digits
+ * @param   p: destination
+ * @param   b: byte
+ * @return  position after the digits
+ * *******************************************************************/
+static inline char *putHex2(char *p, uint8_t b) {
+  static const char digits[] = "0123456789abcdef";
+  *p++ = digits[b >> 4];
+  *p++ = digits[b & 0x0f];
+  return p;
+}
+
+/**
+ * *******************************************************************
+ * @brief   write a decoded value as printf("%g") does
+ * @details decoded values are integers or have 0.5 steps, these are
+ *          written directly, everything else with snprintf()
+ * @param   p: destination, at least 16 bytes
+ * @param   v: value
+ * @return  position after the value
+ * *******************************************************************/
+static inline char *putValue(char *p, float v) {
+  float a = (v < 0) ? -v : v;
+  if (a < 1e6f) {
+    uint32_t ip = (uint32_t)a;
+    float frac = a - ip;
+    if (frac == 0.0f || frac == 0.5f) {
+      if (v < 0) *p++ = '-';
+      p = putUint(p, ip);
+      if (frac != 0.0f) {
+        *p++ = '.';
+        *p++ = '5';
+      }
+      return p;
+    }
+  }
+  return p + snprintf(p, 16, "%g", v);
+}
+
+/**
+ * *******************************************************************
+ * @brief   build the fixed parts of the csv / jsonl lines
+ * @details per input file the text up to the offset, per value id the
+ *          text between offset and raw data, and the value id per register
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+static void buildPrefixes() {
+  char buf[128];
+  memset(valueOfReg, 0xff, sizeof(valueOfReg));
+  for (int id = 0; id < KM271_VAL_CNT; id++) {
+    valueOfReg[kmValueDefs[id].reg] = id;
+  }
+  for (s_input &in : inputs) {
+    in.prefix = (outFormat == FMT_CSV) ? in.name + "," : "{\"file\":\"" + in.name + "\",\"offset\":";
+  }
+  for (int id = 0; id < KM271_VAL_CNT; id++) {
+    if (outFormat == FMT_CSV) {
+      snprintf(buf, sizeof(buf), ",0x%04x,%s,", kmValueDefs[id].reg, kmValueDefs[id].name);
+    } else {
+      snprintf(buf, sizeof(buf), ",\"reg\":\"0x%04x\",\"name\":\"%s\",\"raw\":\"", kmValueDefs[id].reg, kmValueDefs[id].name);
+    }
+    valuePrefix[id] = buf;
+  }
+}
+
+/**
+ * *******************************************************************
+ * @brief   append one decoded block to the result
+ * @details the csv / jsonl line is written with the put* functions,
+ *          printf style formatting would dominate the run time
+ * @param   res: result of the chunk
+ * @param   in: input file
+ * @param   offset: file offset of the block
+ * @param   buf: block data (register high, register low, payload)
+ * @param   len: block length
+ * @return  none
+ * *******************************************************************/
+static void addBlock(s_result *res, const s_input *in, size_t offset, const uint8_t *buf, int len) {
+  char line[256];
+  char *p = line;
+  uint16_t reg;
+  int id, n;
+
+  res->blocks++;
+  if (len < 3) {
+    return;                                            // no log mode block
+  }
+  reg = (buf[0] << 8) | buf[1];
+  id = (len == 3) ? valueOfReg[reg] : -1;
+  if (outFormat == FMT_COLUMNS) {
+    if (id >= 0) {
+      res->offsets[id].push_back(offset);
+      res->values[id].push_back(km271DecodeRaw(kmValueDefs[id].type, buf[2]));
+    }
+    return;
+  }
+  res->text.append(in->prefix);
+  p = putUint(p, offset);
+  if (id >= 0) {
+    memcpy(p, valuePrefix[id].data(), valuePrefix[id].size());
+    p += valuePrefix[id].size();
+  } else if (outFormat == FMT_CSV) {
+    memcpy(p, ",0x", 3);
+    p = putHex2(putHex2(p + 3, buf[0]), buf[1]);
+    memcpy(p, ",,", 2);
+    p += 2;
+  } else {
+    memcpy(p, ",\"reg\":\"0x", 10);
+    p = putHex2(putHex2(p + 10, buf[0]), buf[1]);
+    memcpy(p, "\",\"raw\":\"", 9);
+    p += 9;
+  }
+  for (n = 2; n < len; n++) {
+    p = putHex2(p, buf[n]);
+  }
+  if (outFormat == FMT_CSV) {
+    *p++ = ',';
+    if (id >= 0) {
+      p = putValue(p, km271DecodeRaw(kmValueDefs[id].type, buf[2]));
+    }
+    *p++ = '\n';
+  } else {
+    *p++ = '"';
+    if (id >= 0) {
+      memcpy(p, ",\"value\":", 9);
+      p = putValue(p + 9, km271DecodeRaw(kmValueDefs[id].type, buf[2]));
+    }
+    *p++ = '}';
+    *p++ = '\n';
+  }
+  res->text.append(line, p - line);
+}
+
+typedef struct {
+  s_result           *res;                             // result of the chunk
+  const s_input      *in;                              // input file
+  size_t              begin;                           // first byte of the chunk
+} s_chunkCtx;
+
+/**
+ * *******************************************************************
+ * @brief   scanner callback: take the results of blocks inside the chunk
+ * @param   ctx: s_chunkCtx
+ * @param   r: result
+ * @param   pos: offset of the byte
+ * @param   sc: scanner state
+ * @return  none
+ * *******************************************************************/
+static void chunkResult(void *ctx, e_km271_rxResult r, size_t pos, const s_km271_scan *sc) {
+  s_chunkCtx *cc = (s_chunkCtx *)ctx;
+  (void)pos;
+  if (sc->blockStart < cc->begin) {
+    return;                                            // still synchronising
+  }
+  switch (r) {
+    case KM271_RX_BLOCK:
+      addBlock(cc->res, cc->in, sc->blockStart, sc->rx.block.buf, sc->rx.block.len);
+      break;
+    case KM271_RX_BCC_ERR:
+      cc->res->bccErrors++;
+      break;
+    case KM271_RX_RESYNC:
+      cc->res->resyncs++;
+      break;
+    default:
+      break;
+  }
+}
+
+/**
+ * *******************************************************************
+ * @brief   decode one chunk of a file
+ * @details decoding starts CHUNK_SYNC bytes early in re-sync state,
+ *          only blocks starting inside the chunk are taken
+ * @param   task: chunk to decode
+ * @param   res: result of the chunk
+ * @return  none
+ * *******************************************************************/
+static void decodeChunk(const s_task *task, s_result *res) {
+  const s_input *in = &inputs[task->file];
+  s_chunkCtx cc = {res, in, task->begin};
+  s_km271_scan sc;
+
+  if (outFormat != FMT_COLUMNS) {                      // a log mode block of 7 bytes gives about 58 (csv) / 110 (jsonl) bytes
+    {
+      std::lock_guard<std::mutex> lock(resMutex);
+      if (!freeText.empty()) {
+        res->text.swap(freeText.back());
+        freeText.pop_back();
+      }
+    }
+    res->text.reserve((task->end - task->begin) * ((outFormat == FMT_CSV) ? 9 : 16));
+  }
+  km271ScanInit(&sc);
+  scanFn(&sc, in->data, (task->begin > CHUNK_SYNC) ? task->begin - CHUNK_SYNC : 0,
+         in->len, task->end, chunkResult, &cc);
+}
+
+/**
+ * *******************************************************************
+ * @brief   worker thread: decodes tasks until all are done
+ * @param   none
+ * @return  none
+ * *******************************************************************/
+static void worker() {
+  for (;;) {
+    size_t t = nextTask++;
+    if (t >= tasks.size()) {
+      return;
+    }
+    {
+      std::unique_lock<std::mutex> lock(resMutex);     // limit the memory of results waiting for the writer
+      resCond.wait(lock, [t] { return t < written + window; });
+    }
+    decodeChunk(&tasks[t], &results[t]);
+    std::lock_guard<std::mutex> lock(resMutex);
+    results[t].done = true;
+    resCond.notify_all();
+  }
+}
+
+/**
+ * *******************************************************************
+ * @brief   write the columns of one input file
+ * @param   dir: output directory
+ * @param   file: index of the input file
+ * @param   first: first task of the file
+ * @param   last: first task after the file
+ * @return  false on write error
+ * *******************************************************************/
+static bool writeColumns(const std::string &dir, size_t file, size_t first, size_t last) {
+  std::string base = inputs[file].name;
+  base = base.substr(base.find_last_of('/') + 1);
+  std::string outDir = dir + "/" + base;
+  mkdir(dir.c_str(), 0755);
+  mkdir(outDir.c_str(), 0755);
+  for (int id = 0; id < KM271_VAL_CNT; id++) {
+    std::string name = outDir + "/" + kmValueDefs[id].name;
+    FILE *fo = fopen((name + ".offset.u64").c_str(), "wb");
+    FILE *fv = fopen((name + ".value.f32").c_str(), "wb");
+    if (!fo || !fv) {
+      if (fo) fclose(fo);
+      if (fv) fclose(fv);
+      return false;
+    }
+    for (size_t t = first; t < last; t++) {
+      fwrite(results[t].offsets[id].data(), sizeof(uint64_t), results[t].offsets[id].size(), fo);
+      fwrite(results[t].values[id].data(), sizeof(float), results[t].values[id].size(), fv);
+    }
+    fclose(fo);
+    fclose(fv);
+  }
+  return true;
+}
+
+typedef struct {
+  uint64_t            hash;                            // FNV-1a over all results
+  uint64_t            count;                           // number of results
+} s_checkCtx;
+
+/**
+ * *******************************************************************
+ * @brief   scanner callback for --verify / --bench: hash all results
+ * @param   ctx: s_checkCtx
+ * @param   r: result
+ * @param   pos: offset of the byte
+ * @param   sc: scanner state
+ * @return  none
+ * *******************************************************************/
+static void checkResult(void *ctx, e_km271_rxResult r, size_t pos, const s_km271_scan *sc) {
+  s_checkCtx *cc = (s_checkCtx *)ctx;
+  uint64_t rec[3] = {(uint64_t)r, pos, sc->blockStart};
+  const uint8_t *p = (const uint8_t *)rec;
+  for (size_t i = 0; i < sizeof(rec); i++) {
+    cc->hash = (cc->hash ^ p[i]) * 0x100000001b3ull;
+  }
+  if (r != KM271_RX_RESYNC) {                          // block content is defined for all other results
+    for (int i = 0; i < sc->rx.block.len; i++) {
+      cc->hash = (cc->hash ^ sc->rx.block.buf[i]) * 0x100000001b3ull;
+    }
+  }
+  cc->count++;
+}
+
+/**
+ * *******************************************************************
+ * @brief   scanner callback for --bench: only count the results
+ * @return  none
+ * *******************************************************************/
+static void countResult(void *ctx, e_km271_rxResult, size_t, const s_km271_scan *) {
+  ((s_checkCtx *)ctx)->count++;
+}
+
+/**
+ * *******************************************************************
+ * @brief   decode a range with the selected scanner and hash the results
+ * @param   in: input file
+ * @param   begin: first byte
+ * @param   end: stop offset
+ * @param   cb: callback, checkResult or countResult
+ * @return  hash and count of the results
+ * *******************************************************************/
+static s_checkCtx checkRange(const s_input *in, size_t begin, size_t end, km271ScanCb cb = checkResult) {
+  s_checkCtx cc = {0xcbf29ce484222325ull, 0};
+  s_km271_scan sc;
+  km271ScanInit(&sc);
+  size_t stop = scanFn(&sc, in->data, begin, in->len, end, cb, &cc);
+  cc.hash ^= stop;
+  return cc;
+}
+
+/**
+ * *******************************************************************
+ * @brief   compare all scanner implementations with the byte by byte reference
+ * @details the whole files and the chunks of the normal decoding are checked
+ * @param   impls: implementations to check
+ * @return  exit code
+ * *******************************************************************/
+static int verify(const std::vector<const char *> &impls) {
+  int errors = 0;
+  for (const char *impl : impls) {
+    for (const s_task &task : tasks) {
+      const s_input *in = &inputs[task.file];
+      size_t begin = (task.begin > CHUNK_SYNC) ? task.begin - CHUNK_SYNC : 0;
+      size_t end = task.end;
+      scanFn = km271ScanRef;
+      s_checkCtx ref = checkRange(in, begin, end);
+      km271ScanSelect(impl);
+      scanFn = km271Scan;
+      s_checkCtx res = checkRange(in, begin, end);
+      if (res.hash != ref.hash || res.count != ref.count) {
+        fprintf(stderr, "%s: %s bytes %zu..%zu differ from reference\n", impl, in->name.c_str(), begin, end);
+        errors++;
+      }
+    }
+    for (const s_input &in : inputs) {
+      scanFn = km271ScanRef;
+      s_checkCtx ref = checkRange(&in, 0, in.len);
+      km271ScanSelect(impl);
+      scanFn = km271Scan;
+      s_checkCtx res = checkRange(&in, 0, in.len);
+      if (res.hash != ref.hash || res.count != ref.count) {
+        fprintf(stderr, "%s: %s differs from reference\n", impl, in.name.c_str());
+        errors++;
+      } else {
+        fprintf(stderr, "%s: %s ok, %llu results\n", impl, in.name.c_str(), (unsigned long long)ref.count);
+      }
+    }
+  }
+  return errors ? 1 : 0;
+}
+
+/**
+ * *******************************************************************
+ * @brief   select a scanner for scanFn
+ * @param   impl: "ref" or a name for km271ScanSelect()
+ * @return  none
+ * *******************************************************************/
+static void useScanner(const char *impl) {
+  if (strcmp(impl, "ref") == 0) {
+    scanFn = km271ScanRef;
+  } else {
+    km271ScanSelect(impl);
+    scanFn = km271Scan;
+  }
+}
+
+/**
+ * *******************************************************************
+ * @brief   choose the fastest scanner for the input
+ * @details the first SCAN_SAMPLE_LEN bytes of the first file are decoded
+ *          by every scanner (best of 3), the CPU features alone do not
+ *          tell which one is faster (e.g. AVX2 is slower than SSE2 on
+ *          captures with many errors on some CPUs)
+ * @param   impls: implementations supported by the CPU
+ * @return  name of the selected scanner
+ * *******************************************************************/
+static const char *pickScanner(const std::vector<const char *> &impls) {
+  const char *bestImpl = "ref";
+  double bestSec = 0;
+  s_input sample = inputs[0];
+  sample.len = std::min(sample.len, (size_t)SCAN_SAMPLE_LEN);
+  std::vector<const char *> all = {"ref"};
+  all.insert(all.end(), impls.begin(), impls.end());
+  for (const char *impl : all) {
+    useScanner(impl);
+    for (int run = 0; run < 3; run++) {
+      auto t0 = std::chrono::steady_clock::now();
+      checkRange(&sample, 0, sample.len, countResult);
+      double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+      if (bestSec == 0 || sec < bestSec) {
+        bestSec = sec;
+        bestImpl = impl;
+      }
+    }
+  }
+  useScanner(bestImpl);
+  return bestImpl;
+}
+
+/**
+ * *******************************************************************
+ * @brief   measure the single thread decode speed of all implementations
+ * @details best of 3 runs over all files, without output formatting
+ * @param   impls: implementations to measure
+ * @return  exit code
+ * *******************************************************************/
+static int bench(const std::vector<const char *> &impls) {
+  uint64_t bytes = 0;
+  for (const s_input &in : inputs) {
+    bytes += in.len;
+  }
+  std::vector<const char *> all = {"ref"};
+  all.insert(all.end(), impls.begin(), impls.end());
+  for (const char *impl : all) {
+    useScanner(impl);
+    double best = 0;
+    for (int run = 0; run < 3; run++) {
+      auto t0 = std::chrono::steady_clock::now();
+      for (const s_input &in : inputs) {
+        checkRange(&in, 0, in.len, countResult);
+      }
+      double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+      if (run == 0 || sec < best) best = sec;
+    }
+    fprintf(stderr, "%-8s %8.1f MB/s\n", impl, best > 0 ? bytes / best / 1e6 : 0.0);
+  }
+  return 0;
+}
+
+/**
+ * *******************************************************************
+ * @brief   print usage
+ * @return  exit code
+ * *******************************************************************/
+static int usage() {
+  fprintf(stderr,
+    "usage: km271dump [-f csv|jsonl|columns] [-o out] [-j threads] [-s scanner] file...\n"
+    "       km271dump -V|-B file...\n"
+    "  -f  output format (default csv)\n"
+    "  -o  output file (csv, jsonl; default stdout) or directory (columns)\n"
+    "  -j  number of threads (default: number of cores)\n"
+    "  -s  frame scanner: avx2, sse2, scalar or ref (byte by byte, default: fastest on the first MB of the input)\n"
+    "  -V  verify all scanners against the byte by byte reference\n"
+    "  -B  measure the decode speed of all scanners\n");
+  return 2;
+}
+
+int main(int argc, char **argv) {
+  std::string outName;
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  const char *scanner = NULL;                          // default: the fastest on the input
+  char mode = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "f:o:j:s:VBh")) != -1) {
+    switch (opt) {
+      case 'f':
+        if (strcmp(optarg, "csv") == 0) outFormat = FMT_CSV;
+        else if (strcmp(optarg, "jsonl") == 0) outFormat = FMT_JSONL;
+        else if (strcmp(optarg, "columns") == 0) outFormat = FMT_COLUMNS;
+        else return usage();
+        break;
+      case 'o': outName = optarg; break;
+      case 'j': threads = std::max(1, atoi(optarg)); break;
+      case 's':
+        if (strcmp(optarg, "ref") == 0) {
+          scanFn = km271ScanRef;
+        } else if (!km271ScanSelect(optarg)) {
+          fprintf(stderr, "scanner %s not supported\n", optarg);
+          return 2;
+        }
+        scanner = optarg;
+        break;
+      case 'V':
+      case 'B': mode = opt; break;
+      default:  return usage();
+    }
+  }
+  if (optind >= argc || (!mode && outFormat == FMT_COLUMNS && outName.empty())) {
+    return usage();
+  }
+
+  // map all inputs and split them into tasks
+  for (int i = optind; i < argc; i++) {
+    s_input in = {argv[i], NULL, 0, ""};
+    int fd = open(argv[i], O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+      perror(argv[i]);
+      return 1;
+    }
+    in.len = st.st_size;
+    if (in.len) {
+      void *p = mmap(NULL, in.len, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p == MAP_FAILED) {
+        perror(argv[i]);
+        return 1;
+      }
+      madvise(p, in.len, MADV_SEQUENTIAL);
+      in.data = (const uint8_t *)p;
+    }
+    close(fd);
+    for (size_t b = 0; b < in.len; b += CHUNK_LEN) {
+      tasks.push_back({inputs.size(), b, std::min(in.len, b + (size_t)CHUNK_LEN)});
+    }
+    inputs.push_back(in);
+  }
+
+  std::vector<const char *> impls;
+  for (const char *impl : {"scalar", "sse2", "avx2"}) {
+    if (km271ScanSelect(impl)) impls.push_back(impl);
+  }
+  if (mode) {
+    return (mode == 'V') ? verify(impls) : bench(impls);
+  }
+  if (!scanner) {
+    scanner = pickScanner(impls);
+  }
+
+  results.resize(tasks.size());
+  buildPrefixes();
+  window = threads * 2;
+
+  FILE *out = stdout;
+  if (outFormat != FMT_COLUMNS && !outName.empty()) {
+    out = fopen(outName.c_str(), "w");
+    if (!out) {
+      perror(outName.c_str());
+      return 1;
+    }
+  }
+  if (outFormat == FMT_CSV) {
+    fputs("file,offset,register,name,raw,value\n", out);
+  }
+
+  auto t0 = std::chrono::steady_clock::now();
+  std::vector<std::thread> pool;
+  for (unsigned i = 0; i < threads; i++) {
+    pool.emplace_back(worker);
+  }
+
+  // write results in input order
+  uint64_t blocks = 0, bccErrors = 0, resyncs = 0, bytes = 0;
+  size_t fileFirst = 0;
+  for (size_t t = 0; t < tasks.size(); t++) {
+    {
+      std::unique_lock<std::mutex> lock(resMutex);
+      resCond.wait(lock, [t] { return results[t].done; });
+    }
+    blocks += results[t].blocks;
+    bccErrors += results[t].bccErrors;
+    resyncs += results[t].resyncs;
+    bytes += tasks[t].end - tasks[t].begin;
+    if (outFormat == FMT_COLUMNS) {
+      if (t + 1 == tasks.size() || tasks[t + 1].file != tasks[t].file) {
+        if (!writeColumns(outName, tasks[t].file, fileFirst, t + 1)) {
+          perror(outName.c_str());
+          return 1;
+        }
+        for (size_t f = fileFirst; f <= t; f++) {
+          results[f] = s_result();
+          results[f].done = true;
+        }
+        fileFirst = t + 1;
+      }
+    } else {
+      fwrite(results[t].text.data(), 1, results[t].text.size(), out);
+    }
+    std::lock_guard<std::mutex> lock(resMutex);
+    if (outFormat != FMT_COLUMNS) {
+      results[t].text.clear();                         // keep the memory for the next chunk
+      freeText.push_back(std::move(results[t].text));
+    }
+    written = t + 1;
+    resCond.notify_all();
+  }
+  for (auto &th : pool) {
+    th.join();
+  }
+  if (out != stdout) {
+    fclose(out);
+  }
+
+  double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  fprintf(stderr, "%s scanner, %zu files, %llu bytes, %llu blocks, %llu BCC errors, %llu re-syncs, %.3f s (%.0f MB/s)\n",
+          scanner, inputs.size(), (unsigned long long)bytes, (unsigned long long)blocks, (unsigned long long)bccErrors,
+          (unsigned long long)resyncs, sec, sec > 0 ? bytes / sec / 1e6 : 0.0);
+  return 0;
+}
@@ -0,0 +1,274 @@
+//*****************************************************************************
+// 
+// Title      : bulk 3964R frame scanner for km271dump
+// Remark     : km271ScanRef() is the reference: it feeds every byte to
+//              km271RxByte(). km271Scan() runs the same state machine, but
+//              - in re-sync state it jumps to the next STX
+//              - in block state it jumps to the next DLE and copies the bytes before
+//              The DLE / STX positions are taken from bit masks that are built for
+//              64 bytes at once. Both functions stop at the first byte >= end that
+//              would start a new block (idle state) or in re-sync state.
+//
+//*****************************************************************************
+#include "scan.h"
+
+#include <string.h>
+#if defined(__SSE2__)
+  #include <immintrin.h>
+#endif
+
+/* T Y P E S ****************************************************************/
+typedef void (*buildMaskFn)(const uint8_t *p, uint64_t *dle, uint64_t *stx);
+
+/**
+ * *******************************************************************
+ * @brief   build DLE / STX masks for 64 bytes, scalar version
+ * @param   p: 64 bytes of data
+ * @param   dle: mask of DLE bytes
+ * @param   stx: mask of STX bytes
+ * @return  none
+ * *******************************************************************/
+static void buildMaskScalar(const uint8_t *p, uint64_t *dle, uint64_t *stx) {
+  uint64_t d = 0, s = 0;
+  for (int i = 0; i < 64; i++) {
+    d |= (uint64_t)(p[i] == KM_DLE) << i;
+    s |= (uint64_t)(p[i] == KM_STX) << i;
+  }
+  *dle = d;
+  *stx = s;
+}
+
+#if defined(__SSE2__)
+/**
+ * *******************************************************************
+ * @brief   build DLE / STX masks for 64 bytes, SSE2 version
+ * @param   p: 64 bytes of data
+ * @param   dle: mask of DLE bytes
+ * @param   stx: mask of STX bytes
+ * @return  none
+ * *******************************************************************/
+static void buildMaskSse2(const uint8_t *p, uint64_t *dle, uint64_t *stx) {
+  const __m128i vDle = _mm_set1_epi8(KM_DLE);
+  const __m128i vStx = _mm_set1_epi8(KM_STX);
+  uint64_t d = 0, s = 0;
+  for (int i = 0; i < 4; i++) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(p + i * 16));
+    d |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, vDle)) << (i * 16);
+    s |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, vStx)) << (i * 16);
+  }
+  *dle = d;
+  *stx = s;
+}
+
+/**
+ * *******************************************************************
+ * @brief   build DLE / STX masks for 64 bytes, AVX2 version
+ * @details compiled for AVX2 independent of the compiler flags,
+ *          only used if the CPU supports it
+ * @param   p: 64 bytes of data
+ * @param   dle: mask of DLE bytes
+ * @param   stx: mask of STX bytes
+ * @return  none
+ * *******************************************************************/
+__attribute__((target("avx2")))
+static void buildMaskAvx2(const uint8_t *p, uint64_t *dle, uint64_t *stx) {
+  const __m256i vDle = _mm256_set1_epi8(KM_DLE);
+  const __m256i vStx = _mm256_set1_epi8(KM_STX);
+  __m256i lo = _mm256_loadu_si256((const __m256i *)p);
+  __m256i hi = _mm256_loadu_si256((const __m256i *)(p + 32));
+  *dle = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, vDle))
+       | ((uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, vDle)) << 32);
+  *stx = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, vStx))
+       | ((uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, vStx)) << 32);
+}
+#endif
+
+/* V A R I A B L E S ********************************************************/
+static buildMaskFn buildMask = buildMaskScalar;
+
+/**
+ * *******************************************************************
+ * @brief   select the mask implementation
+ * @param   impl: "scalar", "sse2", "avx2" or NULL for the best supported one
+ * @return  name of the selected implementation, NULL if not supported
+ * *******************************************************************/
+const char *km271ScanSelect(const char *impl) {
+#if defined(__SSE2__)
+  bool avx2 = __builtin_cpu_supports("avx2");
+  if ((impl == NULL && avx2) || (impl && strcmp(impl, "avx2") == 0 && avx2)) {
+    buildMask = buildMaskAvx2;
+    return "avx2";
+  }
+  if (impl == NULL || strcmp(impl, "sse2") == 0) {
+    buildMask = buildMaskSse2;
+    return "sse2";
+  }
+#endif
+  if (impl == NULL || strcmp(impl, "scalar") == 0) {
+    buildMask = buildMaskScalar;
+    return "scalar";
+  }
+  return NULL;
+}
+
+/**
+ * *******************************************************************
+ * @brief   initialise the scanner state (re-sync, no masks)
+ * @param   sc: scanner state
+ * @return  none
+ * *******************************************************************/
+void km271ScanInit(s_km271_scan *sc) {
+  memset(sc, 0, sizeof(*sc));
+  sc->rx.state = KM_RX_RESYNC;
+}
+
+/**
+ * *******************************************************************
+ * @brief   find the next DLE or STX
+ * @param   sc: scanner state with the mask cache
+ * @param   data: byte stream
+ * @param   pos: first offset to check
+ * @param   limit: offset after the last byte to check
+ * @param   stx: true: search STX, false: search DLE
+ * @return  offset of the byte, limit if not found
+ * *******************************************************************/
+static inline size_t findByte(s_km271_scan *sc, const uint8_t *data, size_t pos, size_t limit, bool stx) {
+  while (pos < limit) {
+    if (sc->maskData != data || pos < sc->maskBase || pos >= sc->maskBase + sc->maskLen) {
+      sc->maskData = data;                              // new window starting at pos
+      sc->maskBase = pos;
+      if (limit - pos >= 64) {
+        buildMask(data + pos, &sc->dleMask, &sc->stxMask);
+        sc->maskLen = 64;
+      } else {
+        sc->dleMask = sc->stxMask = 0;                  // tail: do not read beyond limit
+        sc->maskLen = limit - pos;
+        for (size_t i = 0; i < sc->maskLen; i++) {
+          sc->dleMask |= (uint64_t)(data[pos + i] == KM_DLE) << i;
+          sc->stxMask |= (uint64_t)(data[pos + i] == KM_STX) << i;
+        }
+      }
+    }
+    uint64_t m = (stx ? sc->stxMask : sc->dleMask) >> (pos - sc->maskBase);
+    if (m) {
+      size_t found = pos + __builtin_ctzll(m);
+      return (found < limit) ? found : limit;
+    }
+    pos = sc->maskBase + sc->maskLen;
+  }
+  return limit;
+}
+
+/**
+ * *******************************************************************
+ * @brief   decode a part of a byte stream with the bulk scanner
+ * @param   sc: scanner state
+ * @param   data: byte stream
+ * @param   pos: first offset to decode
+ * @param   len: length of data
+ * @param   end: stop before a block starting at or after this offset
+ * @param   cb: called for every result
+ * @param   ctx: given to cb
+ * @return  offset where decoding stopped
+ * *******************************************************************/
+size_t km271Scan(s_km271_scan *sc, const uint8_t *data, size_t pos, size_t len, size_t end, km271ScanCb cb, void *ctx) {
+  s_km271_rx *rx = &sc->rx;
+
+  while (pos < len) {
+    switch (rx->state) {
+      case KM_RX_RESYNC: {
+        if (pos >= end) {
+          return pos;
+        }
+        size_t limit = (end < len) ? end : len;
+        size_t stx = findByte(sc, data, pos, limit, true);
+        if (stx >= limit) {
+          return stx;
+        }
+        rx->block.buf[0] = KM_STX;
+        rx->block.len = 1;
+        rx->state = KM_RX_IDLE;
+        cb(ctx, KM271_RX_CTRL, stx, sc);
+        pos = stx + 1;
+        break;
+      }
+      case KM_RX_IDLE: {
+        if (pos >= end) {
+          return pos;
+        }
+        uint8_t b = data[pos];
+        sc->blockStart = pos;
+        rx->block.buf[0] = b;
+        rx->block.len = 1;
+        rx->bcc = b;
+        if ((b == KM_STX) || (b == KM_DLE) || (b == KM_NAK)) {
+          cb(ctx, KM271_RX_CTRL, pos, sc);
+        } else {
+          rx->state = KM_RX_ON;
+        }
+        pos++;
+        break;
+      }
+      case KM_RX_ON: {
+        size_t dle = findByte(sc, data, pos, len, false);
+        size_t n = dle - pos;
+        size_t room = KM_RX_BUF_LEN - rx->block.len;
+        if (n > room) {                                 // block too long: re-sync on the first byte beyond the buffer
+          memcpy(&rx->block.buf[rx->block.len], data + pos, room);
+          rx->block.len = KM_RX_BUF_LEN;
+          rx->state = KM_RX_RESYNC;
+          cb(ctx, KM271_RX_RESYNC, pos + room, sc);
+          pos += room + 1;
+          break;
+        }
+        memcpy(&rx->block.buf[rx->block.len], data + pos, n);
+        rx->block.len += n;
+        for (size_t i = 0; i < n; i++) {
+          rx->bcc ^= data[pos + i];
+        }
+        pos = dle;
+        if (dle + 2 < len && data[dle + 1] == KM_ETX) {   // usual case: complete frame "DLE ETX BCC"
+          rx->bcc ^= KM_DLE ^ KM_ETX ^ data[dle + 2];
+          rx->state = KM_RX_IDLE;
+          cb(ctx, rx->bcc ? KM271_RX_BCC_ERR : KM271_RX_BLOCK, dle + 2, sc);
+          pos = dle + 3;
+        } else if (dle < len) {
+          rx->bcc ^= KM_DLE;
+          rx->state = KM_RX_DLE;
+          pos++;
+        }
+        break;
+      }
+      default:                                          // DLE and BCC state are single bytes
+        e_km271_rxResult res = km271RxByte(rx, data[pos]);
+        if (res != KM271_RX_NONE) {
+          cb(ctx, res, pos, sc);
+        }
+        pos++;
+        break;
+    }
+  }
+  return pos;
+}
+
+/**
+ * *******************************************************************
+ * @brief   decode a part of a byte stream byte by byte with km271RxByte()
+ * @details same interface and results as km271Scan()
+ * @return  offset where decoding stopped
+ * *******************************************************************/
+size_t km271ScanRef(s_km271_scan *sc, const uint8_t *data, size_t pos, size_t len, size_t end, km271ScanCb cb, void *ctx) {
+  for (; pos < len; pos++) {
+    if (sc->rx.state == KM_RX_IDLE) {
+      if (pos >= end) break;
+      sc->blockStart = pos;
+    } else if (sc->rx.state == KM_RX_RESYNC && pos >= end) {
+      break;
+    }
+    e_km271_rxResult res = km271RxByte(&sc->rx, data[pos]);
+    if (res != KM271_RX_NONE) {
+      cb(ctx, res, pos, sc);
+    }
+  }
+  return pos;
+}
@@ -0,0 +1,37 @@
+//*****************************************************************************
+// 
+// Title      : bulk 3964R frame scanner for km271dump
+// Remark     : gives the same results as calling km271RxByte() for every byte,
+//              but finds DLE and STX bytes 64 bytes at a time (SSE2 / AVX2 or
+//              scalar) and copies the data between them in one step.
+//
+//*****************************************************************************
+#pragma once
+
+#include <km271_proto.h>
+
+//*****************************************************************************
+// Defines
+//*****************************************************************************
+
+// Scanner state of one byte stream
+typedef struct {
+  s_km271_rx                rx;                                           // receive state, same as for km271RxByte()
+  size_t                    blockStart;                                   // offset of the last byte received in idle state
+  const uint8_t            *maskData;                                     // data the masks belong to
+  size_t                    maskBase;                                     // offset of bit 0 of the masks
+  size_t                    maskLen;                                      // number of valid mask bits (0 = no masks yet)
+  uint64_t                  dleMask;                                      // bit n set: data[maskBase+n] == KM_DLE
+  uint64_t                  stxMask;                                      // bit n set: data[maskBase+n] == KM_STX
+} s_km271_scan;
+
+// Called for every result != KM271_RX_NONE, pos is the offset of the byte that caused it
+typedef void (*km271ScanCb)(void *ctx, e_km271_rxResult res, size_t pos, const s_km271_scan *sc);
+
+//*****************************************************************************
+// Function prototypes
+//*****************************************************************************
+const char *km271ScanSelect(const char *impl);
+void   km271ScanInit(s_km271_scan *sc);
+size_t km271Scan(s_km271_scan *sc, const uint8_t *data, size_t pos, size_t len, size_t end, km271ScanCb cb, void *ctx);
+size_t km271ScanRef(s_km271_scan *sc, const uint8_t *data, size_t pos, size_t len, size_t end, km271ScanCb cb, void *ctx);
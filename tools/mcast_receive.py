@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+"""
+Reference receiver for the udp multicast datagrams of ESP_Buderus_KM271.
+
+Joins the multicast group and prints every received value. Lost datagrams
+are detected by the sequence number; the state is marked stale until the
+next full state datagram arrives. With --stats the decode-to-receive latency
+(device decode time -> host receive time) is printed on exit. Both clocks
+have to be NTP synchronised, the result includes their offset.
+
+Value names are taken from the retained <topic>/compact/schema message,
+saved to a file (e.g. mosquitto_sub -t esp_heizung/compact/schema -C 1 > schema.json).
+
+usage:    mcast_receive.py [--group 239.12.71.1] [--port 27271] [--schema schema.json] [--stats]
+"""
+import argparse
+import json
+import socket
+import struct
+import time
+
+HEADER = struct.Struct("<2sBBIQB")           # magic, version, type, sequence, decode time (us), count
+TYPE_DELTA = 0
+TYPE_FULL = 1
+
+# value types, see e_km271_valueType
+VT_NUMBER, VT_BITFIELD, VT_TEMP, VT_TEMP05, VT_TEMPNEG = range(5)
+
+
+def decode_value(vtype, raw):
+    if vtype == VT_TEMP05:
+        return raw / 2.0
+    if vtype == VT_TEMPNEG:
+        return raw - 256 if raw > 128 else raw
+    return raw
+
+
+class McastReceiver:
+    def __init__(self, names, quiet):
+        self.names = names
+        self.quiet = quiet
+        self.next_seq = None
+        self.synced = False
+        self.state = {}
+        self.datagrams = 0
+        self.lost = 0
+        self.latency = []
+
+    def handle(self, data, recv_us):
+        magic, version, dtype, seq, decode_us, count = HEADER.unpack_from(data)
+        if magic != b"KM" or version != 1 or len(data) < HEADER.size + count * 3:
+            return
+        self.datagrams += 1
+        if self.next_seq is not None and seq != self.next_seq:
+            self.lost += (seq - self.next_seq) & 0xFFFFFFFF
+            self.synced = False
+            print("lost %d datagram(s), waiting for full state" % ((seq - self.next_seq) & 0xFFFFFFFF))
+        self.next_seq = (seq + 1) & 0xFFFFFFFF
+        if dtype == TYPE_FULL:
+            self.synced = True
+        if dtype == TYPE_DELTA and decode_us:
+            self.latency.append((recv_us - decode_us) / 1000.0)
+
+        for i in range(count):
+            vid, vtype, raw = data[HEADER.size + i * 3:HEADER.size + i * 3 + 3]
+            value = decode_value(vtype, raw)
+            changed = self.state.get(vid) != value
+            self.state[vid] = value
+            if changed and not self.quiet:
+                name = self.names.get(vid, "id_%d" % vid)
+                print("%-40s %s%s" % (name, value, "" if self.synced else "  (stale state)"))
+
+    def report(self):
+        print("\ndatagrams: %d  lost: %d  values: %d" % (self.datagrams, self.lost, len(self.state)))
+        if self.latency:
+            lat = sorted(self.latency)
+            print("decode-to-receive latency: min %.1f ms  avg %.1f ms  p99 %.1f ms  (%d datagrams)" %
+                  (lat[0], sum(lat) / len(lat), lat[min(len(lat) - 1, int(len(lat) * 0.99))], len(lat)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="receive ESP_Buderus_KM271 multicast datagrams")
+    parser.add_argument("--group", default="239.12.71.1")
+    parser.add_argument("--port", type=int, default=27271)
+    parser.add_argument("--schema", help="file with the <topic>/compact/schema JSON for value names")
+    parser.add_argument("--stats", action="store_true", help="print datagram and latency statistics on exit")
+    parser.add_argument("--quiet", action="store_true", help="do not print values")
+    args = parser.parse_args()
+
+    names = {}
+    if args.schema:
+        with open(args.schema) as f:
+            names = {v["id"]: v["name"] for v in json.load(f)["values"]}
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.bind(("", args.port))
+    mreq = struct.pack("4s4s", socket.inet_aton(args.group), socket.inet_aton("0.0.0.0"))
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, mreq)
+
+    receiver = McastReceiver(names, args.quiet)
+    try:
+        while True:
+            data = sock.recv(2048)
+            receiver.handle(data, time.time_ns() // 1000)
+    except KeyboardInterrupt:
+        pass
+    if args.stats:
+        receiver.report()
+
+
+if __name__ == "__main__":
+    main()
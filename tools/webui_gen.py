@@ -0,0 +1,42 @@
+#!/usr/bin/env python3
+"""
+Generates include/webui_data.h from web/dashboard.html.
+
+The dashboard is stored pre-gzipped in flash, so the ESP never compresses
+at runtime. The ETag is derived from the content, so browsers only get a
+new copy if the dashboard has really changed.
+
+usage: tools/webui_gen.py   (run from the project root after changing web/)
+"""
+import gzip
+import hashlib
+import os
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+SRC = os.path.join(ROOT, "web", "dashboard.html")
+DST = os.path.join(ROOT, "include", "webui_data.h")
+
+
+def main():
+    with open(SRC, "rb") as f:
+        html = f.read()
+    data = gzip.compress(html, compresslevel=9, mtime=0)
+    etag = hashlib.sha1(html).hexdigest()[:16]
+
+    lines = []
+    for i in range(0, len(data), 16):
+        lines.append("  " + ", ".join("0x%02x" % b for b in data[i:i + 16]) + ",")
+
+    with open(DST, "w") as f:
+        f.write("#pragma once\n\n")
+        f.write("// generated by tools/webui_gen.py from web/dashboard.html - do not edit\n\n")
+        f.write("#include <Arduino.h>\n\n")
+        f.write("#define DASHBOARD_ETAG \"\\\"%s\\\"\"\n\n" % etag)
+        f.write("const uint8_t dashboard_html_gz[] PROGMEM = {\n")
+        f.write("\n".join(lines))
+        f.write("\n};\n")
+    print("%s: %d bytes -> %d bytes gzip, etag %s" % (os.path.relpath(DST, ROOT), len(html), len(data), etag))
+
+
+if __name__ == "__main__":
+    main()